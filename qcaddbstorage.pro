@@ -7,18 +7,53 @@ CONFIG += staticlib warn_on
 
 HEADERS = \
     ./src/rs_dbsentitytype.h \
+    ./src/rs_dbshandle.h \
+    ./src/rs_dbsidset.h \
+    ./src/rs_dbsidtable.h \
+    ./src/rs_dbsidvisitor.h \
+    ./src/rs_dbsobjectcache.h \
+    ./src/rs_dbsobjectdirectory.h \
     ./src/rs_dbsobjecttype.h \
     ./src/rs_dbslinetype.h \
     ./src/rs_dbsobjecttyperegistry.h \
+    ./src/rs_dbspropertychangecodec.h \
+    ./src/rs_dbsreaderpool.h \
+    ./src/rs_dbsreadview.h \
+    ./src/rs_dbsschema.h \
+    ./src/rs_dbsselection.h \
+    ./src/rs_dbssnapshot.h \
     ./src/rs_dbstorage.h \
-    ./src/rs_dbsucstype.h
+    ./src/rs_dbstorageoptions.h \
+    ./src/rs_dbsstatement.h \
+    ./src/rs_dbsstatementcache.h \
+    ./src/rs_dbsstatistics.h \
+    ./src/rs_dbsthread.h \
+    ./src/rs_dbsucstype.h \
+    ./src/rs_memorystorage.h
 SOURCES = \
     ./src/rs_dbsentitytype.cpp \
+    ./src/rs_dbshandle.cpp \
+    ./src/rs_dbsidset.cpp \
+    ./src/rs_dbsidtable.cpp \
+    ./src/rs_dbsobjectcache.cpp \
+    ./src/rs_dbsobjectdirectory.cpp \
     ./src/rs_dbsobjecttype.cpp \
     ./src/rs_dbslinetype.cpp \
     ./src/rs_dbsobjecttyperegistry.cpp \
+    ./src/rs_dbspropertychangecodec.cpp \
+    ./src/rs_dbsreaderpool.cpp \
+    ./src/rs_dbsreadview.cpp \
+    ./src/rs_dbsschema.cpp \
+    ./src/rs_dbsselection.cpp \
+    ./src/rs_dbssnapshot.cpp \
     ./src/rs_dbstorage.cpp \
-    ./src/rs_dbsucstype.cpp
+    ./src/rs_dbstorageoptions.cpp \
+    ./src/rs_dbsstatement.cpp \
+    ./src/rs_dbsstatementcache.cpp \
+    ./src/rs_dbsstatistics.cpp \
+    ./src/rs_dbsthread.cpp \
+    ./src/rs_dbsucstype.cpp \
+    ./src/rs_memorystorage.cpp
 
 TARGET = qcaddbstorage
 OBJECTS_DIR = .obj
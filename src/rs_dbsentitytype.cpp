@@ -1,8 +1,13 @@
+#include <algorithm>
+
 #include "RS_DbsEntityType"
-#include "RS_DbCommand"
 #include "RS_DbConnection"
-#include "RS_DbReader"
+#include "RS_DbException"
 #include "RS_DbStorage"
+#include "RS_DbsIdTable"
+#include "RS_DbsIdSet"
+#include "RS_DbsIdVisitor"
+#include "RS_DbsStatementCache"
     
     
     
@@ -22,6 +27,18 @@ void RS_DbsEntityType::initDb(RS_DbConnection& db) {
             "maxZ REAL"
         ");"
     );
+
+    // spatial index over the bounding boxes of all entities (including 
+    // entities that are undone, so undo / redo does not have to update
+    // the index):
+    db.executeNonQuery(
+        "CREATE VIRTUAL TABLE IF NOT EXISTS EntityIndex USING rtree("
+            "id, "
+            "minX, maxX, "
+            "minY, maxY, "
+            "minZ, maxZ"
+        ");"
+    );
 }
 
 
@@ -39,7 +56,7 @@ void RS_DbsEntityType::loadObject(
     
     //RS_DbsObjectType::loadEntityData(db, data, objectId);
 
-    RS_DbCommand cmd(
+    RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
         db, 
         "SELECT selectionStatus "
         "FROM Entity "
@@ -47,7 +64,7 @@ void RS_DbsEntityType::loadObject(
     );
     cmd.bind(1, objectId);
 
-    RS_DbReader reader = cmd.executeReader();
+    RS_DbsReader reader = cmd.executeReader();
     if (!reader.read()) {
         RS_Debug::error("RS_DbsEntityType::readEntityData: "
             "cannot read data for entity %d", objectId);
@@ -69,13 +86,14 @@ void RS_DbsEntityType::saveObject(RS_DbConnection& db, RS_Object& object, bool i
         return;
     }
 
-    RS_Box boundingBox = entity->getBoundingBox();
-    RS_Vector c1 = boundingBox.getDefiningCorner1();
-    RS_Vector c2 = boundingBox.getDefiningCorner2();
+    // the R*Tree requires min<=max for every dimension:
+    RS_Vector c1;
+    RS_Vector c2;
+    getCorners(entity->getBoundingBox(), c1, c2);
 
     if (isNew) {
         // generic entity information has to be stored for all entity types:
-        RS_DbCommand cmd(
+        RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
             db, 
             "INSERT INTO Entity VALUES(?,?,?,?,?,?,?,?);"
         );
@@ -92,9 +110,22 @@ void RS_DbsEntityType::saveObject(RS_DbConnection& db, RS_Object& object, bool i
         cmd.bind(8, c2.z);                       // maxZ
 
         cmd.executeNonQuery();
+
+        RS_DbsStatement& cmdIndex = RS_DbsStatementCache::prepare(
+            db, 
+            "INSERT INTO EntityIndex VALUES(?,?,?,?,?,?,?);"
+        );
+        cmdIndex.bind(1, entity->getId());
+        cmdIndex.bind(2, c1.x);
+        cmdIndex.bind(3, c2.x);
+        cmdIndex.bind(4, c1.y);
+        cmdIndex.bind(5, c2.y);
+        cmdIndex.bind(6, c1.z);
+        cmdIndex.bind(7, c2.z);
+        cmdIndex.executeNonQuery();
     }
     else {
-        RS_DbCommand cmd(
+        RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
             db, 
             "UPDATE Entity SET selectionStatus=?, minX=?, minY=?, minZ=?, maxX=?, maxY=?, maxZ=? "
             "WHERE id=?"
@@ -110,6 +141,21 @@ void RS_DbsEntityType::saveObject(RS_DbConnection& db, RS_Object& object, bool i
         cmd.bind(8, entity->getId());
 
         cmd.executeNonQuery();
+
+        RS_DbsStatement& cmdIndex = RS_DbsStatementCache::prepare(
+            db, 
+            "UPDATE EntityIndex "
+            "SET minX=?, maxX=?, minY=?, maxY=?, minZ=?, maxZ=? "
+            "WHERE id=?"
+        );
+        cmdIndex.bind(1, c1.x);
+        cmdIndex.bind(2, c2.x);
+        cmdIndex.bind(3, c1.y);
+        cmdIndex.bind(4, c2.y);
+        cmdIndex.bind(5, c1.z);
+        cmdIndex.bind(6, c2.z);
+        cmdIndex.bind(7, entity->getId());
+        cmdIndex.executeNonQuery();
     }
 }
 
@@ -117,24 +163,131 @@ void RS_DbsEntityType::saveObject(RS_DbConnection& db, RS_Object& object, bool i
 
 void RS_DbsEntityType::deleteObject(RS_DbConnection& db, RS_Object::Id objectId) {
     // delete record in Entity table:
-    RS_DbCommand cmd(
+    RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
         db, 
         "DELETE FROM Entity "
         "WHERE id=?"
     );
     cmd.bind(1, objectId);
     cmd.executeNonQuery();
+
+    RS_DbsStatement& cmdIndex = RS_DbsStatementCache::prepare(
+        db, 
+        "DELETE FROM EntityIndex "
+        "WHERE id=?"
+    );
+    cmdIndex.bind(1, objectId);
+    cmdIndex.executeNonQuery();
     
     RS_DbsObjectType::deleteObject(db, objectId);
 }
 
 
 
+/**
+ * Helper function for bulk inserts. Inserts the generic entity 
+ * information for the given new entities with preassigned IDs into 
+ * table \b Entity. The spatial index is not updated, this is done
+ * for the whole batch with \ref indexEntities.
+ *
+ * \throws RS_DbException if one of the objects is not an entity. 
+ *      Callers reject such objects first (see 
+ *      RS_DbsLineType::saveObjects).
+ */
+void RS_DbsEntityType::insertEntities(RS_DbConnection& db, std::vector<RS_Object*>& objects) {
+    size_t i = 0;
+    while (i<objects.size()) {
+        int rows = RS_DbsStatementCache::rowsPerInsert;
+        if (objects.size()-i<(size_t)rows) {
+            rows = 1;
+        }
+        RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
+            db, 
+            RS_DbsStatementCache::getInsertSql("Entity", 8, rows)
+        );
+
+        for (int r=0; r<rows; ++r, ++i) {
+            RS_Entity* entity = dynamic_cast<RS_Entity*>(objects[i]);
+            if (entity==NULL) {
+                // a row of the batch would stay unbound:
+                RS_Debug::error("RS_DbsEntityType::insertEntities: "
+                    "given object not an entity");
+                throw RS_DbException("RS_DbsEntityType::insertEntities: "
+                    "given object not an entity");
+            }
+
+            RS_Vector c1;
+            RS_Vector c2;
+            getCorners(entity->getBoundingBox(), c1, c2);
+
+            cmd.bind(r*8 + 1, entity->getId());
+            cmd.bind(r*8 + 2, entity->isSelected());
+            cmd.bind(r*8 + 3, c1.x);
+            cmd.bind(r*8 + 4, c1.y);
+            cmd.bind(r*8 + 5, c1.z);
+            cmd.bind(r*8 + 6, c2.x);
+            cmd.bind(r*8 + 7, c2.y);
+            cmd.bind(r*8 + 8, c2.z);
+        }
+
+        cmd.executeNonQuery();
+    }
+}
+
+
+
+/**
+ * Helper function for set based deletes. Deletes the records of all
+ * entities in the given ID table (see RS_DbsIdTable) from the tables
+ * \b Entity, \b EntityIndex and \b Object.
+ */
+void RS_DbsEntityType::deleteEntityRecords(RS_DbConnection& db, const std::string& idTable) {
+    RS_DbsStatementCache::prepare(
+        db, 
+        "DELETE FROM Entity "
+        "WHERE id IN (SELECT id FROM temp." + idTable + ")"
+    ).executeNonQuery();
+
+    RS_DbsStatementCache::prepare(
+        db, 
+        "DELETE FROM EntityIndex "
+        "WHERE id IN (SELECT id FROM temp." + idTable + ")"
+    ).executeNonQuery();
+
+    deleteObjectRecords(db, idTable);
+}
+
+
+
+/**
+ * Helper function for RS_DbStorage. Adds all entities in the given 
+ * ID range to the spatial index. Used at the end of bulk inserts.
+ */
+void RS_DbsEntityType::indexEntities(
+    RS_DbConnection& db, RS_Object::Id firstId, RS_Object::Id lastId) {
+
+    RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
+        db, 
+        "INSERT OR REPLACE INTO EntityIndex "
+        "SELECT id, "
+        "       MIN(minX, maxX), MAX(minX, maxX), "
+        "       MIN(minY, maxY), MAX(minY, maxY), "
+        "       MIN(minZ, maxZ), MAX(minZ, maxZ) "
+        "FROM Entity "
+        "WHERE id BETWEEN ? AND ?"
+    );
+    cmd.bind(1, firstId);
+    cmd.bind(2, lastId);
+    cmd.executeNonQuery();
+}
+
+
+
 /**
  * Helper function for RS_DbStorage.
  */
 void RS_DbsEntityType::queryAllEntities(RS_DbConnection& db, std::set<RS_Entity::Id>& result) {
-    RS_DbCommand cmd(
+    RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
         db, 
         "SELECT Object.id "
         "FROM Object, Entity "
@@ -142,198 +295,336 @@ void RS_DbsEntityType::queryAllEntities(RS_DbConnection& db, std::set<RS_Entity:
         "  AND Object.id=Entity.id"
     );
 
-    RS_DbReader reader = cmd.executeReader();
+    // IDs are read in ascending order:
+    RS_DbsReader reader = cmd.executeReader();
     while (reader.read()) {
-        result.insert(reader.getInt64(0));
+        result.insert(result.end(), reader.getInt64(0));
     }
 }
-    
-    
-    
+
+
+
 /**
- * Helper function for RS_DbStorage.
+ * \overload
  */
-void RS_DbsEntityType::querySelectedEntities(RS_DbConnection& db, std::set<RS_Object::Id>& result) {
-    RS_DbCommand cmd(
+void RS_DbsEntityType::queryAllEntities(RS_DbConnection& db, RS_DbsIdSet& result) {
+    RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
         db, 
         "SELECT Object.id "
         "FROM Object, Entity "
-        "WHERE Object.id=Entity.id "
-        "  AND Object.undoStatus=0 "
-        "  AND Entity.selectionStatus=1"
+        "WHERE Object.undoStatus=0 "
+        "  AND Object.id=Entity.id"
     );
 
-    RS_DbReader reader = cmd.executeReader();
+    // IDs are read in ascending order, so every insert is O(1):
+    RS_DbsIdSet ids;
+    RS_DbsReader reader = cmd.executeReader();
     while (reader.read()) {
-        result.insert(reader.getInt64(0));
+        ids.insert(reader.getInt64(0));
     }
+    result.unite(ids);
+}
+
+
+
+/**
+ * Helper function for RS_DbStorage. Reports the IDs of all entities
+ * that are not undone to the given visitor.
+ */
+void RS_DbsEntityType::queryAllEntities(RS_DbConnection& db, RS_DbsIdVisitor& visitor) {
+    visitIds(
+        db, 
+        "SELECT Object.id "
+        "FROM Object, Entity "
+        "WHERE Object.undoStatus=0 "
+        "  AND Object.id=Entity.id "
+        "ORDER BY Object.id", 
+        visitor
+    );
 }
     
     
     
 /**
- * Helper function for RS_DbStorage.
+ * Helper function for RS_DbsSelection. Queries the IDs of all entities
+ * that are selected in the DB, including entities that are undone.
  */
-void RS_DbsEntityType::clearEntitySelection(RS_DbConnection& db, std::set<RS_Entity::Id>* affectedObjects) {
-    // find out which entities will be affected:
-    if (affectedObjects!=NULL) {
-        RS_DbCommand cmd(
-            db, 
-            "SELECT id "
-            "FROM Entity "
-            "WHERE selectionStatus=1"
-        );
-        RS_DbReader reader = cmd.executeReader();
-        while (reader.read()) {
-            affectedObjects->insert(reader.getInt64(0));
-        }
+void RS_DbsEntityType::querySelectedEntities(RS_DbConnection& db, std::set<RS_Object::Id>& result) {
+    RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
+        db, 
+        "SELECT id "
+        "FROM Entity "
+        "WHERE selectionStatus=1"
+    );
+
+    RS_DbsReader reader = cmd.executeReader();
+    while (reader.read()) {
+        result.insert(reader.getInt64(0));
     }
+}
+
+
 
-    RS_DbCommand cmd(
+/**
+ * \overload
+ */
+void RS_DbsEntityType::querySelectedEntities(RS_DbConnection& db, RS_DbsIdSet& result) {
+    RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
         db, 
-        "UPDATE Entity "
-        "SET selectionStatus=0 "
+        "SELECT id "
+        "FROM Entity "
         "WHERE selectionStatus=1"
     );
+
+    // IDs are read in ascending order, so every insert is O(1):
+    RS_DbsIdSet ids;
+    RS_DbsReader reader = cmd.executeReader();
+    while (reader.read()) {
+        ids.insert(reader.getInt64(0));
+    }
+    result.unite(ids);
+}
+
+
+
+/**
+ * Helper function for RS_DbsSelection. Stores the given selection 
+ * status for all given entities.
+ */
+void RS_DbsEntityType::saveSelectionStatus(
+    RS_DbConnection& db, const std::vector<RS_Entity::Id>& entityIds, 
+    bool isSelected) {
+
+    if (entityIds.empty()) {
+        return;
+    }
+
+    RS_DbsIdTable::fill(db, "SelectionIds", entityIds);
+
+    RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
+        db, 
+        "UPDATE Entity "
+        "SET selectionStatus=? "
+        "WHERE id IN (SELECT id FROM temp.SelectionIds)"
+    );
+    cmd.bind(1, isSelected);
     cmd.executeNonQuery();
 }
 
 
 
 /**
- * Helper function for RS_DbStorage.
+ * Helper function for RS_DbStorage. Reads the stored bounding boxes of
+ * all entities in the given ID table (see RS_DbsIdTable), including
+ * entities that are undone. Objects that are not entities are ignored.
  */
-void RS_DbsEntityType::selectEntity(
-    RS_DbConnection& db,
-    RS_Entity::Id entityId, bool add, 
-    std::set<RS_Entity::Id>* affectedObjects) {
-
-    if (add) {
-        // only the entity that is added to the selection is affected:
-        if (affectedObjects!=NULL) {
-            affectedObjects->insert(entityId);
-        }
+void RS_DbsEntityType::getBoundingBoxes(
+    RS_DbConnection& db, const std::string& idTable, 
+    std::map<RS_Entity::Id, RS_Box>& result) {
 
-        RS_DbCommand cmd(
-            db, 
-            "UPDATE Entity "
-            "SET selectionStatus=1 "
-            "WHERE id=?"
-        );
-        cmd.bind(1, entityId);
-        cmd.executeNonQuery();
+    RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
+        db, 
+        "SELECT Entity.id, minX, minY, minZ, maxX, maxY, maxZ "
+        "FROM temp." + idTable + ", Entity "
+        "WHERE Entity.id=" + idTable + ".id"
+    );
+
+    RS_DbsReader reader = cmd.executeReader();
+    while (reader.read()) {
+        RS_Vector minV(reader.getDouble(1), reader.getDouble(2), reader.getDouble(3));
+        RS_Vector maxV(reader.getDouble(4), reader.getDouble(5), reader.getDouble(6));
+        result.insert(std::pair<RS_Entity::Id, RS_Box>(reader.getInt64(0), RS_Box(minV, maxV)));
     }
-    else {
-        // find out which entities will be affected:
-        if (affectedObjects!=NULL) {
-            RS_DbCommand cmd(
-                db, 
-                "SELECT id "
-                "FROM Entity "
-                "WHERE (id=? AND selectionStatus=0) OR "
-                "      (id!=? AND selectionStatus=1)"
-            );
-            cmd.bind(1, entityId);
-            cmd.bind(2, entityId);
-            RS_DbReader reader = cmd.executeReader();
-            while (reader.read()) {
-                affectedObjects->insert(reader.getInt64(0));
-            }
-        }
+}
 
-        RS_DbCommand cmd(
-            db, 
-            "UPDATE Entity "
-            "SET selectionStatus=NOT(selectionStatus) "
-            "WHERE (id=? AND selectionStatus=0) OR "
-            "      (id!=? AND selectionStatus=1)"
-        );
-        cmd.bind(1, entityId);
-        cmd.bind(2, entityId);
-        cmd.executeNonQuery();
+
+
+/**
+ * Helper function for RS_DbStorage. Queries all entities that are not
+ * undone and whose bounding box intersects the given box. The spatial 
+ * index stores single precision coordinates, so its results are
+ * refined with the exact bounding boxes from the Entity table. Entities
+ * that are undone are filtered out here.
+ *
+ * \param inside Only query entities that are completely inside the 
+ *      given box (e.g. for window selections).
+ */
+void RS_DbsEntityType::queryEntitiesInBox(
+    RS_DbConnection& db, const RS_Box& box, 
+    std::set<RS_Entity::Id>& result, bool inside) {
+
+    RS_DbsReader reader = prepareEntitiesInBox(db, box, inside).executeReader();
+    while (reader.read()) {
+        result.insert(reader.getInt64(0));
     }
 }
 
 
 
 /**
- * Helper function for RS_DbStorage.
+ * \overload
  */
-void RS_DbsEntityType::selectEntities(
-    RS_DbConnection& db,
-    std::set<RS_Entity::Id>& entityIds, 
-    bool add, 
-    std::set<RS_Entity::Id>* affectedObjects) {
-    
-    if (affectedObjects!=NULL) {
-        (*affectedObjects) = entityIds;
+void RS_DbsEntityType::queryEntitiesInBox(
+    RS_DbConnection& db, const RS_Box& box, 
+    RS_DbsIdSet& result, bool inside) {
+
+    // the spatial index does not return IDs in order:
+    std::vector<RS_Entity::Id> ids;
+    RS_DbsReader reader = prepareEntitiesInBox(db, box, inside).executeReader();
+    while (reader.read()) {
+        ids.push_back(reader.getInt64(0));
     }
 
-    if (!add) {
-        // find out which entities will be deselected:
-        if (affectedObjects!=NULL) {
-            RS_DbCommand cmd(
-                db, 
-                "SELECT id "
-                "FROM Entity "
-                "WHERE selectionStatus=1"
-            );
-            RS_DbReader reader = cmd.executeReader();
-            while (reader.read()) {
-                affectedObjects->insert(reader.getInt64(0));
-            }
-        }
+    RS_DbsIdSet idSet;
+    idSet.assign(ids);
+    result.unite(idSet);
+}
+
+
+
+/**
+ * Gets the minimum and maximum corner of the given box. The defining 
+ * corners of a box can be in any order.
+ */
+void RS_DbsEntityType::getCorners(
+    const RS_Box& box, RS_Vector& minV, RS_Vector& maxV) {
+
+    RS_Vector c1 = box.getDefiningCorner1();
+    RS_Vector c2 = box.getDefiningCorner2();
+    minV = RS_Vector(std::min(c1.x, c2.x), std::min(c1.y, c2.y), std::min(c1.z, c2.z));
+    maxV = RS_Vector(std::max(c1.x, c2.x), std::max(c1.y, c2.y), std::max(c1.z, c2.z));
+}
+
+
+
+/**
+ * \return Cached statement for \ref queryEntitiesInBox with the
+ *      coordinates of the given box bound.
+ */
+RS_DbsStatement& RS_DbsEntityType::prepareEntitiesInBox(
+    RS_DbConnection& db, const RS_Box& box, bool inside) {
+
+    RS_Vector minV;
+    RS_Vector maxV;
+    getCorners(box, minV, maxV);
 
-        // deselect all:
-        RS_DbCommand cmd(
+    RS_DbsStatement* cmd;
+    if (inside) {
+        cmd = &RS_DbsStatementCache::prepare(
             db, 
-            "UPDATE Entity "
-            "SET selectionStatus=0 "
-            "WHERE selectionStatus=1"
+            "SELECT Entity.id "
+            "FROM EntityIndex, Entity, Object "
+            "WHERE EntityIndex.maxX>=?1 AND EntityIndex.minX<=?4 "
+            "  AND EntityIndex.maxY>=?2 AND EntityIndex.minY<=?5 "
+            "  AND EntityIndex.maxZ>=?3 AND EntityIndex.minZ<=?6 "
+            "  AND Entity.id=EntityIndex.id "
+            "  AND Object.id=EntityIndex.id "
+            "  AND Object.undoStatus=0 "
+            "  AND Entity.minX>=?1 AND Entity.maxX<=?4 "
+            "  AND Entity.minY>=?2 AND Entity.maxY<=?5 "
+            "  AND Entity.minZ>=?3 AND Entity.maxZ<=?6"
         );
-        cmd.executeNonQuery();
     }
-
-    // select given entities:
-    RS_DbCommand cmd(
-        db, 
-        std::string(
-            "UPDATE Entity "
-            "SET selectionStatus=1 "
-            "WHERE id IN "
-        ) + RS_DbStorage::getSqlList(entityIds)
-    );
-    cmd.executeNonQuery();
+    else {
+        cmd = &RS_DbsStatementCache::prepare(
+            db, 
+            "SELECT Entity.id "
+            "FROM EntityIndex, Entity, Object "
+            "WHERE EntityIndex.maxX>=?1 AND EntityIndex.minX<=?4 "
+            "  AND EntityIndex.maxY>=?2 AND EntityIndex.minY<=?5 "
+            "  AND EntityIndex.maxZ>=?3 AND EntityIndex.minZ<=?6 "
+            "  AND Entity.id=EntityIndex.id "
+            "  AND Object.id=EntityIndex.id "
+            "  AND Object.undoStatus=0 "
+            "  AND Entity.maxX>=?1 AND Entity.minX<=?4 "
+            "  AND Entity.maxY>=?2 AND Entity.minY<=?5 "
+            "  AND Entity.maxZ>=?3 AND Entity.minZ<=?6"
+        );
+    }
+    cmd->bind(1, minV.x);
+    cmd->bind(2, minV.y);
+    cmd->bind(3, minV.z);
+    cmd->bind(4, maxV.x);
+    cmd->bind(5, maxV.y);
+    cmd->bind(6, maxV.z);
+
+    return *cmd;
 }
 
 
 
 /**
- * Helper function for RS_DbStorage.
+ * Helper function for RS_DbStorage. Computes the bounding box of all 
+ * entities that are not undone.
+ *
+ * \return false if there are no such entities.
  */
-RS_Box RS_DbsEntityType::getBoundingBox(RS_DbConnection& db) {
-    RS_DbCommand cmd(
+bool RS_DbsEntityType::getBoundingBox(
+    RS_DbConnection& db, RS_Vector& minV, RS_Vector& maxV) {
+
+    RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
         db, 
         "SELECT MIN(minX), MIN(minY), MIN(minZ), "
-        "       MAX(maxX), MAX(maxY), MAX(maxZ) "
+        "       MAX(maxX), MAX(maxY), MAX(maxZ), "
+        "       COUNT(*) "
         "FROM Object, Entity "
         "WHERE Object.id=Entity.id "
         "   AND undoStatus=0"
     );
-    RS_DbReader reader = cmd.executeReader();
+    RS_DbsReader reader = cmd.executeReader();
 
-    RS_Vector minV;
-    RS_Vector maxV;
+    minV = RS_Vector();
+    maxV = RS_Vector();
     
-    if (reader.read()) {
-        minV.x = reader.getDouble(0);
-        minV.y = reader.getDouble(1);
-        minV.z = reader.getDouble(2);
-        
-        maxV.x = reader.getDouble(3);
-        maxV.y = reader.getDouble(4);
-        maxV.z = reader.getDouble(5);
+    if (!reader.read() || reader.getInt(6)==0) {
+        return false;
     }
 
-    return RS_Box(minV, maxV);
+    minV.x = reader.getDouble(0);
+    minV.y = reader.getDouble(1);
+    minV.z = reader.getDouble(2);
+    
+    maxV.x = reader.getDouble(3);
+    maxV.y = reader.getDouble(4);
+    maxV.z = reader.getDouble(5);
+
+    return true;
+}
+
+
+
+/**
+ * Helper function for RS_DbStorage. Reads the stored bounding box of 
+ * the given entity.
+ *
+ * \return false if the given object is not an entity or is undone.
+ */
+bool RS_DbsEntityType::getBoundingBox(
+    RS_DbConnection& db, RS_Entity::Id entityId, 
+    RS_Vector& minV, RS_Vector& maxV) {
+
+    RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
+        db, 
+        "SELECT minX, minY, minZ, maxX, maxY, maxZ "
+        "FROM Object, Entity "
+        "WHERE Object.id=? "
+        "  AND Object.id=Entity.id "
+        "  AND Object.undoStatus=0"
+    );
+    cmd.bind(1, entityId);
+
+    RS_DbsReader reader = cmd.executeReader();
+    if (!reader.read()) {
+        return false;
+    }
+
+    minV.x = reader.getDouble(0);
+    minV.y = reader.getDouble(1);
+    minV.z = reader.getDouble(2);
+    
+    maxV.x = reader.getDouble(3);
+    maxV.y = reader.getDouble(4);
+    maxV.z = reader.getDouble(5);
+
+    return true;
 }
@@ -1,11 +1,15 @@
 #ifndef RS_DBENTITY_H
 #define RS_DBENTITY_H
 
+#include <map>
+#include <string>
+
 #include "RS_Entity"
 #include "RS_DbsObjectType"
 #include "RS_DbsObjectTypeRegistry"
 
 class RS_DbConnection;
+class RS_DbsStatement;
 
 
 
@@ -14,6 +18,12 @@ class RS_DbConnection;
  * DB storage for an entity type. The purpose of such classes
  * is to separate storage from the entity implementation.
  *
+ * Data that is common to all entities is stored in table \b Entity,
+ * including the bounding box of every entity. The bounding boxes of 
+ * all entities are also kept in the R*Tree \b EntityIndex for fast 
+ * spatial queries. Entities that are undone stay in the index, so
+ * undo and redo do not have to update it.
+ *
  * \author Andrew Mustun
  * \ingroup qcaddbstorage
  */
@@ -26,13 +36,26 @@ public:
     virtual void loadObject(RS_DbConnection& db, RS_Object& object, RS_Object::Id objectId);
     virtual void saveObject(RS_DbConnection& db, RS_Object& object, bool isNew);
     virtual void deleteObject(RS_DbConnection& db, RS_Object::Id objectId);
+
+    static void indexEntities(RS_DbConnection& db, RS_Object::Id firstId, RS_Object::Id lastId);
     
     static void queryAllEntities(RS_DbConnection& db, std::set<RS_Entity::Id>& result);
+    static void queryAllEntities(RS_DbConnection& db, RS_DbsIdVisitor& visitor);
+    static void queryAllEntities(RS_DbConnection& db, RS_DbsIdSet& result);
     static void querySelectedEntities(RS_DbConnection& db, std::set<RS_Entity::Id>& result);
-    static void clearEntitySelection(RS_DbConnection& db, std::set<RS_Entity::Id>* affectedObjects);
-    static void selectEntity(RS_DbConnection& db, RS_Entity::Id entityId, bool add, std::set<RS_Entity::Id>* affectedObjects);
-    static void selectEntities(RS_DbConnection& db, std::set<RS_Entity::Id>& entityIds, bool add, std::set<RS_Entity::Id>* affectedObjects);
-    static RS_Box getBoundingBox(RS_DbConnection& db);
+    static void querySelectedEntities(RS_DbConnection& db, RS_DbsIdSet& result);
+    static void saveSelectionStatus(RS_DbConnection& db, const std::vector<RS_Entity::Id>& entityIds, bool isSelected);
+    static void queryEntitiesInBox(RS_DbConnection& db, const RS_Box& box, std::set<RS_Entity::Id>& result, bool inside);
+    static void queryEntitiesInBox(RS_DbConnection& db, const RS_Box& box, RS_DbsIdSet& result, bool inside);
+    static bool getBoundingBox(RS_DbConnection& db, RS_Vector& minV, RS_Vector& maxV);
+    static bool getBoundingBox(RS_DbConnection& db, RS_Entity::Id entityId, RS_Vector& minV, RS_Vector& maxV);
+    static void getBoundingBoxes(RS_DbConnection& db, const std::string& idTable, std::map<RS_Entity::Id, RS_Box>& result);
+    static void getCorners(const RS_Box& box, RS_Vector& minV, RS_Vector& maxV);
+
+protected:
+    static void insertEntities(RS_DbConnection& db, std::vector<RS_Object*>& objects);
+    static void deleteEntityRecords(RS_DbConnection& db, const std::string& idTable);
+    static RS_DbsStatement& prepareEntitiesInBox(RS_DbConnection& db, const RS_Box& box, bool inside);
 };
 
 #endif
@@ -0,0 +1,80 @@
+#include <sqlite3.h>
+
+#include "RS_DbsHandle"
+#include "RS_DbException"
+#include "RS_Debug"
+
+
+
+#ifdef _WIN32
+DWORD RS_DbsHandle::thread;
+#else
+pthread_t RS_DbsHandle::thread;
+#endif
+sqlite3* RS_DbsHandle::handle = NULL;
+
+
+
+/**
+ * Opens the given connection (see RS_DbConnection::open).
+ *
+ * \return SQLite handle of the connection.
+ *
+ * \throws RS_DbException if the handle cannot be captured. The 
+ *      connection is closed in that case.
+ */
+sqlite3* RS_DbsHandle::open(RS_DbConnection& db, const std::string& fileName) {
+    sqlite3_mutex* mutex = sqlite3_mutex_alloc(SQLITE_MUTEX_STATIC_APP1);
+    sqlite3_mutex_enter(mutex);
+
+    // other threads see these values when SQLite runs the auto 
+    // extension for them, which happens under the same SQLite mutex as
+    // the registration:
+#ifdef _WIN32
+    thread = GetCurrentThreadId();
+#else
+    thread = pthread_self();
+#endif
+    handle = NULL;
+    sqlite3_auto_extension((void (*)(void))capture);
+
+    try {
+        db.open(fileName.c_str());
+    }
+    catch (...) {
+        sqlite3_cancel_auto_extension((void (*)(void))capture);
+        sqlite3_mutex_leave(mutex);
+        throw;
+    }
+
+    sqlite3_cancel_auto_extension((void (*)(void))capture);
+    sqlite3* ret = handle;
+    handle = NULL;
+    sqlite3_mutex_leave(mutex);
+
+    if (ret==NULL) {
+        RS_Debug::error("RS_DbsHandle::open: "
+            "cannot get SQLite handle of %s", fileName.c_str());
+        db.close();
+        throw RS_DbException("cannot get SQLite handle of " + fileName);
+    }
+    return ret;
+}
+
+
+
+/**
+ * Auto extension that is run by SQLite for every new connection while
+ * \ref open is running.
+ */
+int RS_DbsHandle::capture(sqlite3* db, char** /*errorMessage*/, const sqlite3_api_routines* /*api*/) {
+#ifdef _WIN32
+    bool ownThread = (GetCurrentThreadId()==thread);
+#else
+    bool ownThread = (pthread_equal(pthread_self(), thread)!=0);
+#endif
+    if (ownThread && handle==NULL) {
+        handle = db;
+    }
+    return SQLITE_OK;
+}
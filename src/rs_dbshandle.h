@@ -0,0 +1,51 @@
+#ifndef RS_DBSHANDLE_H
+#define RS_DBSHANDLE_H
+
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#include "RS_DbClient"
+
+struct sqlite3;
+struct sqlite3_api_routines;
+
+
+
+/**
+ * Opens RS_DbConnection objects and captures the SQLite handle of the
+ * connection. RS_DbConnection does not expose its handle, but reusing
+ * statements (RS_DbsStatement), the trace hooks (RS_DbsStatistics)
+ * and the backup API (RS_DbsSnapshot) need it.
+ *
+ * The handle is captured with an SQLite auto extension, which is
+ * registered only while the connection is opened and only reports
+ * connections opened by the calling thread. Openings through this
+ * class are serialized.
+ *
+ * \author Andrew Mustun
+ * \ingroup qcaddbstorage
+ */
+class RS_DbsHandle {
+public:
+    static sqlite3* open(RS_DbConnection& db, const std::string& fileName);
+
+private:
+    static int capture(sqlite3* db, char** errorMessage, const sqlite3_api_routines* api);
+
+private:
+    //! thread that is opening a connection:
+#ifdef _WIN32
+    static DWORD thread;
+#else
+    static pthread_t thread;
+#endif
+    //! handle of the connection opened by that thread:
+    static sqlite3* handle;
+};
+
+#endif
@@ -0,0 +1,274 @@
+#include <algorithm>
+
+#include "RS_DbsIdSet"
+
+
+
+RS_DbsIdSet::RS_DbsIdSet(const std::set<RS_Object::Id>& ids)
+    : ids(ids.begin(), ids.end()) {
+}
+
+
+
+/**
+ * Replaces the content of this set with the given IDs. The IDs may be
+ * in any order and contain duplicates.
+ */
+void RS_DbsIdSet::assign(const std::vector<RS_Object::Id>& ids) {
+    this->ids = ids;
+    std::sort(this->ids.begin(), this->ids.end());
+    this->ids.erase(
+        std::unique(this->ids.begin(), this->ids.end()),
+        this->ids.end()
+    );
+}
+
+
+
+/**
+ * Adds the given ID to the set. This is O(1) if the ID is larger than
+ * all IDs in the set.
+ */
+void RS_DbsIdSet::insert(RS_Object::Id id) {
+    if (ids.empty() || ids.back()<id) {
+        ids.push_back(id);
+        return;
+    }
+
+    std::vector<RS_Object::Id>::iterator it =
+        std::lower_bound(ids.begin(), ids.end(), id);
+    if (*it!=id) {
+        ids.insert(it, id);
+    }
+}
+
+
+
+/**
+ * Removes the given ID from the set.
+ *
+ * \return True if the ID was in the set.
+ */
+bool RS_DbsIdSet::erase(RS_Object::Id id) {
+    std::vector<RS_Object::Id>::iterator it =
+        std::lower_bound(ids.begin(), ids.end(), id);
+    if (it==ids.end() || *it!=id) {
+        return false;
+    }
+    ids.erase(it);
+    return true;
+}
+
+
+
+bool RS_DbsIdSet::contains(RS_Object::Id id) const {
+    return std::binary_search(ids.begin(), ids.end(), id);
+}
+
+
+
+/**
+ * Adds all IDs of this set to \c result.
+ */
+void RS_DbsIdSet::toSet(std::set<RS_Object::Id>& result) const {
+    // inserting in ascending order with a hint is O(1) per ID:
+    const_iterator it;
+    for (it=ids.begin(); it!=ids.end(); ++it) {
+        result.insert(result.end(), *it);
+    }
+}
+
+
+
+/**
+ * Adds all IDs of \c other to this set.
+ */
+void RS_DbsIdSet::unite(const RS_DbsIdSet& other) {
+    if (other.ids.empty()) {
+        return;
+    }
+    if (ids.empty() || ids.back()<other.ids.front()) {
+        ids.insert(ids.end(), other.ids.begin(), other.ids.end());
+        return;
+    }
+    unite(*this, other, *this);
+}
+
+
+
+/**
+ * Removes all IDs from this set that are not in \c other.
+ */
+void RS_DbsIdSet::intersect(const RS_DbsIdSet& other) {
+    intersect(*this, other, *this);
+}
+
+
+
+/**
+ * Removes all IDs of \c other from this set.
+ */
+void RS_DbsIdSet::subtract(const RS_DbsIdSet& other) {
+    if (other.ids.empty()) {
+        return;
+    }
+    subtract(*this, other, *this);
+}
+
+
+
+/**
+ * Computes the union of \c a and \c b. \c result may be \c a or \c b.
+ */
+void RS_DbsIdSet::unite(const RS_DbsIdSet& a, const RS_DbsIdSet& b, RS_DbsIdSet& result) {
+    std::vector<RS_Object::Id> ret;
+    ret.reserve(a.ids.size() + b.ids.size());
+
+    const_iterator i = a.ids.begin();
+    const_iterator j = b.ids.begin();
+    while (i!=a.ids.end() && j!=b.ids.end()) {
+        if (*i<*j) {
+            const_iterator k = gallop(i, a.ids.end(), *j);
+            ret.insert(ret.end(), i, k);
+            i = k;
+        }
+        else if (*j<*i) {
+            const_iterator k = gallop(j, b.ids.end(), *i);
+            ret.insert(ret.end(), j, k);
+            j = k;
+        }
+        else {
+            ret.push_back(*i);
+            ++i;
+            ++j;
+        }
+    }
+    ret.insert(ret.end(), i, a.ids.end());
+    ret.insert(ret.end(), j, b.ids.end());
+
+    result.ids.swap(ret);
+}
+
+
+
+/**
+ * Computes the intersection of \c a and \c b. \c result may be \c a
+ * or \c b.
+ */
+void RS_DbsIdSet::intersect(const RS_DbsIdSet& a, const RS_DbsIdSet& b, RS_DbsIdSet& result) {
+    std::vector<RS_Object::Id> ret;
+    ret.reserve(std::min(a.ids.size(), b.ids.size()));
+
+    const_iterator i = a.ids.begin();
+    const_iterator j = b.ids.begin();
+    while (i!=a.ids.end() && j!=b.ids.end()) {
+        if (*i<*j) {
+            i = gallop(i, a.ids.end(), *j);
+        }
+        else if (*j<*i) {
+            j = gallop(j, b.ids.end(), *i);
+        }
+        else {
+            ret.push_back(*i);
+            ++i;
+            ++j;
+        }
+    }
+
+    result.ids.swap(ret);
+}
+
+
+
+/**
+ * Computes the IDs of \c a that are not in \c b. \c result may be \c a
+ * or \c b.
+ */
+void RS_DbsIdSet::subtract(const RS_DbsIdSet& a, const RS_DbsIdSet& b, RS_DbsIdSet& result) {
+    std::vector<RS_Object::Id> ret;
+    ret.reserve(a.ids.size());
+
+    const_iterator i = a.ids.begin();
+    const_iterator j = b.ids.begin();
+    while (i!=a.ids.end() && j!=b.ids.end()) {
+        if (*i<*j) {
+            const_iterator k = gallop(i, a.ids.end(), *j);
+            ret.insert(ret.end(), i, k);
+            i = k;
+        }
+        else if (*j<*i) {
+            j = gallop(j, b.ids.end(), *i);
+        }
+        else {
+            ++i;
+            ++j;
+        }
+    }
+    ret.insert(ret.end(), i, a.ids.end());
+
+    result.ids.swap(ret);
+}
+
+
+
+/**
+ * Computes the IDs that are in either \c a or \c b but not in both.
+ * \c result may be \c a or \c b.
+ */
+void RS_DbsIdSet::symmetricDifference(const RS_DbsIdSet& a, const RS_DbsIdSet& b, RS_DbsIdSet& result) {
+    std::vector<RS_Object::Id> ret;
+    ret.reserve(a.ids.size() + b.ids.size());
+
+    const_iterator i = a.ids.begin();
+    const_iterator j = b.ids.begin();
+    while (i!=a.ids.end() && j!=b.ids.end()) {
+        if (*i<*j) {
+            const_iterator k = gallop(i, a.ids.end(), *j);
+            ret.insert(ret.end(), i, k);
+            i = k;
+        }
+        else if (*j<*i) {
+            const_iterator k = gallop(j, b.ids.end(), *i);
+            ret.insert(ret.end(), j, k);
+            j = k;
+        }
+        else {
+            ++i;
+            ++j;
+        }
+    }
+    ret.insert(ret.end(), i, a.ids.end());
+    ret.insert(ret.end(), j, b.ids.end());
+
+    result.ids.swap(ret);
+}
+
+
+
+/**
+ * Exponential search: finds the first ID in [first, last) that is not
+ * less than \c id by probing at distances 1, 2, 4, ... and then
+ * searching binary in the last interval. This is O(log d) where d is
+ * the distance to the result, so skipping a short run costs only a few
+ * comparisons and a long run is not traversed linearly.
+ */
+RS_DbsIdSet::const_iterator RS_DbsIdSet::gallop(
+    const_iterator first, const_iterator last, RS_Object::Id id) {
+
+    if (first==last || !(*first<id)) {
+        return first;
+    }
+
+    // invariant: first[bound/2] < id
+    size_t n = last - first;
+    size_t bound = 1;
+    while (bound<n && first[bound]<id) {
+        bound *= 2;
+    }
+
+    return std::lower_bound(
+        first + bound/2 + 1,
+        first + std::min(bound+1, n),
+        id
+    );
+}
@@ -0,0 +1,112 @@
+#ifndef RS_DBSIDSET_H
+#define RS_DBSIDSET_H
+
+#include <set>
+#include <vector>
+
+#include "RS_Object"
+
+
+
+/**
+ * Compact set of object IDs, stored as a sorted vector without
+ * duplicates. Compared to std::set, an ID takes the size of the ID
+ * instead of a tree node (roughly 40 bytes) and iterating or combining
+ * sets reads memory sequentially.
+ *
+ * Union, intersection and differences are linear merges that gallop
+ * (exponential search) over runs of IDs that are only in one of the
+ * sets. Combining a small set with a large one therefore costs about
+ * O(m log(n/m)) comparisons for the intersection and the difference and
+ * a block copy of the runs for the union.
+ *
+ * Inserting an ID that is larger than all IDs in the set is O(1), so a
+ * set is built efficiently from IDs in ascending order, as they come
+ * from most queries. Inserting or erasing other IDs is O(n).
+ *
+ * \author Andrew Mustun
+ * \ingroup qcaddbstorage
+ */
+class RS_DbsIdSet {
+public:
+    typedef std::vector<RS_Object::Id>::const_iterator const_iterator;
+
+public:
+    RS_DbsIdSet() {}
+    explicit RS_DbsIdSet(const std::set<RS_Object::Id>& ids);
+
+    void assign(const std::vector<RS_Object::Id>& ids);
+
+    void insert(RS_Object::Id id);
+    bool erase(RS_Object::Id id);
+    bool contains(RS_Object::Id id) const;
+
+    /**
+     * \return Number of IDs in the set.
+     */
+    int size() const {
+        return (int)ids.size();
+    }
+
+    bool isEmpty() const {
+        return ids.empty();
+    }
+
+    void clear() {
+        ids.clear();
+    }
+
+    /**
+     * Reserves memory for the given number of IDs.
+     */
+    void reserve(int n) {
+        ids.reserve(n);
+    }
+
+    void swap(RS_DbsIdSet& other) {
+        ids.swap(other.ids);
+    }
+
+    const_iterator begin() const {
+        return ids.begin();
+    }
+
+    const_iterator end() const {
+        return ids.end();
+    }
+
+    /**
+     * \return The IDs in ascending order.
+     */
+    const std::vector<RS_Object::Id>& getIds() const {
+        return ids;
+    }
+
+    void toSet(std::set<RS_Object::Id>& result) const;
+
+    void unite(const RS_DbsIdSet& other);
+    void intersect(const RS_DbsIdSet& other);
+    void subtract(const RS_DbsIdSet& other);
+
+    static void unite(const RS_DbsIdSet& a, const RS_DbsIdSet& b, RS_DbsIdSet& result);
+    static void intersect(const RS_DbsIdSet& a, const RS_DbsIdSet& b, RS_DbsIdSet& result);
+    static void subtract(const RS_DbsIdSet& a, const RS_DbsIdSet& b, RS_DbsIdSet& result);
+    static void symmetricDifference(const RS_DbsIdSet& a, const RS_DbsIdSet& b, RS_DbsIdSet& result);
+
+    bool operator==(const RS_DbsIdSet& other) const {
+        return ids==other.ids;
+    }
+
+    bool operator!=(const RS_DbsIdSet& other) const {
+        return ids!=other.ids;
+    }
+
+private:
+    static const_iterator gallop(const_iterator first, const_iterator last, RS_Object::Id id);
+
+private:
+    //! sorted IDs without duplicates:
+    std::vector<RS_Object::Id> ids;
+};
+
+#endif
@@ -0,0 +1,83 @@
+#include <sstream>
+
+#include "RS_DbsIdTable"
+#include "RS_DbClient"
+#include "RS_DbsStatementCache"
+
+
+
+/**
+ * Replaces the contents of the given temporary ID table with the given
+ * IDs. The table is created if it does not exist yet.
+ */
+void RS_DbsIdTable::fill(
+    RS_DbConnection& db, const std::string& table, 
+    const std::set<RS_Object::Id>& ids) {
+
+    clear(db, table);
+    insert(db, table, ids.begin(), ids.end(), ids.size());
+}
+
+
+
+/**
+ * \overload
+ * The given IDs must be unique.
+ */
+void RS_DbsIdTable::fill(
+    RS_DbConnection& db, const std::string& table, 
+    const std::vector<RS_Object::Id>& ids) {
+
+    clear(db, table);
+    insert(db, table, ids.begin(), ids.end(), ids.size());
+}
+
+
+
+/**
+ * Removes all IDs from the given temporary ID table. The table is 
+ * created if it does not exist yet.
+ */
+void RS_DbsIdTable::clear(RS_DbConnection& db, const std::string& table) {
+    RS_DbsStatementCache::prepare(
+        db, 
+        "CREATE TEMP TABLE IF NOT EXISTS " + table + "("
+            "id INTEGER PRIMARY KEY"
+        ");"
+    ).executeNonQuery();
+
+    RS_DbsStatementCache::prepare(
+        db, 
+        "DELETE FROM temp." + table
+    ).executeNonQuery();
+}
+
+
+
+/**
+ * Inserts the given IDs into the given ID table with multi-row inserts.
+ */
+template<class Iterator>
+void RS_DbsIdTable::insert(
+    RS_DbConnection& db, const std::string& table, 
+    Iterator begin, Iterator end, size_t count) {
+
+    Iterator it = begin;
+    while (it!=end) {
+        int rows = (count>=(size_t)idsPerInsert) ? idsPerInsert : 1;
+
+        std::stringstream ss;
+        ss << "INSERT INTO temp." << table << " VALUES(?)";
+        for (int r=1; r<rows; ++r) {
+            ss << ",(?)";
+        }
+
+        RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(db, ss.str());
+        for (int r=0; r<rows; ++r, ++it) {
+            cmd.bind(r+1, *it);
+        }
+        cmd.executeNonQuery();
+
+        count -= rows;
+    }
+}
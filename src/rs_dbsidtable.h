@@ -0,0 +1,56 @@
+#ifndef RS_DBSIDTABLE_H
+#define RS_DBSIDTABLE_H
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "RS_Object"
+
+class RS_DbConnection;
+
+
+
+/**
+ * Binds sets of object IDs to SQL statements through temporary tables.
+ * This replaces SQL strings with embedded ID lists (e.g. 
+ * "... WHERE id IN (1,7,5,17)"), which have to be parsed every time and
+ * can exceed the maximum SQL length of SQLite for large sets.
+ *
+ * Every ID table is a temporary table with a single column \b id. 
+ * Statements refer to it with a sub-select or join:
+ *
+ * \code
+ * RS_DbsIdTable::fill(db, "IdSet", objectIds);
+ * RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
+ *     db, 
+ *     "UPDATE Object "
+ *     "SET undoStatus=NOT(undoStatus) "
+ *     "WHERE id IN (SELECT id FROM temp.IdSet)"
+ * );
+ * cmd.executeNonQuery();
+ * \endcode
+ *
+ * Since the SQL text does not depend on the IDs, such statements can be
+ * cached. The table has to be filled (and thereby created) before a 
+ * statement that refers to it is prepared for the first time. 
+ * Operations that may be nested have to use different table names.
+ *
+ * \author Andrew Mustun
+ * \ingroup qcaddbstorage
+ */
+class RS_DbsIdTable {
+public:
+    static void fill(RS_DbConnection& db, const std::string& table, const std::set<RS_Object::Id>& ids);
+    static void fill(RS_DbConnection& db, const std::string& table, const std::vector<RS_Object::Id>& ids);
+    static void clear(RS_DbConnection& db, const std::string& table);
+
+private:
+    template<class Iterator>
+    static void insert(RS_DbConnection& db, const std::string& table, Iterator begin, Iterator end, size_t count);
+
+    //! maximum number of IDs inserted with one statement:
+    static const int idsPerInsert = 256;
+};
+
+#endif
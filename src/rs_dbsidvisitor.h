@@ -0,0 +1,34 @@
+#ifndef RS_DBSIDVISITOR_H
+#define RS_DBSIDVISITOR_H
+
+#include "RS_Object"
+
+
+
+/**
+ * Visitor interface for the streaming query functions of RS_DbStorage,
+ * e.g. RS_DbStorage::queryAllEntities(RS_DbsIdVisitor&). IDs are
+ * reported in ascending order while the DB is being read, without
+ * collecting them first, so documents of any size can be traversed
+ * with constant memory.
+ *
+ * The visitor may query objects of the storage (e.g. with
+ * RS_DbStorage::queryEntity) but must not modify the document or the
+ * selection.
+ *
+ * \author Andrew Mustun
+ * \ingroup qcaddbstorage
+ */
+class RS_DbsIdVisitor {
+public:
+    virtual ~RS_DbsIdVisitor() {}
+
+    /**
+     * Called for every ID found by the query.
+     *
+     * \return False to stop the query.
+     */
+    virtual bool visit(RS_Object::Id id) = 0;
+};
+
+#endif
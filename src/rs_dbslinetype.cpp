@@ -1,7 +1,11 @@
+#include <cstring>
+
 #include "RS_DbsLineType"
 #include "RS_DbClient"
 #include "RS_LineEntity"
 #include "RS_DbsObjectTypeRegistry"
+#include "RS_DbsIdTable"
+#include "RS_DbsStatementCache"
 
 
 
@@ -18,14 +22,9 @@ void RS_DbsLineType::initDb(RS_DbConnection& db) {
     RS_DbsEntityType::initDb(db);
 
     db.executeNonQuery(
-        "CREATE TABLE Line("
-            "id INT PRIMARY KEY, "
-            "x1 REAL, "
-            "y1 REAL, "
-            "z1 REAL, "
-            "x2 REAL, "
-            "y2 REAL, "
-            "z2 REAL"
+        "CREATE TABLE IF NOT EXISTS Line("
+            "id INTEGER PRIMARY KEY, "
+            "geometry BLOB"
         ");"
     );
 }
@@ -41,8 +40,14 @@ RS_Object* RS_DbsLineType::loadObject(RS_DbConnection& db, RS_Object::Id objectI
 
 
 
+/**
+ * Loads the entity and line data with a single query that joins the 
+ * tables \b Entity and \b Line. Every statement outside of a 
+ * transaction is a read transaction of its own, which is expensive 
+ * for documents in WAL mode.
+ */
 void RS_DbsLineType::loadObject(RS_DbConnection& db, RS_Object& object, RS_Object::Id objectId) {
-    RS_DbsEntityType::loadObject(db, object, objectId);
+    RS_DbsObjectType::loadObject(db, object, objectId);
 
     RS_LineEntity* line = dynamic_cast<RS_LineEntity*>(&object);
     if (line==NULL) {
@@ -50,33 +55,74 @@ void RS_DbsLineType::loadObject(RS_DbConnection& db, RS_Object& object, RS_Objec
         return;
     }
 
-    RS_DbCommand cmd(
+    RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
         db, 
-        "SELECT x1,y1,z1,x2,y2,z2 "
-        "FROM Line "
-        "WHERE id=?"
+        "SELECT selectionStatus, geometry "
+        "FROM Entity, Line "
+        "WHERE Entity.id=?1 "
+        "  AND Line.id=?1"
     );
     cmd.bind(1, objectId);
 
-    RS_DbReader reader = cmd.executeReader();
-    if (!reader.read()) {
+    RS_DbsReader reader = cmd.executeReader();
+    if (!reader.read() || !unpackGeometry(reader.getBlob(1), line->getData())) {
         RS_Debug::error("RS_DbsLineType::readEntityData: "
             "cannot read data for entity %d", objectId);
         return;
     }
+    line->setSelected(reader.getInt(0)!=0);
+}
+
+
+
+/**
+ * Loads all lines with the given IDs with a single query that joins
+ * the tables \b Object, \b Entity and \b Line. The CROSS JOIN keeps
+ * SQLite from scanning \b Object and looking up the IDs the other way
+ * round.
+ */
+void RS_DbsLineType::loadObjects(
+    RS_DbConnection& db, std::set<RS_Object::Id>& objectIds, 
+    std::vector<RS_Object*>& result) {
+
+    RS_DbsIdTable::fill(db, "LoadIds", objectIds);
+
+    RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
+        db, 
+        "SELECT Object.id, selectionStatus, geometry "
+        "FROM temp.LoadIds CROSS JOIN Object, Entity, Line "
+        "WHERE Object.id=LoadIds.id "
+        "  AND Entity.id=Object.id "
+        "  AND Line.id=Object.id"
+    );
+
+    RS_DbsReader reader = cmd.executeReader();
+    while (reader.read()) {
+        RS_LineData data;
+        if (!unpackGeometry(reader.getBlob(2), data)) {
+            RS_Debug::error("RS_DbsLineType::loadObjects: "
+                "cannot read data for entity %d", (int)reader.getInt64(0));
+            continue;
+        }
+
+        RS_LineEntity* line = new RS_LineEntity(data, reader.getInt64(0));
+        line->setSelected(reader.getInt(1)!=0);
+        result.push_back(line);
+    }
+}
+
 
-    RS_Vector startPoint;
-    RS_Vector endPoint;
 
-    startPoint.x = reader.getDouble(0);
-    startPoint.y = reader.getDouble(1);
-    startPoint.z = reader.getDouble(2);
-    endPoint.x = reader.getDouble(3);
-    endPoint.y = reader.getDouble(4);
-    endPoint.z = reader.getDouble(5);
+RS_Object* RS_DbsLineType::cloneObject(RS_Object& object) {
+    RS_LineEntity* line = dynamic_cast<RS_LineEntity*>(&object);
+    if (line==NULL) {
+        RS_Debug::error("RS_DbsLineType::cloneObject: given object not a line");
+        return NULL;
+    }
 
-    line->getData().startPoint = startPoint;
-    line->getData().endPoint = endPoint;
+    RS_LineEntity* clone = new RS_LineEntity(line->getData(), line->getId());
+    clone->setSelected(line->isSelected());
+    return clone;
 }
 
 
@@ -90,43 +136,34 @@ void RS_DbsLineType::saveObject(RS_DbConnection& db, RS_Object& object, bool isN
         return;
     }
 
-    RS_LineData& data = line->getData();
+    char geometry[geometrySize];
+    packGeometry(line->getData(), geometry);
 
     // add line as new entity:
     if (isNew) {
-        RS_DbCommand cmd(
+        RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
             db, 
             "INSERT INTO Line "
-            "VALUES(?,?,?,?,?,?,?)"
+            "VALUES(?,?)"
         );
 
         cmd.bind(1, line->getId());
-        cmd.bind(2, data.startPoint.x);
-        cmd.bind(3, data.startPoint.y);
-        cmd.bind(4, data.startPoint.z);
-        cmd.bind(5, data.endPoint.x);
-        cmd.bind(6, data.endPoint.y);
-        cmd.bind(7, data.endPoint.z);
+        cmd.bindBlob(2, geometry, geometrySize);
         
         cmd.executeNonQuery();
     }
 
     // update existing line:
     else {
-        RS_DbCommand cmd(
+        RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
             db, 
             "UPDATE Line "
-            "SET x1=?, y1=?, z1=?, x2=?, y2=?, z2=? "
+            "SET geometry=? "
             "WHERE id=?"
         );
         
-        cmd.bind(1, data.startPoint.x);
-        cmd.bind(2, data.startPoint.y);
-        cmd.bind(3, data.startPoint.z);
-        cmd.bind(4, data.endPoint.x);
-        cmd.bind(5, data.endPoint.y);
-        cmd.bind(6, data.endPoint.z);
-        cmd.bind(7, line->getId());
+        cmd.bindBlob(1, geometry, geometrySize);
+        cmd.bind(2, line->getId());
         
         cmd.executeNonQuery();
     }
@@ -134,8 +171,61 @@ void RS_DbsLineType::saveObject(RS_DbConnection& db, RS_Object& object, bool isN
 
 
 
+/**
+ * Bulk insert of new lines with preassigned IDs. Uses multi-row inserts
+ * for the tables \b Object, \b Entity and \b Line.
+ *
+ * Objects that are not lines are not stored, their ID is reset to -1.
+ */
+void RS_DbsLineType::saveObjects(RS_DbConnection& db, std::vector<RS_Object*>& objects) {
+    // reject objects before building the batches, so that every row of
+    // a multi-row insert is bound:
+    std::vector<RS_Object*> lines;
+    lines.reserve(objects.size());
+    std::vector<RS_Object*>::iterator it;
+    for (it=objects.begin(); it!=objects.end(); ++it) {
+        if (dynamic_cast<RS_LineEntity*>(*it)==NULL) {
+            RS_Debug::error("RS_DbsLineType::saveObjects: given object not a line");
+            (*it)->setId(-1);
+            continue;
+        }
+        lines.push_back(*it);
+    }
+
+    insertObjects(db, lines);
+    insertEntities(db, lines);
+
+    size_t i = 0;
+    while (i<lines.size()) {
+        int rows = RS_DbsStatementCache::rowsPerInsert;
+        if (lines.size()-i<(size_t)rows) {
+            rows = 1;
+        }
+        RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
+            db, 
+            RS_DbsStatementCache::getInsertSql("Line", 2, rows)
+        );
+
+        // the blobs must stay valid until the statement is executed:
+        std::vector<char> geometry(rows * geometrySize);
+
+        for (int r=0; r<rows; ++r, ++i) {
+            RS_LineEntity* line = static_cast<RS_LineEntity*>(lines[i]);
+
+            char* g = &geometry[r * geometrySize];
+            packGeometry(line->getData(), g);
+            cmd.bind(r*2 + 1, line->getId());
+            cmd.bindBlob(r*2 + 2, g, geometrySize);
+        }
+
+        cmd.executeNonQuery();
+    }
+}
+
+
+
 void RS_DbsLineType::deleteObject(RS_DbConnection& db, RS_Object::Id objectId) {
-    RS_DbCommand cmd(
+    RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
         db, 
         "DELETE FROM Line "
         "WHERE id=?"
@@ -146,3 +236,89 @@ void RS_DbsLineType::deleteObject(RS_DbConnection& db, RS_Object::Id objectId) {
     RS_DbsEntityType::deleteObject(db, objectId);
 }
 
+
+
+/**
+ * Deletes all lines with the given IDs with one statement per table.
+ */
+void RS_DbsLineType::deleteObjects(RS_DbConnection& db, std::set<RS_Object::Id>& objectIds) {
+    RS_DbsIdTable::fill(db, "DeleteIds", objectIds);
+
+    RS_DbsStatementCache::prepare(
+        db, 
+        "DELETE FROM Line "
+        "WHERE id IN (SELECT id FROM temp.DeleteIds)"
+    ).executeNonQuery();
+
+    deleteEntityRecords(db, "DeleteIds");
+}
+
+
+
+/**
+ * Packs the start and end point of the given line into the \b geometry
+ * BLOB of table \b Line (\ref geometrySize bytes, see class 
+ * documentation).
+ */
+void RS_DbsLineType::packGeometry(const RS_LineData& data, char* geometry) {
+    double coordinates[6] = {
+        data.startPoint.x, data.startPoint.y, data.startPoint.z,
+        data.endPoint.x, data.endPoint.y, data.endPoint.z
+    };
+    memcpy(geometry, coordinates, geometrySize);
+
+    if (!isLittleEndian()) {
+        swapBytes(geometry);
+    }
+}
+
+
+
+/**
+ * Unpacks the \b geometry BLOB of table \b Line into the start and end
+ * point of the given line.
+ *
+ * \return False if the BLOB does not have the expected size.
+ */
+bool RS_DbsLineType::unpackGeometry(const std::string& geometry, RS_LineData& data) {
+    if (geometry.size()!=(size_t)geometrySize) {
+        return false;
+    }
+
+    double coordinates[6];
+    memcpy(coordinates, geometry.data(), geometrySize);
+
+    if (!isLittleEndian()) {
+        swapBytes((char*)coordinates);
+    }
+
+    data.startPoint.x = coordinates[0];
+    data.startPoint.y = coordinates[1];
+    data.startPoint.z = coordinates[2];
+    data.endPoint.x = coordinates[3];
+    data.endPoint.y = coordinates[4];
+    data.endPoint.z = coordinates[5];
+    return true;
+}
+
+
+
+bool RS_DbsLineType::isLittleEndian() {
+    const unsigned short one = 1;
+    return *(const unsigned char*)&one==1;
+}
+
+
+
+/**
+ * Reverses the byte order of the six doubles of a packed geometry.
+ */
+void RS_DbsLineType::swapBytes(char* geometry) {
+    for (int i=0; i<geometrySize; i+=8) {
+        for (int k=0; k<4; k++) {
+            char c = geometry[i+k];
+            geometry[i+k] = geometry[i+7-k];
+            geometry[i+7-k] = c;
+        }
+    }
+}
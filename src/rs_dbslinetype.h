@@ -9,17 +9,19 @@
  * Line entities are stored in a table with the following schema:
  *
  * \b Line
- * - \b id: Entity ID.
- * - \b x1: X ordiante of the start point.
- * - \b y1: Y ordiante of the start point.
- * - \b z1: Z ordiante of the start point.
- * - \b x2: X ordiante of the end point.
- * - \b y2: Y ordiante of the end point.
- * - \b z2: Z ordiante of the end point.
+ * - \b id: Entity ID (rowid).
+ * - \b geometry: Start and end point packed into a BLOB of 
+ *   \ref geometrySize bytes: x1, y1, z1, x2, y2, z2 as IEEE 754 
+ *   doubles in little endian byte order.
  *
  * The \b Line table stores data that is specific to line entities.
  * Common data for all entities is stored in table \b Entity.
  *
+ * Keying on the rowid saves the separate primary key index of the 
+ * schema before version 3 (six REAL columns under "id INT PRIMARY 
+ * KEY"), the packed geometry is read and written with one memcpy on 
+ * little endian platforms instead of decoding six columns.
+ *
  * \author Andrew Mustun
  * \ingroup qcaddbstorage
  */
@@ -33,6 +35,22 @@ public:
     virtual void initDb(RS_DbConnection& db);
     virtual RS_Object* loadObject(RS_DbConnection& db, RS_Object::Id objectId);
     virtual void loadObject(RS_DbConnection& db, RS_Object& object, RS_Object::Id objectId);
+    virtual void loadObjects(RS_DbConnection& db, std::set<RS_Object::Id>& objectIds, std::vector<RS_Object*>& result);
+    virtual RS_Object* cloneObject(RS_Object& object);
     virtual void saveObject(RS_DbConnection& db, RS_Object& entity, bool isNew);
+    virtual void saveObjects(RS_DbConnection& db, std::vector<RS_Object*>& objects);
     virtual void deleteObject(RS_DbConnection& db, RS_Object::Id objectId);
+    virtual void deleteObjects(RS_DbConnection& db, std::set<RS_Object::Id>& objectIds);
+
+    static void packGeometry(const RS_LineData& data, char* geometry);
+    static bool unpackGeometry(const std::string& geometry, RS_LineData& data);
+
+    /**
+     * Size of the packed geometry in bytes (six doubles).
+     */
+    static const int geometrySize = 48;
+
+private:
+    static bool isLittleEndian();
+    static void swapBytes(char* geometry);
 };
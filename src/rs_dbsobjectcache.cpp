@@ -0,0 +1,136 @@
+#include "RS_DbsObjectCache"
+
+
+
+RS_DbsObjectCache::RS_DbsObjectCache(int capacity) 
+    : capacity(capacity), hits(0), misses(0) {
+}
+
+
+
+RS_DbsObjectCache::~RS_DbsObjectCache() {
+    clear();
+}
+
+
+
+/**
+ * \return The cached object with the given ID or NULL. The returned
+ *      object is owned by the cache and must not be modified or
+ *      deleted.
+ */
+RS_Object* RS_DbsObjectCache::get(RS_Object::Id objectId) {
+    std::map<RS_Object::Id, Entry>::iterator it = objects.find(objectId);
+    if (it==objects.end()) {
+        misses++;
+        return NULL;
+    }
+
+    hits++;
+
+    // mark as most recently used:
+    lru.splice(lru.begin(), lru, it->second.position);
+    return it->second.object;
+}
+
+
+
+/**
+ * Adds the given object to the cache. The cache takes ownership of the
+ * object. An object with the same ID that is already in the cache is 
+ * replaced. The object is deleted immediately if the cache is disabled.
+ */
+void RS_DbsObjectCache::insert(RS_Object* object) {
+    if (object==NULL) {
+        return;
+    }
+
+    if (!isEnabled()) {
+        delete object;
+        return;
+    }
+
+    invalidate(object->getId());
+
+    lru.push_front(object->getId());
+    Entry entry;
+    entry.object = object;
+    entry.position = lru.begin();
+    objects[object->getId()] = entry;
+
+    evict();
+}
+
+
+
+/**
+ * Removes the object with the given ID from the cache. Has to be called
+ * whenever that object changes in the DB.
+ */
+void RS_DbsObjectCache::invalidate(RS_Object::Id objectId) {
+    std::map<RS_Object::Id, Entry>::iterator it = objects.find(objectId);
+    if (it==objects.end()) {
+        return;
+    }
+
+    delete it->second.object;
+    lru.erase(it->second.position);
+    objects.erase(it);
+}
+
+
+
+/**
+ * Removes all objects from the cache.
+ */
+void RS_DbsObjectCache::clear() {
+    std::map<RS_Object::Id, Entry>::iterator it;
+    for (it=objects.begin(); it!=objects.end(); ++it) {
+        delete it->second.object;
+    }
+    objects.clear();
+    lru.clear();
+}
+
+
+
+/**
+ * Sets the maximum number of objects in the cache. Objects are dropped
+ * if the cache currently contains more objects.
+ */
+void RS_DbsObjectCache::setCapacity(int capacity) {
+    this->capacity = capacity;
+    evict();
+}
+
+
+
+/**
+ * \return Ratio of cache hits to all lookups or 0 if there were no 
+ *      lookups.
+ */
+double RS_DbsObjectCache::getHitRate() const {
+    if (hits+misses==0) {
+        return 0.0;
+    }
+    return (double)hits / (hits+misses);
+}
+
+
+
+void RS_DbsObjectCache::resetCounters() {
+    hits = 0;
+    misses = 0;
+}
+
+
+
+/**
+ * Drops least recently used objects until the size is within the
+ * capacity.
+ */
+void RS_DbsObjectCache::evict() {
+    while ((int)objects.size()>capacity && !lru.empty()) {
+        invalidate(lru.back());
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef RS_DBSOBJECTCACHE_H
+#define RS_DBSOBJECTCACHE_H
+
+#include <list>
+#include <map>
+
+#include "RS_Object"
+
+
+
+/**
+ * Size bounded cache of objects that were loaded from the DB. When the
+ * cache is full, the least recently used object is dropped.
+ *
+ * The cache owns the objects it contains. Clients never get the 
+ * cached instances, RS_DbStorage hands out copies made with 
+ * RS_DbsObjectType::cloneObject. Copying an object in memory is much
+ * cheaper than loading it from the DB again.
+ *
+ * A capacity of 0 disables the cache.
+ *
+ * \author Andrew Mustun
+ * \ingroup qcaddbstorage
+ */
+class RS_DbsObjectCache {
+public:
+    RS_DbsObjectCache(int capacity=0);
+    ~RS_DbsObjectCache();
+
+    RS_Object* get(RS_Object::Id objectId);
+    void insert(RS_Object* object);
+    void invalidate(RS_Object::Id objectId);
+    void clear();
+
+    void setCapacity(int capacity);
+
+    /**
+     * \return Maximum number of cached objects.
+     */
+    int getCapacity() const {
+        return capacity;
+    }
+
+    /**
+     * \return true if the cache has a capacity greater than 0.
+     */
+    bool isEnabled() const {
+        return capacity>0;
+    }
+
+    /**
+     * \return Number of objects currently in the cache.
+     */
+    int getSize() const {
+        return (int)objects.size();
+    }
+
+    int getHits() const {
+        return hits;
+    }
+
+    int getMisses() const {
+        return misses;
+    }
+
+    double getHitRate() const;
+    void resetCounters();
+
+private:
+    RS_DbsObjectCache(const RS_DbsObjectCache&);
+    RS_DbsObjectCache& operator=(const RS_DbsObjectCache&);
+
+    void evict();
+
+private:
+    struct Entry {
+        RS_Object* object;
+        //! position in the LRU list:
+        std::list<RS_Object::Id>::iterator position;
+    };
+
+    int capacity;
+    //! IDs of cached objects, most recently used first:
+    std::list<RS_Object::Id> lru;
+    std::map<RS_Object::Id, Entry> objects;
+    int hits;
+    int misses;
+};
+
+#endif
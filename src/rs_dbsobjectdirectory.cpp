@@ -0,0 +1,137 @@
+#include "RS_DbsObjectDirectory"
+#include "RS_DbClient"
+#include "RS_Debug"
+
+
+
+/**
+ * Removes all objects from the directory.
+ */
+void RS_DbsObjectDirectory::clear() {
+    entries.clear();
+    sparseEntries.clear();
+    size = 0;
+}
+
+
+
+/**
+ * Rebuilds the directory from table \b Object of the given DB with 
+ * a single scan. Used when an existing document is opened. IDs are
+ * read in ascending order, so the dense range grows with the number 
+ * of objects read.
+ */
+void RS_DbsObjectDirectory::rebuild(RS_DbConnection& db) {
+    clear();
+
+    RS_DbCommand cmd(
+        db, 
+        "SELECT id, objectTypeId, undoStatus "
+        "FROM Object "
+        "ORDER BY id"
+    );
+
+    RS_DbReader reader = cmd.executeReader();
+    while (reader.read()) {
+        insert(
+            reader.getInt64(0), 
+            (RS_Object::ObjectTypeId)reader.getInt64(1), 
+            reader.getInt(2)!=0
+        );
+    }
+}
+
+
+
+/**
+ * Adds the given object to the directory or updates its entry.
+ */
+void RS_DbsObjectDirectory::insert(
+    RS_Object::Id objectId, RS_Object::ObjectTypeId objectTypeId, bool undone) {
+
+    if (objectId<0) {
+        RS_Debug::error("RS_DbsObjectDirectory::insert: invalid object ID: %d", objectId);
+        return;
+    }
+
+    Entry* entry = find(objectId);
+    if (entry==NULL) {
+        size++;
+        if (objectId<(RS_Object::Id)entries.size()) {
+            entry = &entries[objectId];
+        }
+        else if (objectId<2*size + denseSlack) {
+            grow(objectId+1);
+            entry = &entries[objectId];
+        }
+        else {
+            entry = &sparseEntries[objectId];
+        }
+    }
+
+    entry->objectTypeId = objectTypeId;
+    entry->undone = undone;
+}
+
+
+
+/**
+ * Removes the given object from the directory.
+ */
+void RS_DbsObjectDirectory::remove(RS_Object::Id objectId) {
+    if (!contains(objectId)) {
+        return;
+    }
+
+    size--;
+    if (objectId>=(RS_Object::Id)entries.size()) {
+        sparseEntries.erase(objectId);
+        return;
+    }
+
+    entries[objectId] = Entry();
+
+    // release trailing free entries:
+    if (objectId==(RS_Object::Id)entries.size()-1) {
+        while (!entries.empty() && 
+            entries.back().objectTypeId==RS_Object::UnknownObject) {
+            entries.pop_back();
+        }
+    }
+}
+
+
+
+void RS_DbsObjectDirectory::setUndoStatus(RS_Object::Id objectId, bool undone) {
+    Entry* entry = find(objectId);
+    if (entry==NULL) {
+        return;
+    }
+    entry->undone = undone;
+}
+
+
+
+void RS_DbsObjectDirectory::toggleUndoStatus(RS_Object::Id objectId) {
+    Entry* entry = find(objectId);
+    if (entry==NULL) {
+        return;
+    }
+    entry->undone = !entry->undone;
+}
+
+
+
+/**
+ * Grows the vector of entries to the given size and moves the entries
+ * of the IDs now in range from the map.
+ */
+void RS_DbsObjectDirectory::grow(RS_Object::Id newSize) {
+    entries.resize(newSize);
+
+    std::map<RS_Object::Id, Entry>::iterator it = sparseEntries.begin();
+    while (it!=sparseEntries.end() && it->first<newSize) {
+        entries[it->first] = it->second;
+        sparseEntries.erase(it++);
+    }
+}
@@ -0,0 +1,122 @@
+#ifndef RS_DBSOBJECTDIRECTORY_H
+#define RS_DBSOBJECTDIRECTORY_H
+
+#include <map>
+#include <vector>
+
+#include "RS_Object"
+
+class RS_DbConnection;
+
+
+
+/**
+ * In-memory directory of all objects stored in a DB. For every object
+ * ID, the directory knows the object type ID and the undo status. 
+ * RS_DbStorage uses it to find the right RS_DbsObjectType for an object
+ * without querying the DB.
+ *
+ * Object IDs are assigned densely by SQLite, so the directory is a
+ * vector indexed by object ID. The vector only grows while at least 
+ * half of its entries are used. IDs far beyond the dense range, for
+ * example IDs assigned by another application, are kept in a map, so 
+ * a single large ID does not allocate an entry for every smaller ID.
+ *
+ * \author Andrew Mustun
+ * \ingroup qcaddbstorage
+ */
+class RS_DbsObjectDirectory {
+public:
+    RS_DbsObjectDirectory() : size(0) {}
+
+    void clear();
+    void rebuild(RS_DbConnection& db);
+
+    void insert(RS_Object::Id objectId, RS_Object::ObjectTypeId objectTypeId, bool undone=false);
+    void remove(RS_Object::Id objectId);
+    void setUndoStatus(RS_Object::Id objectId, bool undone);
+    void toggleUndoStatus(RS_Object::Id objectId);
+
+    /**
+     * \return true if an object with the given ID exists (undone or not).
+     */
+    bool contains(RS_Object::Id objectId) const {
+        return find(objectId)!=NULL;
+    }
+
+    /**
+     * \return Object type ID of the given object or 
+     *      RS_Object::UnknownObject if the object does not exist. 
+     *      Objects that are undone are reported with their type.
+     */
+    RS_Object::ObjectTypeId getObjectTypeId(RS_Object::Id objectId) const {
+        const Entry* entry = find(objectId);
+        if (entry==NULL) {
+            return RS_Object::UnknownObject;
+        }
+        return entry->objectTypeId;
+    }
+
+    /**
+     * \return true if the given object is undone or does not exist.
+     */
+    bool isUndone(RS_Object::Id objectId) const {
+        const Entry* entry = find(objectId);
+        if (entry==NULL) {
+            return true;
+        }
+        return entry->undone;
+    }
+
+    /**
+     * \return Number of objects in the directory.
+     */
+    int getSize() const {
+        return size;
+    }
+
+private:
+    struct Entry {
+        Entry() : objectTypeId(RS_Object::UnknownObject), undone(false) {}
+        RS_Object::ObjectTypeId objectTypeId;
+        bool undone;
+    };
+
+    /**
+     * \return Entry of the given object or NULL if the object does not
+     *      exist.
+     */
+    const Entry* find(RS_Object::Id objectId) const {
+        if (objectId>=0 && objectId<(RS_Object::Id)entries.size()) {
+            const Entry& entry = entries[objectId];
+            return entry.objectTypeId==RS_Object::UnknownObject ? NULL : &entry;
+        }
+        if (sparseEntries.empty()) {
+            return NULL;
+        }
+        std::map<RS_Object::Id, Entry>::const_iterator it = 
+            sparseEntries.find(objectId);
+        return it==sparseEntries.end() ? NULL : &it->second;
+    }
+
+    Entry* find(RS_Object::Id objectId) {
+        return const_cast<Entry*>(
+            static_cast<const RS_DbsObjectDirectory*>(this)->find(objectId)
+        );
+    }
+
+    void grow(RS_Object::Id newSize);
+
+private:
+    //! entries indexed by object ID:
+    std::vector<Entry> entries;
+    //! entries of IDs beyond the end of \ref entries:
+    std::map<RS_Object::Id, Entry> sparseEntries;
+    //! number of objects:
+    int size;
+
+    //! \ref entries may grow to twice the number of objects plus this:
+    static const int denseSlack = 1024;
+};
+
+#endif
@@ -1,6 +1,9 @@
 #include "RS_DbsObjectType"
 #include "RS_DbConnection"
 #include "RS_DbCommand"
+#include "RS_DbsIdSet"
+#include "RS_DbsIdVisitor"
+#include "RS_DbsStatementCache"
 
 
 
@@ -31,6 +34,30 @@ void RS_DbsObjectType::loadObject(RS_DbConnection& /*db*/, RS_Object& object, RS
 
 
 
+/**
+ * Instantiates all objects with the given IDs from the DB and appends
+ * them to \c result. All given objects are of the type handled by 
+ * this class. The caller is responsible for deleting the instances.
+ *
+ * The default implementation calls \ref loadObject for every object.
+ * Implementations may override this to load all objects with a 
+ * single query.
+ */
+void RS_DbsObjectType::loadObjects(
+    RS_DbConnection& db, std::set<RS_Object::Id>& objectIds, 
+    std::vector<RS_Object*>& result) {
+
+    std::set<RS_Object::Id>::iterator it;
+    for (it=objectIds.begin(); it!=objectIds.end(); ++it) {
+        RS_Object* object = loadObject(db, *it);
+        if (object!=NULL) {
+            result.push_back(object);
+        }
+    }
+}
+
+
+
 /**
  * Saves the given object to the DB.
  * The given object must be of the correct type, otherwise results are
@@ -41,12 +68,19 @@ void RS_DbsObjectType::saveObject(RS_DbConnection& db, RS_Object& object, bool i
     // new object:
     if (isNew) {
         // generic object information has to be stored for all object types:
-        RS_DbCommand cmd(
+        RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
             db, 
             "INSERT INTO Object VALUES(?,?,?);"
         );
 
-        cmd.bind(1);
+        // ID is assigned by the DB unless it was preassigned by a bulk 
+        // insert (see RS_DbStorage::saveObjects):
+        if (object.getId()==-1) {
+            cmd.bind(1);
+        }
+        else {
+            cmd.bind(1, object.getId());
+        }
         cmd.bind(2, object.getObjectTypeId());
         cmd.bind(3, 0);
 
@@ -63,12 +97,60 @@ void RS_DbsObjectType::saveObject(RS_DbConnection& db, RS_Object& object, bool i
 
 
 
+/**
+ * Saves the given new objects to the DB. All objects are of the type
+ * handled by this class and have IDs that were preassigned by the 
+ * caller (see RS_DbStorage::saveObjects).
+ *
+ * The default implementation calls \ref saveObject for every object.
+ * Implementations may override this to store the objects with 
+ * multi-row inserts instead.
+ */
+void RS_DbsObjectType::saveObjects(RS_DbConnection& db, std::vector<RS_Object*>& objects) {
+    std::vector<RS_Object*>::iterator it;
+    for (it=objects.begin(); it!=objects.end(); ++it) {
+        saveObject(db, *(*it), true);
+    }
+}
+
+
+
+/**
+ * Helper function for bulk inserts. Inserts the generic object 
+ * information for the given new objects with preassigned IDs into 
+ * table \b Object.
+ */
+void RS_DbsObjectType::insertObjects(RS_DbConnection& db, std::vector<RS_Object*>& objects) {
+    size_t i = 0;
+    while (i<objects.size()) {
+        int rows = RS_DbsStatementCache::rowsPerInsert;
+        if (objects.size()-i<(size_t)rows) {
+            rows = 1;
+        }
+        RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
+            db, 
+            RS_DbsStatementCache::getInsertSql("Object", 3, rows)
+        );
+
+        for (int r=0; r<rows; ++r, ++i) {
+            RS_Object* object = objects[i];
+            cmd.bind(r*3 + 1, object->getId());
+            cmd.bind(r*3 + 2, object->getObjectTypeId());
+            cmd.bind(r*3 + 3, 0);
+        }
+
+        cmd.executeNonQuery();
+    }
+}
+
+
+
 /**
  * Deletes the object with the given ID.
  * The implementation of the base class must also be called.
  */
 void RS_DbsObjectType::deleteObject(RS_DbConnection& db, RS_Object::Id objectId) {
-    RS_DbCommand cmd(
+    RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
         db, 
         "DELETE FROM Object "
         "WHERE id=?"
@@ -79,19 +161,125 @@ void RS_DbsObjectType::deleteObject(RS_DbConnection& db, RS_Object::Id objectId)
 
 
 
+/**
+ * Deletes all objects with the given IDs. All given objects are of the
+ * type handled by this class.
+ *
+ * The default implementation calls \ref deleteObject for every object.
+ * Implementations may override this to delete the objects with one 
+ * set based statement per table.
+ */
+void RS_DbsObjectType::deleteObjects(RS_DbConnection& db, std::set<RS_Object::Id>& objectIds) {
+    std::set<RS_Object::Id>::iterator it;
+    for (it=objectIds.begin(); it!=objectIds.end(); ++it) {
+        deleteObject(db, *it);
+    }
+}
+
+
+
+/**
+ * Helper function for set based deletes. Deletes the records of all 
+ * objects in the given ID table (see RS_DbsIdTable) from table 
+ * \b Object.
+ */
+void RS_DbsObjectType::deleteObjectRecords(RS_DbConnection& db, const std::string& idTable) {
+    RS_DbsStatementCache::prepare(
+        db, 
+        "DELETE FROM Object "
+        "WHERE id IN (SELECT id FROM temp." + idTable + ")"
+    ).executeNonQuery();
+}
+
+
+
 /**
  * Helper function for RS_DbStorage.
  */
 void RS_DbsObjectType::queryAllObjects(RS_DbConnection& db, std::set<RS_Object::Id>& result) {
-    RS_DbCommand cmd(
+    RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
         db, 
         "SELECT id "
         "FROM Object "
         "WHERE undoStatus=0"
     );
 
+    // IDs are read in ascending order:
+    RS_DbsReader reader = cmd.executeReader();
+    while (reader.read()) {
+        result.insert(result.end(), reader.getInt64(0));
+    }
+}
+
+
+
+/**
+ * \overload
+ */
+void RS_DbsObjectType::queryAllObjects(RS_DbConnection& db, RS_DbsIdSet& result) {
+    RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
+        db, 
+        "SELECT id "
+        "FROM Object "
+        "WHERE undoStatus=0"
+    );
+
+    // IDs are read in ascending order, so every insert is O(1):
+    RS_DbsIdSet ids;
+    RS_DbsReader reader = cmd.executeReader();
+    while (reader.read()) {
+        ids.insert(reader.getInt64(0));
+    }
+    result.unite(ids);
+}
+
+
+
+/**
+ * Helper function for RS_DbStorage. Reports the IDs of all objects 
+ * that are not undone to the given visitor.
+ */
+void RS_DbsObjectType::queryAllObjects(RS_DbConnection& db, RS_DbsIdVisitor& visitor) {
+    visitIds(
+        db, 
+        "SELECT id "
+        "FROM Object "
+        "WHERE undoStatus=0 "
+        "ORDER BY id", 
+        visitor
+    );
+}
+
+
+
+/**
+ * Runs the given query and reports the IDs in the first column to the
+ * given visitor while the result is being read. A statement of its own
+ * is used instead of a cached one, so the visitor may use cached 
+ * statements of the same connection.
+ */
+void RS_DbsObjectType::visitIds(
+    RS_DbConnection& db, const std::string& sql, RS_DbsIdVisitor& visitor) {
+
+    RS_DbCommand cmd(db, sql);
     RS_DbReader reader = cmd.executeReader();
     while (reader.read()) {
-        result.insert(reader.getInt64(0));
+        if (!visitor.visit(reader.getInt64(0))) {
+            break;
+        }
     }
 }
+
+
+
+/**
+ * \return Highest object ID that is in use or 0 for an empty DB.
+ */
+RS_Object::Id RS_DbsObjectType::getMaxObjectId(RS_DbConnection& db) {
+    RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
+        db, 
+        "SELECT IFNULL(MAX(id), 0) "
+        "FROM Object"
+    );
+    return cmd.executeInt();
+}
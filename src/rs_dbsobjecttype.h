@@ -1,10 +1,17 @@
 #ifndef RS_DBOBJECTTYPE_H
 #define RS_DBOBJECTTYPE_H
 
+#include <set>
+#include <string>
+#include <vector>
+
 #include "RS_Object"
 #include "RS_DbsObjectTypeRegistry"
 
+class RS_DbCommand;
 class RS_DbConnection;
+class RS_DbsIdSet;
+class RS_DbsIdVisitor;
 
 
 
@@ -31,11 +38,38 @@ public:
     
     virtual void loadObject(RS_DbConnection& db, RS_Object& object, RS_Object::Id objectId);
 
+    virtual void loadObjects(RS_DbConnection& db, std::set<RS_Object::Id>& objectIds, std::vector<RS_Object*>& result);
+
+    /**
+     * Creates a copy of the given object, which is of the type handled 
+     * by this class. Used by RS_DbStorage to hand out objects from its
+     * object cache. The caller is responsible for deleting the copy.
+     *
+     * The default implementation returns NULL, i.e. objects of this 
+     * type are not cached.
+     */
+    virtual RS_Object* cloneObject(RS_Object& /*object*/) {
+        return NULL;
+    }
+
     virtual void saveObject(RS_DbConnection& db, RS_Object& object, bool isNew);
+
+    virtual void saveObjects(RS_DbConnection& db, std::vector<RS_Object*>& objects);
     
     virtual void deleteObject(RS_DbConnection& db, RS_Object::Id objectId);
 
+    virtual void deleteObjects(RS_DbConnection& db, std::set<RS_Object::Id>& objectIds);
+
     static void queryAllObjects(RS_DbConnection& db, std::set<RS_Object::Id>& result);
+    static void queryAllObjects(RS_DbConnection& db, RS_DbsIdVisitor& visitor);
+    static void queryAllObjects(RS_DbConnection& db, RS_DbsIdSet& result);
+
+    static RS_Object::Id getMaxObjectId(RS_DbConnection& db);
+
+protected:
+    static void insertObjects(RS_DbConnection& db, std::vector<RS_Object*>& objects);
+    static void deleteObjectRecords(RS_DbConnection& db, const std::string& idTable);
+    static void visitIds(RS_DbConnection& db, const std::string& sql, RS_DbsIdVisitor& visitor);
 };
 
 #endif
@@ -0,0 +1,461 @@
+#include <cstring>
+
+#include "RS_DbsPropertyChangeCodec"
+#include "RS_Debug"
+
+
+
+/**
+ * Encodes the given property changes into a binary record.
+ *
+ * \param compress True to compress the record. The record is only
+ *      stored compressed if that actually makes it smaller.
+ */
+std::string RS_DbsPropertyChangeCodec::encode(
+    const std::multimap<RS_Object::Id, RS_PropertyChange>& propertyChanges,
+    bool compress) {
+
+    std::string payload;
+    writeVarint(payload, propertyChanges.size());
+
+    long long previousId = 0;
+    std::multimap<RS_Object::Id, RS_PropertyChange>::const_iterator it;
+    for (it=propertyChanges.begin(); it!=propertyChanges.end(); ++it) {
+        const RS_PropertyChange& pc = (*it).second;
+        RS_PropertyValue::DataType dataType = pc.oldValue.getDataType();
+
+        writeVarint(payload, (unsigned long long)((*it).first - previousId));
+        previousId = (*it).first;
+        writeSigned(payload, pc.propertyTypeId);
+
+        unsigned char type = (unsigned char)dataType;
+        if (dataType==RS_PropertyValue::Boolean) {
+            if (pc.oldValue.getBool()) {
+                type |= 0x10;
+            }
+            if (pc.newValue.getBool()) {
+                type |= 0x20;
+            }
+        }
+        payload += (char)type;
+
+        writeValue(payload, pc.oldValue);
+        writeValue(payload, pc.newValue);
+    }
+
+    if (compress && payload.size()>=minCompressSize) {
+        std::string compressed = RS_DbsPropertyChangeCodec::compress(payload);
+        std::string ret;
+        ret += (char)Compressed;
+        writeVarint(ret, payload.size());
+        if (ret.size() + compressed.size() < payload.size() + 1) {
+            ret += compressed;
+            return ret;
+        }
+    }
+
+    return (char)Plain + payload;
+}
+
+
+
+/**
+ * Decodes a record created with \ref encode and adds all property
+ * changes to \c propertyChanges.
+ *
+ * \return False if the record is corrupt.
+ */
+bool RS_DbsPropertyChangeCodec::decode(
+    const std::string& data,
+    std::multimap<RS_Object::Id, RS_PropertyChange>& propertyChanges) {
+
+    if (data.empty()) {
+        return true;
+    }
+
+    std::string plain;
+    size_t pos = 1;
+    switch ((unsigned char)data[0]) {
+    case Plain:
+        break;
+    case Compressed: {
+        unsigned long long rawSize;
+        if (!readVarint(data, pos, rawSize) ||
+            !decompress(data, pos, (size_t)rawSize, plain)) {
+            RS_Debug::error("RS_DbsPropertyChangeCodec::decode: "
+                "corrupt compressed record");
+            return false;
+        }
+        pos = 0;
+        break;
+    }
+    default:
+        RS_Debug::error("RS_DbsPropertyChangeCodec::decode: "
+            "unknown record format: %d", (int)(unsigned char)data[0]);
+        return false;
+    }
+
+    const std::string& payload = plain.empty() ? data : plain;
+
+    unsigned long long count;
+    if (!readVarint(payload, pos, count)) {
+        RS_Debug::error("RS_DbsPropertyChangeCodec::decode: corrupt record");
+        return false;
+    }
+
+    long long previousId = 0;
+    for (unsigned long long i=0; i<count; ++i) {
+        unsigned long long oidDelta;
+        long long pid;
+        if (!readVarint(payload, pos, oidDelta) ||
+            !readSigned(payload, pos, pid) ||
+            pos>=payload.size()) {
+
+            RS_Debug::error("RS_DbsPropertyChangeCodec::decode: corrupt record");
+            return false;
+        }
+        unsigned char type = (unsigned char)payload[pos++];
+        RS_PropertyValue::DataType dataType = (RS_PropertyValue::DataType)(type & 0x0f);
+
+        RS_PropertyChange pc;
+        pc.propertyTypeId = (int)pid;
+        if (dataType==RS_PropertyValue::Boolean) {
+            pc.oldValue = RS_PropertyValue((type & 0x10)!=0);
+            pc.newValue = RS_PropertyValue((type & 0x20)!=0);
+        }
+        else if (!readValue(payload, pos, dataType, pc.oldValue) ||
+                 !readValue(payload, pos, dataType, pc.newValue)) {
+
+            RS_Debug::error("RS_DbsPropertyChangeCodec::decode: corrupt record");
+            return false;
+        }
+
+        previousId += (long long)oidDelta;
+        propertyChanges.insert(
+            std::pair<RS_Object::Id, RS_PropertyChange>((RS_Object::Id)previousId, pc)
+        );
+    }
+
+    return true;
+}
+
+
+
+void RS_DbsPropertyChangeCodec::writeValue(std::string& data, const RS_PropertyValue& value) {
+    switch (value.getDataType()) {
+    case RS_PropertyValue::Integer:
+        writeSigned(data, value.getInt());
+        break;
+    case RS_PropertyValue::Double:
+        writeDouble(data, value.getDouble());
+        break;
+    case RS_PropertyValue::String:
+        writeString(data, value.getString());
+        break;
+    default:
+        break;
+    }
+}
+
+
+
+bool RS_DbsPropertyChangeCodec::readValue(
+    const std::string& data, size_t& pos,
+    RS_PropertyValue::DataType dataType, RS_PropertyValue& value) {
+
+    switch (dataType) {
+    case RS_PropertyValue::Invalid:
+        value = RS_PropertyValue();
+        return true;
+    case RS_PropertyValue::Integer: {
+        long long v;
+        if (!readSigned(data, pos, v)) {
+            return false;
+        }
+        value = RS_PropertyValue((int)v);
+        return true;
+    }
+    case RS_PropertyValue::Double: {
+        double v;
+        if (!readDouble(data, pos, v)) {
+            return false;
+        }
+        value = RS_PropertyValue(v);
+        return true;
+    }
+    case RS_PropertyValue::String: {
+        std::string v;
+        if (!readString(data, pos, v)) {
+            return false;
+        }
+        value = RS_PropertyValue(v);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+
+
+void RS_DbsPropertyChangeCodec::writeVarint(std::string& data, unsigned long long value) {
+    while (value>=0x80) {
+        data += (char)((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    data += (char)value;
+}
+
+
+
+bool RS_DbsPropertyChangeCodec::readVarint(
+    const std::string& data, size_t& pos, unsigned long long& value) {
+
+    value = 0;
+    for (int shift=0; shift<64; shift+=7) {
+        if (pos>=data.size()) {
+            return false;
+        }
+        unsigned char c = (unsigned char)data[pos++];
+        value |= (unsigned long long)(c & 0x7f) << shift;
+        if ((c & 0x80)==0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+
+void RS_DbsPropertyChangeCodec::writeSigned(std::string& data, long long value) {
+    writeVarint(data, ((unsigned long long)value << 1) ^ (unsigned long long)(value >> 63));
+}
+
+
+
+bool RS_DbsPropertyChangeCodec::readSigned(
+    const std::string& data, size_t& pos, long long& value) {
+
+    unsigned long long v;
+    if (!readVarint(data, pos, v)) {
+        return false;
+    }
+    value = (long long)(v >> 1) ^ -(long long)(v & 1);
+    return true;
+}
+
+
+
+void RS_DbsPropertyChangeCodec::writeDouble(std::string& data, double value) {
+    unsigned long long bits;
+    memcpy(&bits, &value, sizeof(bits));
+    for (int i=0; i<8; ++i) {
+        data += (char)(bits & 0xff);
+        bits >>= 8;
+    }
+}
+
+
+
+bool RS_DbsPropertyChangeCodec::readDouble(
+    const std::string& data, size_t& pos, double& value) {
+
+    if (pos+8>data.size()) {
+        return false;
+    }
+    unsigned long long bits = 0;
+    for (int i=7; i>=0; --i) {
+        bits = (bits << 8) | (unsigned char)data[pos+i];
+    }
+    pos += 8;
+    memcpy(&value, &bits, sizeof(value));
+    return true;
+}
+
+
+
+void RS_DbsPropertyChangeCodec::writeString(std::string& data, const std::string& value) {
+    writeVarint(data, value.size());
+    data += value;
+}
+
+
+
+bool RS_DbsPropertyChangeCodec::readString(
+    const std::string& data, size_t& pos, std::string& value) {
+
+    unsigned long long size;
+    if (!readVarint(data, pos, size) || size>data.size()-pos) {
+        return false;
+    }
+    value.assign(data, pos, (size_t)size);
+    pos += (size_t)size;
+    return true;
+}
+
+
+
+/**
+ * Compresses the given data into an LZ4 block: every sequence consists
+ * of a token (literal length in the high, match length - 4 in the low
+ * nibble), the literals, a 2 byte little endian match offset and
+ * extended lengths as runs of 255. The last sequence only holds
+ * literals. As required by the LZ4 block format, the last match starts
+ * at least 12 bytes before the end of the data and the last 5 bytes
+ * are always literals, so the result can be decompressed by any LZ4
+ * implementation.
+ */
+std::string RS_DbsPropertyChangeCodec::compress(const std::string& data) {
+    const int hashBits = 12;
+    const size_t maxOffset = 65535;
+    // matches must not start in the last 12 bytes:
+    const size_t matchStartLimit = 12;
+    // and the last 5 bytes must be literals:
+    const size_t lastLiterals = 5;
+
+    std::string ret;
+    size_t size = data.size();
+    const unsigned char* src = (const unsigned char*)data.data();
+
+    int table[1 << hashBits];
+    for (int i=0; i<(1 << hashBits); ++i) {
+        table[i] = -1;
+    }
+
+    size_t anchor = 0;
+    size_t pos = 0;
+    while (pos+matchStartLimit<=size) {
+        unsigned int seq = src[pos] | (src[pos+1] << 8) | (src[pos+2] << 16) |
+            ((unsigned int)src[pos+3] << 24);
+        unsigned int hash = (seq * 2654435761U) >> (32 - hashBits);
+        int ref = table[hash];
+        table[hash] = (int)pos;
+
+        if (ref<0 || pos-ref>maxOffset || memcmp(src+ref, src+pos, 4)!=0) {
+            ++pos;
+            continue;
+        }
+
+        size_t matchLength = 4;
+        while (pos+matchLength<size-lastLiterals &&
+               src[ref+matchLength]==src[pos+matchLength]) {
+            ++matchLength;
+        }
+
+        // emit sequence:
+        size_t literalLength = pos - anchor;
+        size_t matchCode = matchLength - 4;
+        ret += (char)(((literalLength<15 ? literalLength : 15) << 4) |
+            (matchCode<15 ? matchCode : 15));
+        if (literalLength>=15) {
+            size_t l = literalLength - 15;
+            for (; l>=255; l-=255) {
+                ret += (char)255;
+            }
+            ret += (char)l;
+        }
+        ret.append(data, anchor, literalLength);
+        size_t offset = pos - ref;
+        ret += (char)(offset & 0xff);
+        ret += (char)(offset >> 8);
+        if (matchCode>=15) {
+            size_t l = matchCode - 15;
+            for (; l>=255; l-=255) {
+                ret += (char)255;
+            }
+            ret += (char)l;
+        }
+
+        pos += matchLength;
+        anchor = pos;
+    }
+
+    // last literals:
+    size_t literalLength = size - anchor;
+    ret += (char)((literalLength<15 ? literalLength : 15) << 4);
+    if (literalLength>=15) {
+        size_t l = literalLength - 15;
+        for (; l>=255; l-=255) {
+            ret += (char)255;
+        }
+        ret += (char)l;
+    }
+    ret.append(data, anchor, literalLength);
+
+    return ret;
+}
+
+
+
+/**
+ * Decompresses data created with \ref compress, starting at position
+ * \c pos of \c data.
+ *
+ * \return False if the data is corrupt or does not decompress to
+ *      exactly \c rawSize bytes.
+ */
+bool RS_DbsPropertyChangeCodec::decompress(
+    const std::string& data, size_t pos, size_t rawSize, std::string& result) {
+
+    result.clear();
+    result.reserve(rawSize);
+
+    size_t size = data.size();
+    while (pos<size) {
+        unsigned char token = (unsigned char)data[pos++];
+
+        size_t literalLength = token >> 4;
+        if (literalLength==15) {
+            unsigned char c;
+            do {
+                if (pos>=size) {
+                    return false;
+                }
+                c = (unsigned char)data[pos++];
+                literalLength += c;
+            } while (c==255);
+        }
+        if (literalLength>size-pos || result.size()+literalLength>rawSize) {
+            return false;
+        }
+        result.append(data, pos, literalLength);
+        pos += literalLength;
+
+        // last sequence:
+        if (pos==size) {
+            break;
+        }
+
+        if (pos+2>size) {
+            return false;
+        }
+        size_t offset = (unsigned char)data[pos] | ((unsigned char)data[pos+1] << 8);
+        pos += 2;
+
+        size_t matchLength = (token & 0x0f);
+        if (matchLength==15) {
+            unsigned char c;
+            do {
+                if (pos>=size) {
+                    return false;
+                }
+                c = (unsigned char)data[pos++];
+                matchLength += c;
+            } while (c==255);
+        }
+        matchLength += 4;
+
+        if (offset==0 || offset>result.size() || result.size()+matchLength>rawSize) {
+            return false;
+        }
+
+        // copy byte by byte, the match may overlap the output:
+        size_t from = result.size() - offset;
+        for (size_t i=0; i<matchLength; ++i) {
+            char c = result[from + i];
+            result += c;
+        }
+    }
+
+    return result.size()==rawSize;
+}
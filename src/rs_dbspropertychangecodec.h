@@ -0,0 +1,82 @@
+#ifndef RS_DBSPROPERTYCHANGECODEC_H
+#define RS_DBSPROPERTYCHANGECODEC_H
+
+#include <map>
+#include <string>
+
+#include "RS_Object"
+#include "RS_PropertyChange"
+
+
+
+/**
+ * Encodes the property changes of one transaction into a compact binary
+ * record and back. The undo log stores one such record per transaction
+ * instead of one table row per changed property.
+ *
+ * Record layout (all integers are unsigned LEB128 varints, signed
+ * integers are zigzag encoded first):
+ *
+ * \verbatim
+ * format       1 byte: Plain or Compressed
+ * [rawSize]    varint, only for Compressed: size of the plain payload
+ * payload      plain payload or plain payload compressed to an LZ4 block
+ *
+ * plain payload:
+ * count        varint
+ * count times:
+ *   oidDelta   varint, object ID minus the object ID of the previous
+ *              change (changes are ordered by object ID)
+ *   pid        zigzag varint
+ *   type       1 byte, data type in bits 0-3. For booleans bit 4 holds
+ *              the old and bit 5 the new value.
+ *   old, new   typed payload: zigzag varint (Integer), 8 bytes little
+ *              endian IEEE 754 (Double), varint length and bytes
+ *              (String), nothing (Boolean, Invalid)
+ * \endverbatim
+ *
+ * \author Andrew Mustun
+ * \ingroup qcaddbstorage
+ */
+class RS_DbsPropertyChangeCodec {
+public:
+    enum Format {
+        Plain = 1,
+        Compressed = 2
+    };
+
+    static std::string encode(
+        const std::multimap<RS_Object::Id, RS_PropertyChange>& propertyChanges,
+        bool compress = true
+    );
+    static bool decode(
+        const std::string& data,
+        std::multimap<RS_Object::Id, RS_PropertyChange>& propertyChanges
+    );
+
+    static std::string compress(const std::string& data);
+    static bool decompress(const std::string& data, size_t pos, size_t rawSize, std::string& result);
+
+private:
+    static void writeVarint(std::string& data, unsigned long long value);
+    static bool readVarint(const std::string& data, size_t& pos, unsigned long long& value);
+    static void writeSigned(std::string& data, long long value);
+    static bool readSigned(const std::string& data, size_t& pos, long long& value);
+    static void writeDouble(std::string& data, double value);
+    static bool readDouble(const std::string& data, size_t& pos, double& value);
+    static void writeString(std::string& data, const std::string& value);
+    static bool readString(const std::string& data, size_t& pos, std::string& value);
+
+    static void writeValue(std::string& data, const RS_PropertyValue& value);
+    static bool readValue(
+        const std::string& data, size_t& pos,
+        RS_PropertyValue::DataType dataType, RS_PropertyValue& value
+    );
+
+    /**
+     * Payloads smaller than this are never compressed.
+     */
+    static const size_t minCompressSize = 64;
+};
+
+#endif
@@ -0,0 +1,169 @@
+#include <sqlite3.h>
+
+#include "RS_DbsReaderPool"
+#include "RS_DbsHandle"
+#include "RS_DbsReadView"
+#include "RS_DbsStatementCache"
+#include "RS_DbsStatistics"
+#include "RS_Debug"
+
+
+
+/**
+ * Opens the reader connections.
+ *
+ * \param fileName File name of the document, which must be in WAL mode.
+ * \param options Settings of the document. Only the cache settings and
+ *      the statistics flag are applied to the reader connections.
+ */
+RS_DbsReaderPool::RS_DbsReaderPool(
+    const std::string& fileName,
+    const RS_DbStorageOptions& options) {
+
+    RS_DbStorageOptions readerOptions;
+    readerOptions.cacheSize = options.cacheSize;
+    readerOptions.mmapSize = options.mmapSize;
+    readerOptions.tempStore = options.tempStore;
+
+    // the destructor does not run if a connection cannot be opened, so
+    // the connections opened so far are closed here:
+    try {
+        for (int i=0; i<options.readerConnections; i++) {
+            RS_DbConnection* db = new RS_DbConnection();
+            sqlite3* handle;
+            try {
+                handle = RS_DbsHandle::open(*db, fileName);
+            }
+            catch (...) {
+                delete db;
+                throw;
+            }
+            connections.push_back(db);
+            db->executeNonQuery("PRAGMA query_only=1;");
+            readerOptions.apply(*db);
+
+            // created here, so reader threads only look up their caches:
+            statementCaches.push_back(new RS_DbsStatementCache(*db, handle));
+            statistics.push_back(new RS_DbsStatistics(handle));
+            statistics.back()->setEnabled(options.statistics);
+            busy.push_back(false);
+        }
+    }
+    catch (...) {
+        RS_Debug::error("RS_DbsReaderPool::RS_DbsReaderPool: "
+            "cannot open reader connection %d to %s", 
+            (int)connections.size(), fileName.c_str());
+        close();
+        throw;
+    }
+
+    RS_Debug::debug("RS_DbsReaderPool: %d reader connections to %s",
+        (int)connections.size(), fileName.c_str());
+}
+
+
+
+/**
+ * Closes all reader connections. All views must have been destroyed.
+ */
+RS_DbsReaderPool::~RS_DbsReaderPool() {
+    for (unsigned int i=0; i<busy.size(); i++) {
+        if (busy[i]) {
+            RS_Debug::error("RS_DbsReaderPool::~RS_DbsReaderPool: "
+                "connection %d still in use", i);
+        }
+    }
+    close();
+}
+
+
+
+/**
+ * Finalizes the statements of all reader connections and closes them.
+ * A connection may be open without a statement cache or statistics if
+ * the constructor failed.
+ */
+void RS_DbsReaderPool::close() {
+    for (unsigned int i=0; i<connections.size(); i++) {
+        if (i<statistics.size()) {
+            statistics[i]->setEnabled(false);
+            delete statistics[i];
+        }
+        if (i<statementCaches.size()) {
+            delete statementCaches[i];
+        }
+        connections[i]->close();
+        delete connections[i];
+    }
+    statistics.clear();
+    statementCaches.clear();
+    connections.clear();
+    busy.clear();
+}
+
+
+
+/**
+ * \return Statistics of the statements of the reader connection with 
+ *      the given index (see RS_DbStorageOptions::statistics). They must
+ *      only be read, reset or switched while no view uses the 
+ *      connection.
+ */
+RS_DbsStatistics& RS_DbsReaderPool::getStatistics(int index) {
+    return *statistics[index];
+}
+
+
+
+RS_Entity* RS_DbsReaderPool::queryEntity(RS_Entity::Id entityId) {
+    RS_DbsReadView view(*this);
+    return view.queryEntity(entityId);
+}
+
+
+
+void RS_DbsReaderPool::queryEntitiesInBox(
+    const RS_Box& box, std::set<RS_Entity::Id>& result, bool inside) {
+
+    RS_DbsReadView view(*this);
+    view.queryEntitiesInBox(box, result, inside);
+}
+
+
+
+RS_Box RS_DbsReaderPool::getBoundingBox() {
+    RS_DbsReadView view(*this);
+    return view.getBoundingBox();
+}
+
+
+
+/**
+ * Reserves a connection for a view. Blocks until a connection is free.
+ *
+ * \return Index of the connection.
+ */
+int RS_DbsReaderPool::acquire() {
+    available.lock();
+    while (true) {
+        for (unsigned int i=0; i<busy.size(); i++) {
+            if (!busy[i]) {
+                busy[i] = true;
+                available.unlock();
+                return i;
+            }
+        }
+
+        // all connections are in use by views, which are short lived:
+        available.wait();
+    }
+}
+
+
+
+void RS_DbsReaderPool::release(int index) {
+    available.lock();
+    busy[index] = false;
+    available.wakeOne();
+    available.unlock();
+}
@@ -0,0 +1,96 @@
+#ifndef RS_DBSREADERPOOL_H
+#define RS_DBSREADERPOOL_H
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "RS_Box"
+#include "RS_DbClient"
+#include "RS_DbStorageOptions"
+#include "RS_DbsWaitCondition"
+#include "RS_Entity"
+
+class RS_DbsStatementCache;
+class RS_DbsStatistics;
+
+
+
+/**
+ * Pool of read-only connections to the DB of a document. The pool
+ * allows other threads (renderer, exporters, property panels) to query
+ * a document while it is being edited through the connection of the
+ * RS_DbStorage which owns the pool. All writes stay on that connection.
+ *
+ * Only file-backed documents in WAL mode have a pool (RS_DbStorage 
+ * switches to WAL if reader connections are configured). Readers see
+ * consistent snapshots and never block the writer and vice versa. A 
+ * reader sees the document as it was at the last commit before it 
+ * started reading. In-memory documents have no pool: a shared cache
+ * would serialize all connections and would require readers to read
+ * uncommitted data.
+ *
+ * The pool keeps the edit latency of the owner independent of the 
+ * number of reader threads. It is not a way to speed up reads: each
+ * reader connection has its own page cache, which is invalidated by 
+ * every commit of the owner, so on a single core a pooled read costs
+ * about twice as much as a read through the owner's connection.
+ *
+ * The selection is read from the DB, so readers see the selection as
+ * of the last RS_DbStorage::saveSelection.
+ *
+ * Queries are done through an RS_DbsReadView. The query functions of
+ * the pool are shortcuts that use a temporary view for one query.
+ *
+ * \author Andrew Mustun
+ * \ingroup qcaddbstorage
+ */
+class RS_DbsReaderPool {
+    friend class RS_DbsReadView;
+
+public:
+    RS_DbsReaderPool(
+        const std::string& fileName,
+        const RS_DbStorageOptions& options
+    );
+    ~RS_DbsReaderPool();
+
+    RS_Entity* queryEntity(RS_Entity::Id entityId);
+    void queryEntitiesInBox(
+        const RS_Box& box,
+        std::set<RS_Entity::Id>& result,
+        bool inside=false
+    );
+    RS_Box getBoundingBox();
+
+    /**
+     * \return Number of reader connections.
+     */
+    int getSize() const {
+        return (int)connections.size();
+    }
+
+    RS_DbsStatistics& getStatistics(int index);
+
+private:
+    RS_DbsReaderPool(const RS_DbsReaderPool&);
+    RS_DbsReaderPool& operator=(const RS_DbsReaderPool&);
+
+    void close();
+    int acquire();
+    void release(int index);
+
+private:
+    //! reader connections, their statement caches and statistics:
+    std::vector<RS_DbConnection*> connections;
+    std::vector<RS_DbsStatementCache*> statementCaches;
+    std::vector<RS_DbsStatistics*> statistics;
+
+    //! protects the member below, signalled when a connection is 
+    //! released:
+    RS_DbsWaitCondition available;
+    //! true for connections that are in use by a view:
+    std::vector<bool> busy;
+};
+
+#endif
@@ -0,0 +1,127 @@
+#include "RS_DbsReadView"
+#include "RS_DbsReaderPool"
+#include "RS_DbsEntityType"
+#include "RS_DbsIdVisitor"
+#include "RS_DbsObjectTypeRegistry"
+#include "RS_DbsStatementCache"
+#include "RS_DbException"
+#include "RS_Debug"
+
+
+
+/**
+ * Reserves a connection of the given pool (see RS_DbsReaderPool::acquire)
+ * and starts a read transaction on it. The snapshot of the document is
+ * taken by the first query.
+ */
+RS_DbsReadView::RS_DbsReadView(RS_DbsReaderPool& pool)
+    : pool(pool),
+      index(pool.acquire()),
+      db(*pool.connections[index]) {
+
+    db.startTransaction();
+}
+
+
+
+/**
+ * Ends the read transaction and releases the connection.
+ */
+RS_DbsReadView::~RS_DbsReadView() {
+    pool.statementCaches[index]->resetCommands();
+    try {
+        db.endTransaction();
+    }
+    catch (RS_DbException e) {
+        RS_Debug::error("RS_DbsReadView::~RS_DbsReadView: "
+            "cannot end read transaction");
+    }
+    pool.release(index);
+}
+
+
+
+/**
+ * \return The object with the given ID or NULL if there is no such
+ *      object or the object is undone. The caller is responsible for
+ *      deleting the object.
+ */
+RS_Object* RS_DbsReadView::queryObject(RS_Object::Id objectId) {
+    RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
+        db,
+        "SELECT objectTypeId, undoStatus "
+        "FROM Object "
+        "WHERE id=?"
+    );
+    cmd.bind(1, objectId);
+    RS_DbsReader reader = cmd.executeReader();
+    if (!reader.read() || reader.getInt(1)==1) {
+        return NULL;
+    }
+    RS_Object::ObjectTypeId objectTypeId = reader.getInt(0);
+
+    RS_DbsObjectType* dbsObjectType = RS_DbsObjectTypeRegistry::getDbObject(objectTypeId);
+    if (dbsObjectType==NULL) {
+        RS_Debug::error("RS_DbsReadView::queryObject: "
+            "no DB object registered for object type %d", objectTypeId);
+        return NULL;
+    }
+
+    return dbsObjectType->loadObject(db, objectId);
+}
+
+
+
+/**
+ * \return The entity with the given ID or NULL. The caller is
+ *      responsible for deleting the entity.
+ */
+RS_Entity* RS_DbsReadView::queryEntity(RS_Entity::Id entityId) {
+    RS_Object* object = queryObject(entityId);
+    if (object==NULL) {
+        return NULL;
+    }
+
+    RS_Entity* entity = dynamic_cast<RS_Entity*>(object);
+    if (entity==NULL) {
+        delete object;
+        return NULL;
+    }
+
+    return entity;
+}
+
+
+
+/**
+ * Reports the IDs of all entities that are not undone to the given 
+ * visitor (see RS_DbStorage::queryAllEntities(RS_DbsIdVisitor&)).
+ */
+void RS_DbsReadView::queryAllEntities(RS_DbsIdVisitor& visitor) {
+    RS_DbsEntityType::queryAllEntities(db, visitor);
+}
+
+
+
+/**
+ * Queries all entities that are not undone and whose bounding box
+ * intersects the given box (see RS_DbStorage::queryEntitiesInBox).
+ */
+void RS_DbsReadView::queryEntitiesInBox(
+    const RS_Box& box, std::set<RS_Entity::Id>& result, bool inside) {
+
+    RS_DbsEntityType::queryEntitiesInBox(db, box, result, inside);
+}
+
+
+
+/**
+ * \return Bounding box of all entities that are not undone.
+ */
+RS_Box RS_DbsReadView::getBoundingBox() {
+    RS_Vector minV, maxV;
+    if (!RS_DbsEntityType::getBoundingBox(db, minV, maxV)) {
+        return RS_Box(RS_Vector(), RS_Vector());
+    }
+    return RS_Box(minV, maxV);
+}
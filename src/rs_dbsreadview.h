@@ -0,0 +1,67 @@
+#ifndef RS_DBSREADVIEW_H
+#define RS_DBSREADVIEW_H
+
+#include <set>
+
+#include "RS_Box"
+#include "RS_DbClient"
+#include "RS_Entity"
+
+class RS_DbsIdVisitor;
+class RS_DbsReaderPool;
+
+
+
+/**
+ * Consistent read-only view of a document. A view holds one connection
+ * of an RS_DbsReaderPool and a read transaction on it for its lifetime,
+ * so all queries through the same view see the same state of the
+ * document (for file-backed documents, see RS_DbsReaderPool).
+ *
+ * A view must only be used by the thread that created it. Views should
+ * be short lived (e.g. one repaint or one export): if all connections
+ * of the pool are in use, new views wait until one is released. For
+ * file-backed documents, a view that is kept open also prevents WAL
+ * checkpoints from completing.
+ *
+ * Example:
+ * \code
+ * RS_DbsReadView view(*storage.getReaderPool());
+ * std::set<RS_Entity::Id> ids;
+ * view.queryEntitiesInBox(box, ids);
+ * for (it=ids.begin(); it!=ids.end(); ++it) {
+ *     RS_Entity* e = view.queryEntity(*it);
+ *     ...
+ * }
+ * \endcode
+ *
+ * \author Andrew Mustun
+ * \ingroup qcaddbstorage
+ */
+class RS_DbsReadView {
+public:
+    RS_DbsReadView(RS_DbsReaderPool& pool);
+    ~RS_DbsReadView();
+
+    RS_Object* queryObject(RS_Object::Id objectId);
+    RS_Entity* queryEntity(RS_Entity::Id entityId);
+    void queryAllEntities(RS_DbsIdVisitor& visitor);
+    void queryEntitiesInBox(
+        const RS_Box& box,
+        std::set<RS_Entity::Id>& result,
+        bool inside=false
+    );
+    RS_Box getBoundingBox();
+
+private:
+    RS_DbsReadView(const RS_DbsReadView&);
+    RS_DbsReadView& operator=(const RS_DbsReadView&);
+
+private:
+    RS_DbsReaderPool& pool;
+    //! index of the connection in the pool:
+    int index;
+    RS_DbConnection& db;
+};
+
+#endif
@@ -0,0 +1,451 @@
+#include <cstdio>
+#include <map>
+#include <vector>
+
+#include "RS_DbsSchema"
+#include "RS_Debug"
+#include "RS_DbsEntityType"
+#include "RS_DbsLineType"
+#include "RS_DbsObjectType"
+#include "RS_DbsObjectTypeRegistry"
+#include "RS_DbsPropertyChangeCodec"
+#include "RS_DbsStatementCache"
+#include "RS_DbStorage"
+
+
+
+/**
+ * Prepares the given, freshly opened DB for use by RS_DbStorage. New
+ * DBs are initialized, DBs with an older schema are migrated.
+ *
+ * \return True if the DB was newly created.
+ *
+ * \throws RS_DbException if the DB was written by a newer version of
+ *      the library (see \ref checkVersion) or the migration failed.
+ */
+bool RS_DbsSchema::open(RS_DbConnection& db) {
+    checkVersion(db);
+
+    int version = getVersion(db);
+
+    if (version==0) {
+        create(db);
+        return true;
+    }
+
+    if (version<currentVersion) {
+        migrate(db, version);
+    }
+    else {
+        ensureIndices(db);
+    }
+
+    return false;
+}
+
+
+
+/**
+ * Checks that the given DB can be used by this version of the library.
+ * This only reads the schema metadata and the stored version, so it
+ * can be called before anything is written to the DB.
+ *
+ * \throws RS_DbException if the DB has a newer schema version than
+ *      \ref currentVersion.
+ */
+void RS_DbsSchema::checkVersion(RS_DbConnection& db) {
+    int version = getVersion(db);
+    if (version<=currentVersion) {
+        return;
+    }
+
+    RS_Debug::error("RS_DbsSchema::checkVersion: "
+        "DB has schema version %d, supported version is %d",
+        version, currentVersion);
+
+    char buf[128];
+    sprintf(buf, "document has schema version %d, supported version is %d",
+        version, currentVersion);
+    throw RS_DbException(buf);
+}
+
+
+
+/**
+ * \return Schema version of the given DB or 0 for a new DB.
+ */
+int RS_DbsSchema::getVersion(RS_DbConnection& db) {
+    std::set<std::string> tables;
+    queryTables(db, "table", tables);
+
+    if (tables.count("Variables")==0) {
+        return 0;
+    }
+
+    RS_DbCommand cmd(
+        db,
+        "SELECT value "
+        "FROM Variables "
+        "WHERE key='SchemaVersion'"
+    );
+    RS_DbReader reader = cmd.executeReader();
+    if (reader.read()) {
+        return reader.getInt(0);
+    }
+
+    // written before schema versioning was introduced:
+    if (tables.count("Transaction2")==1) {
+        return 1;
+    }
+
+    return 0;
+}
+
+
+
+/**
+ * Creates all tables, indices and variables of the current schema.
+ */
+void RS_DbsSchema::create(RS_DbConnection& db) {
+    // 'Transaction' is a reserved keyword, so we use 'Transaction2':
+    db.executeNonQuery(
+        "CREATE TABLE Transaction2("
+            "id INTEGER PRIMARY KEY, "
+            "parentId INTEGER, "
+            "text VARCHAR, "
+            "size INTEGER"
+        ");"
+    );
+
+    db.executeNonQuery(
+        "CREATE TABLE AffectedObjects("
+            "tid INTEGER, "
+            "oid INTEGER, "
+            "PRIMARY KEY(tid, oid)"
+        ");"
+    );
+
+    // property changes of a transaction as one binary record
+    // (see RS_DbsPropertyChangeCodec):
+    db.executeNonQuery(
+        "CREATE TABLE PropertyChangeLog("
+            "tid INTEGER PRIMARY KEY, "
+            "data BLOB"
+        ");"
+    );
+
+    db.executeNonQuery(
+        "CREATE TABLE Variables("
+            "key STRING PRIMARY KEY, "
+            "value BLOB"
+        ");"
+    );
+
+    RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
+        db,
+        "INSERT INTO Variables VALUES(?,?);"
+    );
+    cmd.bind(1, "LastTransaction");
+    cmd.bind(2, -1);
+    cmd.executeNonQuery();
+
+    // initialize the DB for all registered object types:
+    RS_DbsObjectTypeRegistry::initDb(db);
+
+    ensureIndices(db);
+    setVersion(db, currentVersion);
+}
+
+
+
+/**
+ * Migrates the given DB from \c version to the current version. All
+ * steps run inside one savepoint, so a failed migration leaves the DB
+ * untouched.
+ */
+void RS_DbsSchema::migrate(RS_DbConnection& db, int version) {
+    RS_Debug::debug("RS_DbsSchema::migrate: from version %d to %d",
+        version, currentVersion);
+
+    db.executeNonQuery("SAVEPOINT migrate;");
+    try {
+        if (version<2) {
+            migrateTo2(db);
+        }
+        if (version<3) {
+            migrateTo3(db);
+        }
+
+        ensureIndices(db);
+        setVersion(db, currentVersion);
+        db.executeNonQuery("RELEASE migrate;");
+    }
+    catch (...) {
+        RS_Debug::error("RS_DbsSchema::migrate: migration failed");
+        db.executeNonQuery("ROLLBACK TO migrate;");
+        db.executeNonQuery("RELEASE migrate;");
+        throw;
+    }
+}
+
+
+
+/**
+ * Migration from the unversioned schema:
+ * - Transaction2 gets a size column for the undo budget, which is
+ *   filled for the existing transactions.
+ * - Rows of table PropertyChanges are converted to one binary record
+ *   per transaction in table PropertyChangeLog.
+ * - Bounding boxes in table Entity are normalized to min<=max.
+ * - The spatial index EntityIndex is created and filled.
+ */
+void RS_DbsSchema::migrateTo2(RS_DbConnection& db) {
+    db.executeNonQuery("ALTER TABLE Transaction2 ADD COLUMN size INTEGER;");
+
+    db.executeNonQuery(
+        "CREATE TABLE PropertyChangeLog("
+            "tid INTEGER PRIMARY KEY, "
+            "data BLOB"
+        ");"
+    );
+
+    std::map<int, std::multimap<RS_Object::Id, RS_PropertyChange> > log;
+    {
+        RS_DbCommand cmd(
+            db,
+            "SELECT tid, oid, pid, dataType, oldValue, newValue "
+            "FROM PropertyChanges"
+        );
+        RS_DbReader reader = cmd.executeReader();
+        while (reader.read()) {
+            RS_PropertyChange pc;
+            pc.propertyTypeId = reader.getInt64(2);
+            switch((RS_PropertyValue::DataType)reader.getInt64(3)) {
+            case RS_PropertyValue::Boolean:
+                pc.oldValue = RS_PropertyValue((bool)reader.getInt(4));
+                pc.newValue = RS_PropertyValue((bool)reader.getInt(5));
+                break;
+            case RS_PropertyValue::Integer:
+                pc.oldValue = RS_PropertyValue(reader.getInt(4));
+                pc.newValue = RS_PropertyValue(reader.getInt(5));
+                break;
+            case RS_PropertyValue::Double:
+                pc.oldValue = RS_PropertyValue(reader.getDouble(4));
+                pc.newValue = RS_PropertyValue(reader.getDouble(5));
+                break;
+            case RS_PropertyValue::String:
+                pc.oldValue = RS_PropertyValue(reader.getString(4));
+                pc.newValue = RS_PropertyValue(reader.getString(5));
+                break;
+            default:
+                break;
+            }
+            log[reader.getInt(0)].insert(
+                std::pair<RS_Object::Id, RS_PropertyChange>(reader.getInt64(1), pc)
+            );
+        }
+    }
+
+    std::map<int, std::multimap<RS_Object::Id, RS_PropertyChange> >::iterator it;
+    for (it=log.begin(); it!=log.end(); ++it) {
+        std::string data = RS_DbsPropertyChangeCodec::encode(it->second);
+        RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
+            db,
+            "INSERT INTO PropertyChangeLog VALUES(?,?)"
+        );
+        cmd.bind(1, it->first);
+        cmd.bindBlob(2, data.data(), (int)data.size());
+        cmd.executeNonQuery();
+    }
+
+    db.executeNonQuery("DROP TABLE PropertyChanges;");
+
+    // size of the existing transactions, computed like in 
+    // RS_DbStorage::saveTransaction, so they count against the undo 
+    // budget:
+    {
+        RS_DbCommand cmd(
+            db,
+            "UPDATE Transaction2 "
+            "SET size="
+                "LENGTH(CAST(IFNULL(text, '') AS BLOB)) + "
+                "IFNULL((SELECT LENGTH(data) "
+                    "FROM PropertyChangeLog "
+                    "WHERE tid=Transaction2.id), 0) + "
+                "? * (SELECT COUNT(*) "
+                    "FROM AffectedObjects "
+                    "WHERE tid=Transaction2.id)"
+        );
+        cmd.bind(1, RS_DbStorage::bytesPerAffectedObject);
+        cmd.executeNonQuery();
+    }
+
+    // bounding boxes were stored with the defining corners of the box
+    // in any order:
+    db.executeNonQuery(
+        "UPDATE Entity "
+        "SET minX=MIN(minX, maxX), maxX=MAX(minX, maxX), "
+            "minY=MIN(minY, maxY), maxY=MAX(minY, maxY), "
+            "minZ=MIN(minZ, maxZ), maxZ=MAX(minZ, maxZ) "
+        "WHERE minX>maxX OR minY>maxY OR minZ>maxZ;"
+    );
+
+    // creates EntityIndex and tables of object types added since:
+    RS_DbsObjectTypeRegistry::initDb(db);
+    RS_DbsEntityType::indexEntities(db, 0, RS_DbsObjectType::getMaxObjectId(db));
+}
+
+
+
+/**
+ * Migration from version 2:
+ * - Table Line is keyed on the rowid and stores the start and end 
+ *   point in one packed BLOB (see RS_DbsLineType) instead of six REAL
+ *   columns under a separate primary key index.
+ */
+void RS_DbsSchema::migrateTo3(RS_DbConnection& db) {
+    // Line tables created by earlier migration steps are up to date:
+    RS_DbCommand cmd(
+        db,
+        "SELECT COUNT(*) "
+        "FROM pragma_table_info('Line') "
+        "WHERE name='x1'"
+    );
+    if (cmd.executeInt()==0) {
+        return;
+    }
+
+    db.executeNonQuery("ALTER TABLE Line RENAME TO Line2;");
+    RS_DbsObjectTypeRegistry::initDb(db);
+
+    // lines are copied in chunks, so no reader of Line2 is open while 
+    // rows are inserted into Line and the memory use is bounded:
+    const int chunkSize = 4096;
+    std::vector<RS_Object::Id> ids;
+    std::vector<char> geometry;
+    RS_Object::Id lastId = -1;
+    do {
+        ids.clear();
+        geometry.clear();
+        {
+            RS_DbsStatement& cmd2 = RS_DbsStatementCache::prepare(
+                db,
+                "SELECT id, x1, y1, z1, x2, y2, z2 "
+                "FROM Line2 "
+                "WHERE id>? "
+                "ORDER BY id "
+                "LIMIT ?"
+            );
+            cmd2.bind(1, lastId);
+            cmd2.bind(2, chunkSize);
+            RS_DbsReader reader = cmd2.executeReader();
+            while (reader.read()) {
+                RS_LineData data;
+                data.startPoint.x = reader.getDouble(1);
+                data.startPoint.y = reader.getDouble(2);
+                data.startPoint.z = reader.getDouble(3);
+                data.endPoint.x = reader.getDouble(4);
+                data.endPoint.y = reader.getDouble(5);
+                data.endPoint.z = reader.getDouble(6);
+
+                ids.push_back(reader.getInt64(0));
+                geometry.resize(ids.size() * RS_DbsLineType::geometrySize);
+                RS_DbsLineType::packGeometry(
+                    data, 
+                    &geometry[(ids.size()-1) * RS_DbsLineType::geometrySize]
+                );
+            }
+        }
+
+        size_t i = 0;
+        while (i<ids.size()) {
+            int rows = RS_DbsStatementCache::rowsPerInsert;
+            if (ids.size()-i<(size_t)rows) {
+                rows = 1;
+            }
+            RS_DbsStatement& cmd3 = RS_DbsStatementCache::prepare(
+                db,
+                RS_DbsStatementCache::getInsertSql("Line", 2, rows)
+            );
+            for (int r=0; r<rows; ++r, ++i) {
+                cmd3.bind(r*2 + 1, ids[i]);
+                cmd3.bindBlob(
+                    r*2 + 2, 
+                    &geometry[i * RS_DbsLineType::geometrySize], 
+                    RS_DbsLineType::geometrySize
+                );
+            }
+            cmd3.executeNonQuery();
+        }
+
+        if (!ids.empty()) {
+            lastId = ids.back();
+        }
+    } while (ids.size()==(size_t)chunkSize);
+
+    db.executeNonQuery("DROP TABLE Line2;");
+}
+
+
+
+/**
+ * Creates all managed indices that do not exist yet. Only the schema
+ * metadata is read if all indices exist.
+ */
+void RS_DbsSchema::ensureIndices(RS_DbConnection& db) {
+    std::set<std::string> tables;
+    queryTables(db, "table", tables);
+    std::set<std::string> indices;
+    queryTables(db, "index", indices);
+
+    // lookup of the transactions that affect a given object:
+    if (indices.count("AffectedObjectsOid")==0) {
+        db.executeNonQuery(
+            "CREATE INDEX AffectedObjectsOid "
+            "ON AffectedObjects(oid, tid);"
+        );
+    }
+
+    // loading the selection only touches selected entities:
+    if (indices.count("EntitySelected")==0 && tables.count("Entity")==1) {
+        db.executeNonQuery(
+            "CREATE INDEX EntitySelected "
+            "ON Entity(id) "
+            "WHERE selectionStatus=1;"
+        );
+    }
+}
+
+
+
+void RS_DbsSchema::setVersion(RS_DbConnection& db, int version) {
+    RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
+        db,
+        "INSERT OR REPLACE INTO Variables VALUES(?,?);"
+    );
+    cmd.bind(1, "SchemaVersion");
+    cmd.bind(2, version);
+    cmd.executeNonQuery();
+}
+
+
+
+/**
+ * Adds the names of all schema objects of the given type ("table",
+ * "index", ...) to \c result.
+ */
+void RS_DbsSchema::queryTables(
+    RS_DbConnection& db, const std::string& type, std::set<std::string>& result) {
+
+    RS_DbCommand cmd(
+        db,
+        "SELECT name "
+        "FROM sqlite_master "
+        "WHERE type=?"
+    );
+    cmd.bind(1, type);
+    RS_DbReader reader = cmd.executeReader();
+    while (reader.read()) {
+        result.insert(reader.getString(0));
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef RS_DBSSCHEMA_H
+#define RS_DBSSCHEMA_H
+
+#include <set>
+#include <string>
+
+#include "RS_DbClient"
+
+
+
+/**
+ * Creates, versions and migrates the DB schema of a document.
+ *
+ * The schema version is stored in table \b Variables under the key
+ * \b SchemaVersion. When a document is opened, \ref open looks at the
+ * stored version and:
+ *
+ * - creates all tables, indices and variables for a new (empty) DB,
+ * - migrates DBs with an older version step by step to the current
+ *   version inside a savepoint,
+ * - only checks that all managed indices exist for DBs that are up to
+ *   date. This reads nothing but the schema metadata, so opening an
+ *   existing document does not depend on its size.
+ *
+ * DBs with a newer version than \ref currentVersion were written by a
+ * newer version of the library and are refused with an RS_DbException.
+ *
+ * DBs without a stored version that contain a \b Transaction2 table
+ * were written before versioning was introduced and are treated as
+ * version 1.
+ *
+ * To change the schema, increment \ref currentVersion and add a
+ * migration step to \ref migrate. Indices that can be created at any
+ * time should be added to \ref ensureIndices instead.
+ *
+ * \author Andrew Mustun
+ * \ingroup qcaddbstorage
+ */
+class RS_DbsSchema {
+public:
+    static bool open(RS_DbConnection& db);
+    static void checkVersion(RS_DbConnection& db);
+    static int getVersion(RS_DbConnection& db);
+
+    /**
+     * Schema version written by this version of the library.
+     */
+    static const int currentVersion = 3;
+
+private:
+    static void create(RS_DbConnection& db);
+    static void migrate(RS_DbConnection& db, int version);
+    static void migrateTo2(RS_DbConnection& db);
+    static void migrateTo3(RS_DbConnection& db);
+    static void ensureIndices(RS_DbConnection& db);
+    static void setVersion(RS_DbConnection& db, int version);
+    static void queryTables(RS_DbConnection& db, const std::string& type, std::set<std::string>& result);
+};
+
+#endif
@@ -0,0 +1,198 @@
+#include "RS_DbsSelection"
+#include "RS_DbsEntityType"
+#include "RS_DbClient"
+
+
+
+/**
+ * Loads the selection from the DB. Used when an existing document is
+ * opened.
+ */
+void RS_DbsSelection::load(RS_DbConnection& db) {
+    selected.clear();
+    RS_DbsEntityType::querySelectedEntities(db, selected);
+    persisted = selected;
+}
+
+
+
+/**
+ * Writes the selection status of all entities whose selection has 
+ * changed since the last call to the DB.
+ */
+void RS_DbsSelection::save(RS_DbConnection& db) {
+    RS_DbsIdSet ids;
+
+    // entities that were selected:
+    RS_DbsIdSet::subtract(selected, persisted, ids);
+    RS_DbsEntityType::saveSelectionStatus(db, ids.getIds(), true);
+
+    // entities that were deselected:
+    RS_DbsIdSet::subtract(persisted, selected, ids);
+    RS_DbsEntityType::saveSelectionStatus(db, ids.getIds(), false);
+
+    persisted = selected;
+}
+
+
+
+/**
+ * \return true if the given entity is selected.
+ */
+bool RS_DbsSelection::isSelected(RS_Entity::Id entityId) const {
+    return selected.contains(entityId);
+}
+
+
+
+/**
+ * Adds the IDs of all selected entities to \c result.
+ */
+void RS_DbsSelection::getSelected(std::set<RS_Entity::Id>& result) const {
+    selected.toSet(result);
+}
+
+
+
+/**
+ * Deselects all entities.
+ *
+ * \param affectedEntities Set that receives the IDs of all entities that 
+ *      were deselected or NULL.
+ */
+void RS_DbsSelection::clear(std::set<RS_Entity::Id>* affectedEntities) {
+    RS_DbsIdSet newSelection;
+    setSelection(newSelection, affectedEntities);
+}
+
+
+
+/**
+ * Selects the given entity.
+ *
+ * \param add True to add the entity to the current selection, false to 
+ *      replace the current selection.
+ * \param affectedEntities Set that receives the IDs of all entities whose
+ *      selection status has changed or NULL.
+ */
+void RS_DbsSelection::select(
+    RS_Entity::Id entityId, bool add, 
+    std::set<RS_Entity::Id>* affectedEntities) {
+
+    if (add) {
+        if (!isSelected(entityId)) {
+            selected.insert(entityId);
+            if (affectedEntities!=NULL) {
+                affectedEntities->insert(entityId);
+            }
+        }
+        return;
+    }
+
+    RS_DbsIdSet newSelection;
+    newSelection.insert(entityId);
+    setSelection(newSelection, affectedEntities);
+}
+
+
+
+/**
+ * Selects the given entities.
+ *
+ * \see select
+ */
+void RS_DbsSelection::select(
+    std::set<RS_Entity::Id>& entityIds, bool add, 
+    std::set<RS_Entity::Id>* affectedEntities) {
+
+    RS_DbsIdSet newSelection(entityIds);
+    if (add) {
+        newSelection.unite(selected);
+    }
+
+    setSelection(newSelection, affectedEntities);
+}
+
+
+
+/**
+ * \overload
+ */
+void RS_DbsSelection::select(
+    const RS_DbsIdSet& entityIds, bool add, 
+    RS_DbsIdSet* affectedEntities) {
+
+    RS_DbsIdSet newSelection;
+    if (add) {
+        RS_DbsIdSet::unite(selected, entityIds, newSelection);
+    }
+    else {
+        newSelection = entityIds;
+    }
+
+    setSelection(newSelection, affectedEntities);
+}
+
+
+
+/**
+ * Updates the selection status of the given entity after it was 
+ * written to the DB (e.g. when the entity is saved).
+ */
+void RS_DbsSelection::update(RS_Entity::Id entityId, bool isSelected) {
+    if (isSelected) {
+        selected.insert(entityId);
+        persisted.insert(entityId);
+    }
+    else {
+        selected.erase(entityId);
+        persisted.erase(entityId);
+    }
+}
+
+
+
+/**
+ * Removes the given entity from the selection after it was deleted
+ * from the DB.
+ */
+void RS_DbsSelection::remove(RS_Entity::Id entityId) {
+    update(entityId, false);
+}
+
+
+
+/**
+ * Replaces the selection with the given IDs and reports all entities 
+ * whose selection status changes.
+ */
+void RS_DbsSelection::setSelection(
+    RS_DbsIdSet& newSelection, 
+    std::set<RS_Entity::Id>* affectedEntities) {
+
+    if (affectedEntities!=NULL) {
+        RS_DbsIdSet changed;
+        RS_DbsIdSet::symmetricDifference(selected, newSelection, changed);
+        changed.toSet(*affectedEntities);
+    }
+
+    selected.swap(newSelection);
+}
+
+
+
+/**
+ * \overload
+ */
+void RS_DbsSelection::setSelection(
+    RS_DbsIdSet& newSelection, 
+    RS_DbsIdSet* affectedEntities) {
+
+    if (affectedEntities!=NULL) {
+        RS_DbsIdSet changed;
+        RS_DbsIdSet::symmetricDifference(selected, newSelection, changed);
+        affectedEntities->unite(changed);
+    }
+
+    selected.swap(newSelection);
+}
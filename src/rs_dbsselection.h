@@ -0,0 +1,89 @@
+#ifndef RS_DBSSELECTION_H
+#define RS_DBSSELECTION_H
+
+#include <set>
+#include <vector>
+
+#include "RS_DbsIdSet"
+#include "RS_Entity"
+
+class RS_DbConnection;
+
+
+
+/**
+ * In-memory selection state of all entities of a document. The IDs of
+ * all selected entities are kept in an RS_DbsIdSet, so changing the 
+ * selection does not require any DB access. The set of entities 
+ * affected by a selection change is computed as the symmetric 
+ * difference between the old and the new selection.
+ *
+ * The selection is written to column \b selectionStatus of table 
+ * \b Entity only when \ref save is called. Only entities whose
+ * selection status differs from the one stored in the DB are updated.
+ *
+ * \author Andrew Mustun
+ * \ingroup qcaddbstorage
+ */
+class RS_DbsSelection {
+public:
+    RS_DbsSelection() {}
+
+    void load(RS_DbConnection& db);
+    void save(RS_DbConnection& db);
+
+    bool isSelected(RS_Entity::Id entityId) const;
+    void getSelected(std::set<RS_Entity::Id>& result) const;
+
+    /**
+     * \return IDs of all selected entities.
+     */
+    const RS_DbsIdSet& getSelectedIds() const {
+        return selected;
+    }
+
+    /**
+     * \return Number of selected entities.
+     */
+    int getSize() const {
+        return (int)selected.size();
+    }
+
+    void clear(std::set<RS_Entity::Id>* affectedEntities);
+    void select(
+        RS_Entity::Id entityId, 
+        bool add, 
+        std::set<RS_Entity::Id>* affectedEntities
+    );
+    void select(
+        std::set<RS_Entity::Id>& entityIds, 
+        bool add, 
+        std::set<RS_Entity::Id>* affectedEntities
+    );
+    void select(
+        const RS_DbsIdSet& entityIds, 
+        bool add, 
+        RS_DbsIdSet* affectedEntities
+    );
+
+    void update(RS_Entity::Id entityId, bool isSelected);
+    void remove(RS_Entity::Id entityId);
+
+private:
+    void setSelection(
+        RS_DbsIdSet& newSelection, 
+        std::set<RS_Entity::Id>* affectedEntities
+    );
+    void setSelection(
+        RS_DbsIdSet& newSelection, 
+        RS_DbsIdSet* affectedEntities
+    );
+
+private:
+    //! IDs of selected entities:
+    RS_DbsIdSet selected;
+    //! IDs of entities that are selected in the DB:
+    RS_DbsIdSet persisted;
+};
+
+#endif
@@ -0,0 +1,285 @@
+#include <algorithm>
+#include <sqlite3.h>
+
+#include "RS_DbsSnapshot"
+#include "RS_Debug"
+
+
+
+/**
+ * \param source SQLite handle of the connection of the document to 
+ *      copy (see RS_DbsHandle).
+ * \param fileName Name of the target file. An existing file is
+ *      overwritten once the snapshot completes.
+ * \param listener Optional listener for progress reports.
+ */
+RS_DbsSnapshot::RS_DbsSnapshot(
+    sqlite3* source,
+    const std::string& fileName,
+    RS_DbsSnapshotListener* listener)
+    : source(source),
+      fileName(fileName),
+      listener(listener),
+      pagesPerStep(64),
+      maxPagesPerStep(4096),
+      status(Pending),
+      cancelRequested(false),
+      pagesDone(0),
+      pageCount(0) {
+
+    mutex = sqlite3_mutex_alloc(SQLITE_MUTEX_FAST);
+}
+
+
+
+/**
+ * Cancels the snapshot if it is still running and waits for the worker
+ * thread to finish.
+ */
+RS_DbsSnapshot::~RS_DbsSnapshot() {
+    cancel();
+    wait();
+    sqlite3_mutex_free(mutex);
+}
+
+
+
+/**
+ * Starts the snapshot on a worker thread.
+ *
+ * \return False if the snapshot could not be started.
+ */
+bool RS_DbsSnapshot::start() {
+    sqlite3_mutex_enter(mutex);
+    if (status!=Pending) {
+        sqlite3_mutex_leave(mutex);
+        return false;
+    }
+    status = Running;
+    sqlite3_mutex_leave(mutex);
+
+    if (sqlite3_threadsafe()!=1) {
+        RS_Debug::debug("RS_DbsSnapshot::start: "
+            "SQLite is not in serialized mode, running snapshot in foreground");
+        run();
+        return true;
+    }
+
+    if (!RS_DbsThread::start()) {
+        sqlite3_mutex_enter(mutex);
+        status = Failed;
+        sqlite3_mutex_leave(mutex);
+        return false;
+    }
+    return true;
+}
+
+
+
+/**
+ * Requests cancellation of the snapshot. The worker thread stops after
+ * the current step. The target file is left untouched.
+ */
+void RS_DbsSnapshot::cancel() {
+    sqlite3_mutex_enter(mutex);
+    cancelRequested = true;
+    if (status==Pending) {
+        status = Cancelled;
+    }
+    sqlite3_mutex_leave(mutex);
+}
+
+
+
+/**
+ * Blocks until the snapshot has finished.
+ *
+ * \return Final status of the snapshot.
+ */
+RS_DbsSnapshot::Status RS_DbsSnapshot::waitForFinished() {
+    wait();
+    return getStatus();
+}
+
+
+
+RS_DbsSnapshot::Status RS_DbsSnapshot::getStatus() const {
+    sqlite3_mutex_enter(mutex);
+    Status ret = status;
+    sqlite3_mutex_leave(mutex);
+    return ret;
+}
+
+
+
+/**
+ * \return True if the snapshot is done, cancelled or failed.
+ */
+bool RS_DbsSnapshot::isFinished() const {
+    Status s = getStatus();
+    return s==Done || s==Cancelled || s==Failed;
+}
+
+
+
+/**
+ * \return Progress of the snapshot between 0.0 and 1.0.
+ */
+double RS_DbsSnapshot::getProgress() const {
+    sqlite3_mutex_enter(mutex);
+    double ret;
+    if (status==Done) {
+        ret = 1.0;
+    }
+    else if (pageCount==0) {
+        ret = 0.0;
+    }
+    else {
+        ret = (double)pagesDone / pageCount;
+    }
+    sqlite3_mutex_leave(mutex);
+    return ret;
+}
+
+
+
+/**
+ * Copies the DB in steps of \ref setPagesPerStep pages. Runs on the
+ * worker thread.
+ *
+ * SQLite restarts the backup of an in-memory DB whenever the source is
+ * committed to, so a large in-memory document that is being edited 
+ * would never finish. In-memory documents are therefore first copied 
+ * into a private in-memory DB in large steps (at memory speed, 
+ * restarts are cheap) and that private copy is then written to the 
+ * file in small steps without any interference. For in-memory 
+ * documents, every page is counted twice in the progress report.
+ */
+void RS_DbsSnapshot::run() {
+    sqlite3* source = this->source;
+    const char* sourceFileName = sqlite3_db_filename(source, "main");
+    bool inMemory = (sourceFileName==NULL || sourceFileName[0]=='\0');
+
+    Status result = Running;
+    sqlite3* copy = NULL;
+    if (inMemory) {
+        if (sqlite3_open(":memory:", &copy)!=SQLITE_OK) {
+            result = Failed;
+        }
+        else {
+            result = backup(source, copy, pagesPerStep*memoryStepFactor, maxRestarts, 0, 2);
+            source = copy;
+        }
+    }
+
+    if (result==Running) {
+        sqlite3* target = NULL;
+        if (sqlite3_open(fileName.c_str(), &target)!=SQLITE_OK) {
+            RS_Debug::error("RS_DbsSnapshot::run: cannot open file: %s", fileName.c_str());
+            result = Failed;
+        }
+        else {
+            result = backup(source, target, pagesPerStep, -1, inMemory ? 1 : 0, inMemory ? 2 : 1);
+        }
+        sqlite3_close(target);
+    }
+
+    sqlite3_close(copy);
+
+    if (result==Running) {
+        result = Done;
+    }
+
+    RS_Debug::debug("RS_DbsSnapshot::run: snapshot to %s finished with status %d",
+        fileName.c_str(), (int)result);
+
+    sqlite3_mutex_enter(mutex);
+    status = result;
+    sqlite3_mutex_leave(mutex);
+}
+
+
+
+/**
+ * Copies DB \c from to DB \c to in steps of \c pages pages.
+ *
+ * \param maxRestarts Number of times the backup may be restarted by
+ *      changes to the source before the steps grow up to 
+ *      \ref setMaxPagesPerStep pages or -1 for no limit.
+ * \param phase Index of this copy for progress reports.
+ * \param phases Total number of copies for progress reports.
+ *
+ * \return Running if the copy is complete, Cancelled or Failed
+ *      otherwise. If the copy is not complete, \c to is rolled back.
+ */
+RS_DbsSnapshot::Status RS_DbsSnapshot::backup(
+    sqlite3* from, sqlite3* to, int pages, int maxRestarts, int phase, int phases) {
+
+    sqlite3_backup* backup = sqlite3_backup_init(to, "main", from, "main");
+    if (backup==NULL) {
+        RS_Debug::error("RS_DbsSnapshot::backup: cannot start backup: %s",
+            sqlite3_errmsg(to));
+        return Failed;
+    }
+
+    Status result = Running;
+    int restarts = 0;
+    int previousRemaining = -1;
+    bool complete = false;
+    while (result==Running && !complete) {
+        int rc = sqlite3_backup_step(backup, pages);
+        int count = sqlite3_backup_pagecount(backup);
+        int remaining = sqlite3_backup_remaining(backup);
+
+        // source changed, backup started over:
+        if (previousRemaining!=-1 && remaining>previousRemaining) {
+            restarts++;
+            if (maxRestarts!=-1 && restarts>maxRestarts && pages!=-1) {
+                // larger steps are more likely to complete between two
+                // changes:
+                if (maxPagesPerStep==-1) {
+                    pages = -1;
+                }
+                else {
+                    pages = std::min(pages*2, maxPagesPerStep);
+                }
+            }
+        }
+        previousRemaining = remaining;
+
+        int done = phase*count + count - remaining;
+
+        sqlite3_mutex_enter(mutex);
+        pagesDone = done;
+        pageCount = phases*count;
+        bool cancelled = cancelRequested;
+        sqlite3_mutex_leave(mutex);
+
+        if (listener!=NULL) {
+            listener->snapshotProgress(done, phases*count);
+        }
+
+        if (rc==SQLITE_DONE) {
+            complete = true;
+        }
+        else if (rc!=SQLITE_OK && rc!=SQLITE_BUSY && rc!=SQLITE_LOCKED) {
+            RS_Debug::error("RS_DbsSnapshot::backup: backup step failed: %s",
+                sqlite3_errstr(rc));
+            result = Failed;
+        }
+        else if (cancelled) {
+            result = Cancelled;
+        }
+        else if (rc!=SQLITE_OK) {
+            // source or target locked by another connection:
+            sqlite3_sleep(5);
+        }
+    }
+
+    // rolls back the target if the backup did not complete:
+    if (sqlite3_backup_finish(backup)!=SQLITE_OK && result==Running) {
+        result = Failed;
+    }
+
+    return result;
+}
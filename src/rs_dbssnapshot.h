@@ -0,0 +1,150 @@
+#ifndef RS_DBSSNAPSHOT_H
+#define RS_DBSSNAPSHOT_H
+
+#include <string>
+
+#include "RS_DbsThread"
+
+struct sqlite3;
+struct sqlite3_mutex;
+
+
+
+/**
+ * Listener interface for snapshot progress. The listener is called
+ * from the worker thread of the snapshot.
+ */
+class RS_DbsSnapshotListener {
+public:
+    virtual ~RS_DbsSnapshotListener() {}
+
+    /**
+     * Called after every step with the number of pages copied so far
+     * and the total number of pages of the document.
+     */
+    virtual void snapshotProgress(int pagesDone, int pageCount) = 0;
+};
+
+
+
+/**
+ * Copies a document DB to a file on a worker thread, using the SQLite
+ * online backup API in small steps of pages.
+ *
+ * Between steps the source connection is free, so the document can be
+ * edited while the snapshot runs. For file-backed documents, changes
+ * made through the same connection while the snapshot is running are 
+ * included in the snapshot. In-memory documents are copied in two 
+ * phases (see \ref run) and the snapshot reflects the document at the
+ * end of the first, short phase. 
+ *
+ * The target file is written in one transaction: if the snapshot fails
+ * or is cancelled, the previous content of the file is left untouched.
+ *
+ * The first phase for in-memory documents needs a private in-memory 
+ * copy of the whole document, which is kept until the file has been 
+ * written. While the snapshot runs, an in-memory document therefore
+ * needs about twice its own size in memory (a 2 GB document needs 
+ * 4 GB). File-backed documents are copied without a private copy.
+ *
+ * This requires an SQLite library built in serialized threading mode
+ * (the default). Otherwise \ref start runs the snapshot on the calling
+ * thread.
+ *
+ * Snapshots are usually created with RS_DbStorage::snapshotTo.
+ *
+ * \author Andrew Mustun
+ * \ingroup qcaddbstorage
+ */
+class RS_DbsSnapshot : public RS_DbsThread {
+public:
+    enum Status {
+        Pending,
+        Running,
+        Done,
+        Cancelled,
+        Failed
+    };
+
+public:
+    RS_DbsSnapshot(
+        sqlite3* source,
+        const std::string& fileName,
+        RS_DbsSnapshotListener* listener = NULL
+    );
+    virtual ~RS_DbsSnapshot();
+
+    bool start();
+    void cancel();
+    Status waitForFinished();
+
+    Status getStatus() const;
+    bool isFinished() const;
+    double getProgress() const;
+
+    /**
+     * \return File name of the snapshot.
+     */
+    const std::string& getFileName() const {
+        return fileName;
+    }
+
+    /**
+     * Sets the number of pages copied per step. Smaller steps keep the
+     * source connection blocked for a shorter time. The default is 64
+     * pages.
+     */
+    void setPagesPerStep(int pages) {
+        pagesPerStep = pages;
+    }
+
+    /**
+     * Sets the maximum number of pages copied per step in the first 
+     * phase for in-memory documents (see \ref run). Once the copy has 
+     * been restarted \ref maxRestarts times by changes to the document,
+     * the steps are doubled after every further restart up to this 
+     * limit, which bounds the time one step blocks the connection of 
+     * the document. If the document is changed more often than the 
+     * copy can complete, the snapshot only completes when the changes
+     * pause. -1 copies the rest in a single step instead, which always
+     * completes but blocks for the time of copying the whole document.
+     * The default is 4096 pages.
+     */
+    void setMaxPagesPerStep(int pages) {
+        maxPagesPerStep = pages;
+    }
+
+protected:
+    virtual void run();
+
+private:
+    Status backup(sqlite3* from, sqlite3* to, int pages, int maxRestarts, int phase, int phases);
+
+    /**
+     * Factor by which steps are larger when an in-memory document is
+     * copied to memory.
+     */
+    static const int memoryStepFactor = 16;
+
+    /**
+     * Number of restarts when copying an in-memory document before the
+     * steps grow (see \ref setMaxPagesPerStep).
+     */
+    static const int maxRestarts = 3;
+
+private:
+    sqlite3* source;
+    std::string fileName;
+    RS_DbsSnapshotListener* listener;
+    int pagesPerStep;
+    int maxPagesPerStep;
+
+    //! protects the members below:
+    sqlite3_mutex* mutex;
+    Status status;
+    bool cancelRequested;
+    int pagesDone;
+    int pageCount;
+};
+
+#endif
@@ -0,0 +1,293 @@
+#include <sqlite3.h>
+
+#include "RS_DbsStatement"
+#include "RS_DbException"
+
+
+
+/**
+ * Prepares the given SQL on the given connection.
+ *
+ * \throws RS_DbException if the SQL cannot be prepared.
+ */
+RS_DbsStatement::RS_DbsStatement(sqlite3* handle, const std::string& sql)
+    : handle(handle), stmt(NULL), reading(false) {
+
+    if (sqlite3_prepare_v2(handle, sql.c_str(), (int)sql.size(), &stmt, NULL)!=SQLITE_OK) {
+        std::string error = sqlite3_errmsg(handle);
+        sqlite3_finalize(stmt);
+        stmt = NULL;
+        throw RS_DbException(error + " in: " + sql);
+    }
+}
+
+
+
+RS_DbsStatement::~RS_DbsStatement() {
+    sqlite3_finalize(stmt);
+}
+
+
+
+/**
+ * Binds NULL to the parameter with the given index.
+ */
+void RS_DbsStatement::bind(int index) {
+    check(sqlite3_bind_null(stmt, index));
+}
+
+
+
+void RS_DbsStatement::bind(int index, int value) {
+    check(sqlite3_bind_int(stmt, index, value));
+}
+
+
+
+void RS_DbsStatement::bind(int index, long long value) {
+    check(sqlite3_bind_int64(stmt, index, value));
+}
+
+
+
+void RS_DbsStatement::bind(int index, double value) {
+    check(sqlite3_bind_double(stmt, index, value));
+}
+
+
+
+void RS_DbsStatement::bind(int index, bool value) {
+    check(sqlite3_bind_int(stmt, index, value ? 1 : 0));
+}
+
+
+
+void RS_DbsStatement::bind(int index, const std::string& value) {
+    check(sqlite3_bind_text(stmt, index, value.data(), (int)value.size(), SQLITE_TRANSIENT));
+}
+
+
+
+void RS_DbsStatement::bind(int index, const char* value) {
+    check(sqlite3_bind_text(stmt, index, value, -1, SQLITE_TRANSIENT));
+}
+
+
+
+/**
+ * Binds a BLOB to the parameter with the given index. The data is not
+ * copied, it must stay valid until the statement has been executed.
+ */
+void RS_DbsStatement::bindBlob(int index, const void* data, int size) {
+    check(sqlite3_bind_blob(stmt, index, data, size, SQLITE_STATIC));
+}
+
+
+
+/**
+ * Runs the statement to completion. Rows returned by the statement
+ * (e.g. by a PRAGMA) are ignored.
+ */
+void RS_DbsStatement::executeNonQuery() {
+    int result;
+    do {
+        result = sqlite3_step(stmt);
+    } while (result==SQLITE_ROW);
+
+    if (result!=SQLITE_DONE) {
+        fail();
+    }
+    sqlite3_reset(stmt);
+}
+
+
+
+/**
+ * \return Integer in the first column of the first row.
+ *
+ * \throws RS_DbException if the statement returns no row.
+ */
+int RS_DbsStatement::executeInt() {
+    step(true);
+    int value = sqlite3_column_int(stmt, 0);
+    sqlite3_reset(stmt);
+    return value;
+}
+
+
+
+/**
+ * \return String in the first column of the first row.
+ *
+ * \throws RS_DbException if the statement returns no row.
+ */
+std::string RS_DbsStatement::executeString() {
+    step(true);
+    const unsigned char* text = sqlite3_column_text(stmt, 0);
+    std::string value = (text==NULL ? "" : (const char*)text);
+    sqlite3_reset(stmt);
+    return value;
+}
+
+
+
+/**
+ * \return Reader for the rows of the statement. The statement must not
+ *      be executed again while the reader exists.
+ */
+RS_DbsReader RS_DbsStatement::executeReader() {
+    return RS_DbsReader(*this);
+}
+
+
+
+/**
+ * Resets the statement and clears all bindings.
+ */
+void RS_DbsStatement::reset() {
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+}
+
+
+
+/**
+ * Steps to the first row of the statement.
+ *
+ * \throws RS_DbException on errors or if \c expectRow is true and the
+ *      statement returns no row. The statement is reset in that case.
+ */
+void RS_DbsStatement::step(bool expectRow) {
+    int result = sqlite3_step(stmt);
+    if (result==SQLITE_ROW) {
+        return;
+    }
+    if (result!=SQLITE_DONE) {
+        fail();
+    }
+    sqlite3_reset(stmt);
+    if (expectRow) {
+        throw RS_DbException(std::string("no row returned by: ") + sqlite3_sql(stmt));
+    }
+}
+
+
+
+void RS_DbsStatement::check(int result) {
+    if (result!=SQLITE_OK) {
+        throw RS_DbException(std::string(sqlite3_errmsg(handle)) + " in: " + sqlite3_sql(stmt));
+    }
+}
+
+
+
+/**
+ * Resets the statement after a failed step and throws the error.
+ */
+void RS_DbsStatement::fail() {
+    std::string error = sqlite3_errmsg(handle);
+    sqlite3_reset(stmt);
+    throw RS_DbException(error + " in: " + sqlite3_sql(stmt));
+}
+
+
+
+RS_DbsReader::RS_DbsReader(RS_DbsStatement& statement)
+    : statement(&statement) {
+
+    statement.reading = true;
+}
+
+
+
+RS_DbsReader::RS_DbsReader(const RS_DbsReader& other)
+    : statement(other.statement) {
+
+    other.statement = NULL;
+}
+
+
+
+/**
+ * Resets the statement.
+ */
+RS_DbsReader::~RS_DbsReader() {
+    if (statement!=NULL) {
+        sqlite3_reset(statement->stmt);
+        statement->reading = false;
+    }
+}
+
+
+
+RS_DbsReader& RS_DbsReader::operator=(const RS_DbsReader& other) {
+    if (&other!=this) {
+        if (statement!=NULL) {
+            sqlite3_reset(statement->stmt);
+            statement->reading = false;
+        }
+        statement = other.statement;
+        other.statement = NULL;
+    }
+    return *this;
+}
+
+
+
+/**
+ * Moves to the next row.
+ *
+ * \return False if there are no more rows.
+ */
+bool RS_DbsReader::read() {
+    if (statement==NULL) {
+        return false;
+    }
+    int result = sqlite3_step(statement->stmt);
+    if (result==SQLITE_ROW) {
+        return true;
+    }
+    if (result!=SQLITE_DONE) {
+        RS_DbsStatement* s = statement;
+        statement = NULL;
+        s->reading = false;
+        s->fail();
+    }
+    return false;
+}
+
+
+
+int RS_DbsReader::getInt(int column) {
+    return sqlite3_column_int(statement->stmt, column);
+}
+
+
+
+long long RS_DbsReader::getInt64(int column) {
+    return sqlite3_column_int64(statement->stmt, column);
+}
+
+
+
+double RS_DbsReader::getDouble(int column) {
+    return sqlite3_column_double(statement->stmt, column);
+}
+
+
+
+std::string RS_DbsReader::getString(int column) {
+    const unsigned char* text = sqlite3_column_text(statement->stmt, column);
+    return (text==NULL ? "" : (const char*)text);
+}
+
+
+
+/**
+ * \return The BLOB in the given column as a string of bytes.
+ */
+std::string RS_DbsReader::getBlob(int column) {
+    const void* data = sqlite3_column_blob(statement->stmt, column);
+    int size = sqlite3_column_bytes(statement->stmt, column);
+    return (data==NULL ? std::string() : std::string((const char*)data, size));
+}
@@ -0,0 +1,117 @@
+#ifndef RS_DBSSTATEMENT_H
+#define RS_DBSSTATEMENT_H
+
+#include <string>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+class RS_DbsReader;
+
+
+
+/**
+ * Prepared SQLite statement that can be executed any number of times.
+ * This is the statement type of RS_DbsStatementCache. Unlike
+ * RS_DbCommand, it is reset after every execution, so it never keeps
+ * a read transaction of its connection open, and it supports BLOBs.
+ *
+ * The interface follows RS_DbCommand. Errors are reported with
+ * RS_DbException.
+ *
+ * \author Andrew Mustun
+ * \ingroup qcaddbstorage
+ */
+class RS_DbsStatement {
+    friend class RS_DbsReader;
+
+public:
+    RS_DbsStatement(sqlite3* handle, const std::string& sql);
+    ~RS_DbsStatement();
+
+    void bind(int index);
+    void bind(int index, int value);
+    void bind(int index, long long value);
+    void bind(int index, double value);
+    void bind(int index, bool value);
+    void bind(int index, const std::string& value);
+    void bind(int index, const char* value);
+    void bindBlob(int index, const void* data, int size);
+
+    void executeNonQuery();
+    int executeInt();
+    std::string executeString();
+    RS_DbsReader executeReader();
+
+    void reset();
+
+    /**
+     * \return True while a reader of the statement exists.
+     */
+    bool isReading() const {
+        return reading;
+    }
+
+private:
+    RS_DbsStatement(const RS_DbsStatement&);
+    RS_DbsStatement& operator=(const RS_DbsStatement&);
+
+    void step(bool expectRow);
+    void check(int result);
+    void fail();
+
+private:
+    sqlite3* handle;
+    sqlite3_stmt* stmt;
+    bool reading;
+};
+
+
+
+/**
+ * Reads the rows of an RS_DbsStatement. The interface follows
+ * RS_DbReader. The statement is reset when the reader is destroyed,
+ * so a reader that is not read to the end does not keep the read
+ * transaction of its connection open:
+ *
+ * \code
+ * RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
+ *     db,
+ *     "SELECT objectTypeId "
+ *     "FROM Object "
+ *     "WHERE id=?"
+ * );
+ * cmd.bind(1, objectId);
+ * RS_DbsReader reader = cmd.executeReader();
+ * if (reader.read()) {
+ *     ...
+ * }
+ * \endcode
+ *
+ * Copying a reader hands the statement over to the copy.
+ *
+ * \author Andrew Mustun
+ * \ingroup qcaddbstorage
+ */
+class RS_DbsReader {
+public:
+    RS_DbsReader(RS_DbsStatement& statement);
+    RS_DbsReader(const RS_DbsReader& other);
+    ~RS_DbsReader();
+
+    RS_DbsReader& operator=(const RS_DbsReader& other);
+
+    bool read();
+
+    int getInt(int column);
+    long long getInt64(int column);
+    double getDouble(int column);
+    std::string getString(int column);
+    std::string getBlob(int column);
+
+private:
+    //! statement or NULL if it has been handed over to a copy:
+    mutable RS_DbsStatement* statement;
+};
+
+#endif
@@ -0,0 +1,181 @@
+#include <sqlite3.h>
+#include <sstream>
+
+#include "RS_DbsStatementCache"
+#include "RS_DbException"
+#include "RS_Debug"
+
+
+
+std::map<RS_DbConnection*, RS_DbsStatementCache*> RS_DbsStatementCache::caches;
+
+
+
+/**
+ * Creates an empty statement cache for the given connection and
+ * registers it, so it can be found with \ref getCache.
+ *
+ * \param handle SQLite handle of the connection (see RS_DbsHandle).
+ */
+RS_DbsStatementCache::RS_DbsStatementCache(RS_DbConnection& db, sqlite3* handle) 
+    : db(db), handle(handle), hits(0), misses(0) {
+
+    sqlite3_mutex* mutex = sqlite3_mutex_alloc(SQLITE_MUTEX_STATIC_APP2);
+    sqlite3_mutex_enter(mutex);
+    if (caches.count(&db)!=0) {
+        RS_Debug::error("RS_DbsStatementCache: "
+            "connection already has a statement cache");
+    }
+    caches[&db] = this;
+    sqlite3_mutex_leave(mutex);
+}
+
+
+
+/**
+ * Finalizes all cached statements and unregisters the cache.
+ * This has to happen before the connection is closed.
+ */
+RS_DbsStatementCache::~RS_DbsStatementCache() {
+    clear();
+
+    sqlite3_mutex* mutex = sqlite3_mutex_alloc(SQLITE_MUTEX_STATIC_APP2);
+    sqlite3_mutex_enter(mutex);
+    std::map<RS_DbConnection*, RS_DbsStatementCache*>::iterator it;
+    it = caches.find(&db);
+    if (it!=caches.end() && it->second==this) {
+        caches.erase(it);
+    }
+    sqlite3_mutex_leave(mutex);
+}
+
+
+
+/**
+ * \return Prepared statement for the given SQL that has no reader. All
+ *      bindings are cleared.
+ */
+RS_DbsStatement& RS_DbsStatementCache::getCommand(const std::string& sql) {
+    std::pair<
+        std::multimap<std::string, RS_DbsStatement*>::iterator,
+        std::multimap<std::string, RS_DbsStatement*>::iterator
+    > range = commands.equal_range(sql);
+
+    std::multimap<std::string, RS_DbsStatement*>::iterator it;
+    for (it=range.first; it!=range.second; ++it) {
+        if (!it->second->isReading()) {
+            hits++;
+            it->second->reset();
+            return *(it->second);
+        }
+    }
+
+    misses++;
+    RS_DbsStatement* cmd = new RS_DbsStatement(handle, sql);
+    commands.insert(range.second, std::pair<std::string, RS_DbsStatement*>(sql, cmd));
+    return *cmd;
+}
+
+
+
+/**
+ * Finalizes and removes all cached statements. 
+ */
+void RS_DbsStatementCache::clear() {
+    std::multimap<std::string, RS_DbsStatement*>::iterator it;
+    for (it=commands.begin(); it!=commands.end(); ++it) {
+        delete it->second;
+    }
+    commands.clear();
+}
+
+
+
+/**
+ * Resets all cached statements. A statement that has not been read to
+ * the end keeps the read transaction of its connection open, even 
+ * after COMMIT. Statements are reset after every use, so this only
+ * matters for readers that are still alive.
+ */
+void RS_DbsStatementCache::resetCommands() {
+    std::multimap<std::string, RS_DbsStatement*>::iterator it;
+    for (it=commands.begin(); it!=commands.end(); ++it) {
+        it->second->reset();
+    }
+}
+
+
+
+/**
+ * Resets the hit and miss counters.
+ */
+void RS_DbsStatementCache::resetCounters() {
+    hits = 0;
+    misses = 0;
+}
+
+
+
+/**
+ * \return The statement cache registered for the given connection or 
+ *      NULL.
+ */
+RS_DbsStatementCache* RS_DbsStatementCache::getCache(RS_DbConnection& db) {
+    RS_DbsStatementCache* ret = NULL;
+
+    sqlite3_mutex* mutex = sqlite3_mutex_alloc(SQLITE_MUTEX_STATIC_APP2);
+    sqlite3_mutex_enter(mutex);
+    std::map<RS_DbConnection*, RS_DbsStatementCache*>::iterator it;
+    it = caches.find(&db);
+    if (it!=caches.end()) {
+        ret = it->second;
+    }
+    sqlite3_mutex_leave(mutex);
+
+    return ret;
+}
+
+
+
+/**
+ * Convenience function that returns a prepared statement for the given 
+ * SQL from the cache of the given connection.
+ *
+ * \throws RS_DbException if the connection has no cache.
+ */
+RS_DbsStatement& RS_DbsStatementCache::prepare(RS_DbConnection& db, const std::string& sql) {
+    RS_DbsStatementCache* cache = getCache(db);
+    if (cache==NULL) {
+        RS_Debug::error("RS_DbsStatementCache::prepare: "
+            "connection has no statement cache");
+        throw RS_DbException("connection has no statement cache");
+    }
+    return cache->getCommand(sql);
+}
+
+
+
+/**
+ * \return SQL for a multi-row insert of \c rows rows into a table 
+ *      with \c columns columns. E.g. 
+ *      "INSERT INTO Object VALUES(?,?,?),(?,?,?);"
+ */
+std::string RS_DbsStatementCache::getInsertSql(const std::string& table, int columns, int rows) {
+    std::stringstream ss;
+    ss << "INSERT INTO " << table << " VALUES";
+    for (int r=0; r<rows; ++r) {
+        if (r!=0) {
+            ss << ",";
+        }
+        ss << "(";
+        for (int c=0; c<columns; ++c) {
+            if (c!=0) {
+                ss << ",";
+            }
+            ss << "?";
+        }
+        ss << ")";
+    }
+    ss << ";";
+    return ss.str();
+}
@@ -0,0 +1,116 @@
+#ifndef RS_DBSSTATEMENTCACHE_H
+#define RS_DBSSTATEMENTCACHE_H
+
+#include <map>
+#include <string>
+
+#include "RS_DbClient"
+#include "RS_DbsStatement"
+
+struct sqlite3;
+
+
+
+/**
+ * Cache of prepared statements for one DB connection. Statements are
+ * prepared the first time they are requested and then reused for the
+ * lifetime of the connection, so SQLite does not have to parse and plan
+ * the same SQL over and over again.
+ *
+ * Every RS_DbStorage owns one cache for its connection. The DB storage
+ * classes for the object types (RS_DbsObjectType and derived classes) 
+ * look up the cache of the connection they are given:
+ *
+ * \code
+ * RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
+ *     db, 
+ *     "SELECT geometry "
+ *     "FROM Line "
+ *     "WHERE id=?"
+ * );
+ * cmd.bind(1, objectId);
+ * \endcode
+ *
+ * The returned statement has all its bindings cleared. Statements are
+ * reset after every execution and when their reader is destroyed (see
+ * RS_DbsStatement), so a cached statement never keeps a read 
+ * transaction open between uses. A statement is shared by all users 
+ * of the same SQL text. If it is requested while one of its readers 
+ * still exists (e.g. the same query nested in the loop over its rows),
+ * another statement is prepared and cached for the same SQL, so the 
+ * reader is not reset.
+ *
+ * The registry of caches is shared by all threads. Every connection 
+ * that is used with \ref prepare must have a cache, there are no caches
+ * created on demand.
+ *
+ * Only static SQL should be cached. Statements that are built 
+ * dynamically (e.g. with embedded ID lists) should use a normal 
+ * RS_DbCommand instead.
+ *
+ * \author Andrew Mustun
+ * \ingroup qcaddbstorage
+ */
+class RS_DbsStatementCache {
+public:
+    RS_DbsStatementCache(RS_DbConnection& db, sqlite3* handle);
+    ~RS_DbsStatementCache();
+
+    RS_DbsStatement& getCommand(const std::string& sql);
+    void clear();
+    void resetCommands();
+
+    /**
+     * \return Number of requests that were served with an already
+     *      prepared statement.
+     */
+    int getHits() const {
+        return hits;
+    }
+
+    /**
+     * \return Number of requests that required a new statement to
+     *      be prepared.
+     */
+    int getMisses() const {
+        return misses;
+    }
+
+    /**
+     * \return Number of prepared statements currently in the cache.
+     */
+    int getSize() const {
+        return (int)commands.size();
+    }
+
+    void resetCounters();
+
+    static RS_DbsStatementCache* getCache(RS_DbConnection& db);
+    static RS_DbsStatement& prepare(RS_DbConnection& db, const std::string& sql);
+
+    static std::string getInsertSql(const std::string& table, int columns, int rows);
+
+    /**
+     * Maximum number of rows that are inserted with a single multi-row 
+     * INSERT statement. Must be small enough to stay below the SQLite 
+     * limit of 999 host parameters for the widest table.
+     */
+    static const int rowsPerInsert = 64;
+
+private:
+    RS_DbsStatementCache(const RS_DbsStatementCache&);
+    RS_DbsStatementCache& operator=(const RS_DbsStatementCache&);
+
+private:
+    RS_DbConnection& db;
+    sqlite3* handle;
+    //! statements by SQL, more than one for nested use of the same SQL:
+    std::multimap<std::string, RS_DbsStatement*> commands;
+    int hits;
+    int misses;
+
+    //! all caches, protected by SQLITE_MUTEX_STATIC_APP2:
+    static std::map<RS_DbConnection*, RS_DbsStatementCache*> caches;
+};
+
+#endif
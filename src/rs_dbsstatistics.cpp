@@ -0,0 +1,244 @@
+#include <algorithm>
+#include <cstdio>
+#include <sqlite3.h>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#include <sys/time.h>
+#endif
+
+#include "RS_DbsStatistics"
+#include "RS_Debug"
+
+
+
+RS_DbsStatistics::RS_DbsStatistics(sqlite3* handle)
+    : handle(handle),
+      enabled(false),
+      rows(0),
+      rowStatement(NULL),
+      rowRunning(NULL) {
+}
+
+
+
+/**
+ * The statistics must be disabled before the connection is closed.
+ */
+RS_DbsStatistics::~RS_DbsStatistics() {
+    if (enabled) {
+        RS_Debug::error("RS_DbsStatistics::~RS_DbsStatistics: "
+            "statistics still enabled");
+    }
+}
+
+
+
+/**
+ * Enables or disables the statistics. Collected statistics are kept
+ * when the statistics are disabled.
+ */
+void RS_DbsStatistics::setEnabled(bool on) {
+    if (on==enabled) {
+        return;
+    }
+
+    if (on) {
+        sqlite3_trace_v2(
+            handle,
+            SQLITE_TRACE_STMT | SQLITE_TRACE_ROW | SQLITE_TRACE_PROFILE,
+            traceCallback,
+            this
+        );
+    }
+    else {
+        sqlite3_trace_v2(handle, 0, NULL, NULL);
+        running.clear();
+        rowStatement = NULL;
+        rowRunning = NULL;
+    }
+
+    enabled = on;
+}
+
+
+
+/**
+ * Clears all statistics. Statements that are running are counted from
+ * now on.
+ */
+void RS_DbsStatistics::reset() {
+    operations.clear();
+    statements.clear();
+    running.clear();
+    rowStatement = NULL;
+    rowRunning = NULL;
+    rows = 0;
+}
+
+
+
+void RS_DbsStatistics::addOperation(const char* operation, double time, long long rows) {
+    Record& record = operations[operation];
+    record.calls++;
+    record.rows += rows;
+    record.totalTime += time;
+    record.maxTime = std::max(record.maxTime, time);
+}
+
+
+
+/**
+ * Called by SQLite when a statement starts, for every row returned by
+ * a statement and when a statement is done or reset.
+ */
+int RS_DbsStatistics::traceCallback(unsigned int type, void* context, void* p, void* x) {
+    RS_DbsStatistics* statistics = (RS_DbsStatistics*)context;
+    sqlite3_stmt* stmt = (sqlite3_stmt*)p;
+
+    if (type==SQLITE_TRACE_ROW) {
+        if (stmt!=statistics->rowStatement) {
+            std::map<sqlite3_stmt*, Running>::iterator it = 
+                statistics->running.find(stmt);
+            if (it==statistics->running.end()) {
+                // started before the statistics were enabled or reset:
+                return 0;
+            }
+            statistics->rowStatement = stmt;
+            statistics->rowRunning = &it->second;
+        }
+        statistics->rowRunning->lastRow = now();
+        statistics->rowRunning->rows++;
+        statistics->rows++;
+        return 0;
+    }
+
+    if (type==SQLITE_TRACE_STMT) {
+        // also called at the start of trigger programs, marked with
+        // a leading "--":
+        const char* sql = (const char*)x;
+        if (sql==NULL || sql[0]!='-' || sql[1]!='-') {
+            Running& r = statistics->running[stmt];
+            r.start = now();
+            r.lastRow = r.start;
+            r.rows = 0;
+            r.changes = sqlite3_total_changes(statistics->handle);
+
+            // counted when started, so statements that are still 
+            // running are listed:
+            const char* text = sqlite3_sql(stmt);
+            r.record = &statistics->statements[text!=NULL ? text : ""];
+            r.record->calls++;
+        }
+        return 0;
+    }
+
+    if (type==SQLITE_TRACE_PROFILE) {
+        double end = now();
+
+        std::map<sqlite3_stmt*, Running>::iterator it = 
+            statistics->running.find(stmt);
+        if (it==statistics->running.end()) {
+            return 0;
+        }
+        Running r = it->second;
+        statistics->running.erase(it);
+        if (stmt==statistics->rowStatement) {
+            statistics->rowStatement = NULL;
+            statistics->rowRunning = NULL;
+        }
+
+        // a statement that is still busy is reset before it is done,
+        // typically long after the caller has read the last row:
+        if (sqlite3_stmt_busy(stmt)) {
+            end = r.lastRow;
+        }
+
+        if (!sqlite3_stmt_readonly(stmt)) {
+            // sqlite3_changes is not updated by DDL statements and the 
+            // total changes include the R*Tree tables maintained by 
+            // SQLite, so neither is right on its own:
+            sqlite3* handle = statistics->handle;
+            long long changes = std::min(
+                (long long)sqlite3_changes(handle),
+                (long long)sqlite3_total_changes(handle) - r.changes
+            );
+            r.rows += changes;
+            statistics->rows += changes;
+        }
+
+        double time = end - r.start;
+
+        Record& record = *r.record;
+        record.rows += r.rows;
+        record.totalTime += time;
+        record.maxTime = std::max(record.maxTime, time);
+    }
+
+    return 0;
+}
+
+
+
+/**
+ * \return All statistics as text table, operations and statements
+ *      each sorted by total time, with times in milliseconds.
+ */
+std::string RS_DbsStatistics::toString() const {
+    std::string ret;
+    char buf[256];
+
+    const std::map<std::string, Record>* maps[2] = { &operations, &statements };
+    const char* titles[2] = { "operation", "statement" };
+
+    for (int i=0; i<2; i++) {
+        std::vector<std::pair<double, std::string> > sorted;
+        std::map<std::string, Record>::const_iterator it;
+        for (it=maps[i]->begin(); it!=maps[i]->end(); ++it) {
+            sorted.push_back(std::make_pair(-it->second.totalTime, it->first));
+        }
+        std::sort(sorted.begin(), sorted.end());
+
+        snprintf(buf, sizeof(buf), "%12s %12s %12s %12s  %s\n",
+            "calls", "rows", "total ms", "max ms", titles[i]);
+        ret += buf;
+
+        for (unsigned int k=0; k<sorted.size(); k++) {
+            const Record& record = maps[i]->find(sorted[k].second)->second;
+            snprintf(buf, sizeof(buf), "%12lld %12lld %12.3f %12.3f  ",
+                record.calls, record.rows,
+                record.totalTime * 1.0e3, record.maxTime * 1.0e3);
+            ret += buf;
+            ret += sorted[k].second;
+            ret += "\n";
+        }
+    }
+
+    return ret;
+}
+
+
+
+/**
+ * \return Time in seconds from a monotonic clock if available.
+ */
+double RS_DbsStatistics::now() {
+#ifdef _WIN32
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1.0e-9;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1.0e-6;
+#endif
+}
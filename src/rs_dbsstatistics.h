@@ -0,0 +1,168 @@
+#ifndef RS_DBSSTATISTICS_H
+#define RS_DBSSTATISTICS_H
+
+#include <map>
+#include <string>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+
+
+/**
+ * Run time statistics of a storage: call count, rows touched, total
+ * and maximum wall time for every logical storage operation (e.g.
+ * RS_DbStorage::toggleUndoStatus) and for every SQL statement that is
+ * executed on the connection of the storage.
+ *
+ * Statements are measured with the trace hooks of SQLite
+ * (sqlite3_trace_v2). The time of a statement runs from its first step
+ * until it is done or, if the caller stops reading early, until its
+ * last row. For queries it therefore includes the time the caller
+ * spends between reading rows. Rows touched are the rows returned by
+ * queries plus the rows changed by INSERT, UPDATE and DELETE
+ * statements. Operations are measured with RS_DbsOperationTimer and include the
+ * time and rows of nested operations.
+ *
+ * Statistics are disabled by default. While disabled, no trace
+ * callback is installed and every operation costs only one check of a
+ * flag.
+ *
+ * \code
+ * storage.getStatistics().setEnabled(true);
+ * // ... undo something slow ...
+ * RS_Debug::debug("%s", storage.getStatistics().toString().c_str());
+ * storage.getStatistics().reset();
+ * \endcode
+ *
+ * \author Andrew Mustun
+ * \ingroup qcaddbstorage
+ */
+class RS_DbsStatistics {
+public:
+    /**
+     * Statistics of one operation or statement. Times are in seconds.
+     */
+    struct Record {
+        Record() : calls(0), rows(0), totalTime(0.0), maxTime(0.0) {}
+        long long calls;
+        long long rows;
+        double totalTime;
+        double maxTime;
+    };
+
+public:
+    RS_DbsStatistics(sqlite3* handle);
+    ~RS_DbsStatistics();
+
+    void setEnabled(bool on);
+
+    bool isEnabled() const {
+        return enabled;
+    }
+
+    void reset();
+
+    /**
+     * \return Statistics of all operations by operation name.
+     */
+    const std::map<std::string, Record>& getOperations() const {
+        return operations;
+    }
+
+    /**
+     * \return Statistics of all statements by SQL text.
+     */
+    const std::map<std::string, Record>& getStatements() const {
+        return statements;
+    }
+
+    /**
+     * \return Number of rows touched by all statements so far.
+     */
+    long long getRows() const {
+        return rows;
+    }
+
+    void addOperation(const char* operation, double time, long long rows);
+
+    std::string toString() const;
+
+    static double now();
+
+private:
+    static int traceCallback(unsigned int type, void* context, void* p, void* x);
+
+    RS_DbsStatistics(const RS_DbsStatistics&);
+    RS_DbsStatistics& operator=(const RS_DbsStatistics&);
+
+private:
+    //! SQLite handle of the connection (see RS_DbsHandle):
+    sqlite3* handle;
+    bool enabled;
+
+    std::map<std::string, Record> operations;
+    std::map<std::string, Record> statements;
+    long long rows;
+
+    /**
+     * Statement that has started and is not done or reset yet.
+     */
+    struct Running {
+        double start;
+        double lastRow;
+        long long rows;
+        //! sqlite3_total_changes when the statement started:
+        long long changes;
+        Record* record;
+    };
+    std::map<sqlite3_stmt*, Running> running;
+    //! statement that returned the last row (rows usually come in runs
+    //! from the same statement):
+    sqlite3_stmt* rowStatement;
+    Running* rowRunning;
+};
+
+
+
+/**
+ * Measures one storage operation for RS_DbsStatistics from construction
+ * to destruction:
+ *
+ * \code
+ * void RS_DbStorage::toggleUndoStatus(RS_Object::Id objectId) {
+ *     RS_DbsOperationTimer timer(statistics, "toggleUndoStatus");
+ *     ...
+ * }
+ * \endcode
+ */
+class RS_DbsOperationTimer {
+public:
+    RS_DbsOperationTimer(RS_DbsStatistics& statistics, const char* operation)
+        : statistics(NULL), operation(operation), start(0.0), rows(0) {
+
+        if (statistics.isEnabled()) {
+            this->statistics = &statistics;
+            start = RS_DbsStatistics::now();
+            rows = statistics.getRows();
+        }
+    }
+
+    ~RS_DbsOperationTimer() {
+        if (statistics!=NULL) {
+            statistics->addOperation(
+                operation,
+                RS_DbsStatistics::now() - start,
+                statistics->getRows() - rows
+            );
+        }
+    }
+
+private:
+    RS_DbsStatistics* statistics;
+    const char* operation;
+    double start;
+    long long rows;
+};
+
+#endif
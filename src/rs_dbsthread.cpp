@@ -0,0 +1,147 @@
+#include "RS_DbsThread"
+#include "RS_Debug"
+
+
+
+RS_DbsThread::RS_DbsThread()
+    : running(false) {
+}
+
+
+
+RS_DbsThread::~RS_DbsThread() {
+    if (running) {
+        RS_Debug::error("RS_DbsThread::~RS_DbsThread: "
+            "thread destroyed while running");
+    }
+}
+
+
+
+/**
+ * Starts the thread which calls \ref run.
+ *
+ * \return False if the thread could not be started.
+ */
+bool RS_DbsThread::start() {
+    if (running) {
+        return false;
+    }
+
+#ifdef _WIN32
+    handle = CreateThread(NULL, 0, threadFunction, this, 0, NULL);
+    running = (handle!=NULL);
+#else
+    running = (pthread_create(&handle, NULL, threadFunction, this)==0);
+#endif
+
+    if (!running) {
+        RS_Debug::error("RS_DbsThread::start: cannot start thread");
+    }
+    return running;
+}
+
+
+
+/**
+ * Blocks until \ref run has returned.
+ */
+void RS_DbsThread::wait() {
+    if (!running) {
+        return;
+    }
+
+#ifdef _WIN32
+    WaitForSingleObject(handle, INFINITE);
+    CloseHandle(handle);
+#else
+    pthread_join(handle, NULL);
+#endif
+
+    running = false;
+}
+
+
+
+#ifdef _WIN32
+DWORD WINAPI RS_DbsThread::threadFunction(LPVOID thread) {
+    ((RS_DbsThread*)thread)->run();
+    return 0;
+}
+#else
+void* RS_DbsThread::threadFunction(void* thread) {
+    ((RS_DbsThread*)thread)->run();
+    return NULL;
+}
+#endif
+
+
+
+RS_DbsWaitCondition::RS_DbsWaitCondition() {
+#ifdef _WIN32
+    InitializeCriticalSection(&mutex);
+    InitializeConditionVariable(&condition);
+#else
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&condition, NULL);
+#endif
+}
+
+
+
+RS_DbsWaitCondition::~RS_DbsWaitCondition() {
+#ifdef _WIN32
+    DeleteCriticalSection(&mutex);
+#else
+    pthread_cond_destroy(&condition);
+    pthread_mutex_destroy(&mutex);
+#endif
+}
+
+
+
+void RS_DbsWaitCondition::lock() {
+#ifdef _WIN32
+    EnterCriticalSection(&mutex);
+#else
+    pthread_mutex_lock(&mutex);
+#endif
+}
+
+
+
+void RS_DbsWaitCondition::unlock() {
+#ifdef _WIN32
+    LeaveCriticalSection(&mutex);
+#else
+    pthread_mutex_unlock(&mutex);
+#endif
+}
+
+
+
+/**
+ * Blocks until another thread calls \ref wakeOne. The mutex must be 
+ * locked. Callers must check their condition again after this returns,
+ * since waits may end spuriously.
+ */
+void RS_DbsWaitCondition::wait() {
+#ifdef _WIN32
+    SleepConditionVariableCS(&condition, &mutex, INFINITE);
+#else
+    pthread_cond_wait(&condition, &mutex);
+#endif
+}
+
+
+
+/**
+ * Wakes up one of the threads blocked in \ref wait.
+ */
+void RS_DbsWaitCondition::wakeOne() {
+#ifdef _WIN32
+    WakeConditionVariable(&condition);
+#else
+    pthread_cond_signal(&condition);
+#endif
+}
@@ -0,0 +1,97 @@
+#ifndef RS_DBSTHREAD_H
+#define RS_DBSTHREAD_H
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+
+
+/**
+ * Minimal worker thread for background DB operations (e.g.
+ * RS_DbsSnapshot). This library does not depend on Qt, so this wraps
+ * the native thread API of the platform.
+ *
+ * Derived classes implement \ref run. The thread must be joined with
+ * \ref wait before the object is destroyed.
+ *
+ * \author Andrew Mustun
+ * \ingroup qcaddbstorage
+ */
+class RS_DbsThread {
+public:
+    RS_DbsThread();
+    virtual ~RS_DbsThread();
+
+    bool start();
+    void wait();
+
+    /**
+     * \return True if the thread has been started and not yet joined.
+     */
+    bool isRunning() const {
+        return running;
+    }
+
+protected:
+    virtual void run() = 0;
+
+private:
+    RS_DbsThread(const RS_DbsThread&);
+    RS_DbsThread& operator=(const RS_DbsThread&);
+
+#ifdef _WIN32
+    static DWORD WINAPI threadFunction(LPVOID thread);
+#else
+    static void* threadFunction(void* thread);
+#endif
+
+private:
+#ifdef _WIN32
+    HANDLE handle;
+#else
+    pthread_t handle;
+#endif
+    bool running;
+};
+
+
+
+/**
+ * Mutex with a condition variable, used by threads that wait for a
+ * shared resource (e.g. a connection of RS_DbsReaderPool). Wraps the 
+ * native API of the platform like RS_DbsThread.
+ *
+ * \ref wait must be called with the mutex locked. It releases the mutex
+ * while waiting and locks it again before it returns.
+ *
+ * \author Andrew Mustun
+ * \ingroup qcaddbstorage
+ */
+class RS_DbsWaitCondition {
+public:
+    RS_DbsWaitCondition();
+    ~RS_DbsWaitCondition();
+
+    void lock();
+    void unlock();
+    void wait();
+    void wakeOne();
+
+private:
+    RS_DbsWaitCondition(const RS_DbsWaitCondition&);
+    RS_DbsWaitCondition& operator=(const RS_DbsWaitCondition&);
+
+private:
+#ifdef _WIN32
+    CRITICAL_SECTION mutex;
+    CONDITION_VARIABLE condition;
+#else
+    pthread_mutex_t mutex;
+    pthread_cond_t condition;
+#endif
+};
+
+#endif
@@ -1,105 +1,357 @@
+#include <algorithm>
+#include <cstdio>
+#include <sqlite3.h>
+
 #include "RS_Debug"
 #include "RS_DbStorage"
 #include "RS_DbException"
 #include "RS_DbsEntityType"
+#include "RS_DbsHandle"
+#include "RS_DbsIdTable"
 #include "RS_DbsObjectTypeRegistry"
+#include "RS_DbsPropertyChangeCodec"
+#include "RS_DbsReaderPool"
+#include "RS_DbsSchema"
 #include "RS_DbsUcsType"
+#include "RS_DbsStatementCache"
 
 
 
 /**
- * Sets up a DB for the document and initializes the tables.
+ * Sets up a DB for the document. New DBs are initialized, existing 
+ * documents are opened and migrated to the current schema if necessary
+ * (see RS_DbsSchema).
  *
  * \param fileName File name of DB file or ":memory:" to keep the
  *      DB in memory.
+ * \param options SQLite settings, e.g. 
+ *      RS_DbStorageOptions::getInteractive(). If reader connections 
+ *      are configured, file-backed documents are switched to WAL mode
+ *      (see RS_DbsReaderPool). In-memory documents have no reader 
+ *      connections.
+ *
+ * \throws RS_DbException if the document cannot be opened, e.g. 
+ *      because it was written by a newer version (see RS_DbsSchema).
  */
-RS_DbStorage::RS_DbStorage(const std::string& fileName) {
-    db.open(fileName.c_str());
-    
-    // 'Transaction' is a reserved keyword, so we use 'Transaction2':
-    db.executeNonQuery(
-        "CREATE TABLE Transaction2("
-            "id INTEGER PRIMARY KEY, "
-            "parentId INTEGER, "
-            "text VARCHAR"
-        ");"
-    );
-    
-    db.executeNonQuery(
-        "CREATE TABLE AffectedObjects("
-            "tid INTEGER, "
-            "oid INTEGER, "
-            "PRIMARY KEY(tid, oid)"
-        ");"
-    );
-    
-    db.executeNonQuery(
-        "CREATE TABLE PropertyChanges("
-            "tid INTEGER, "
-            "oid INTEGER, "
-            "pid INTEGER, "
-            "dataType INTEGER, "
-            "oldValue BLOB, "
-            "newValue BLOB, "
-            "PRIMARY KEY(tid, oid, pid)"
-        ");"
-    );
-    
-    db.executeNonQuery(
-        "CREATE TABLE Variables("
-            "key STRING PRIMARY KEY, "
-            "value BLOB"
-        ");"
-    );
-    
-    RS_DbCommand cmd(
-        db, 
-        "INSERT INTO Variables VALUES(?,?);"
-    );
-    cmd.bind(1, "LastTransaction");
-    cmd.bind(2, -1);
-    cmd.executeNonQuery();
- 
-    // initialize the DB for all registered object types:
-    RS_DbsObjectTypeRegistry::initDb(db);
+RS_DbStorage::RS_DbStorage(const std::string& fileName, const RS_DbStorageOptions& options) 
+    : handle(RS_DbsHandle::open(db, fileName)), 
+      statementCache(db, handle), 
+      statistics(handle), 
+      boundingBoxEmpty(true), 
+      boundingBoxValid(false), 
+      options(options), 
+      undoLogCompression(true), 
+      maxUndoSteps(0), 
+      maxUndoBytes(0), 
+      undoLogSize(-1), 
+      undoSteps(-1), 
+      objectDirectoryLoaded(false), 
+      snapshot(NULL), 
+      readerPool(NULL) {
+
+    if (options.statistics) {
+        statistics.setEnabled(true);
+    }
+
+    if (options.readerConnections>0) {
+        if (fileName==":memory:") {
+            RS_Debug::error("RS_DbStorage::RS_DbStorage: "
+                "reader connections require a file document");
+            this->options.readerConnections = 0;
+        }
+        else if (options.journalMode!=RS_DbStorageOptions::JournalWal) {
+            RS_Debug::debug("RS_DbStorage::RS_DbStorage: "
+                "switching to WAL mode for reader connections");
+            this->options.journalMode = RS_DbStorageOptions::JournalWal;
+        }
+    }
+
+    RS_DbStorageOptions::JournalMode journalMode = 
+        RS_DbStorageOptions::JournalDefault;
+
+    // the destructor does not run if the document cannot be opened,
+    // so the connection is closed here:
+    try {
+        // refuses documents of newer versions before anything is
+        // changed in them:
+        RS_DbsSchema::checkVersion(db);
+
+        // must happen before the first table is created for the page
+        // size to have an effect:
+        journalMode = this->options.apply(db);
+
+        // create, migrate or check the schema:
+        RS_DbsSchema::open(db);
+
+        // the object directory is built on first use (see 
+        // getObjectDirectory) so opening a document only reads the 
+        // schema metadata and the selection:
+        selection.load(db);
+
+        if (this->options.readerConnections>0) {
+            if (sqlite3_threadsafe()==0) {
+                RS_Debug::error("RS_DbStorage::RS_DbStorage: "
+                    "SQLite is single-threaded, no reader connections");
+                this->options.readerConnections = 0;
+            }
+            else if (journalMode!=RS_DbStorageOptions::JournalWal) {
+                // readers would block the writer:
+                RS_Debug::error("RS_DbStorage::RS_DbStorage: "
+                    "document not in WAL mode, no reader connections");
+                this->options.readerConnections = 0;
+            }
+            else {
+                readerPool = new RS_DbsReaderPool(fileName, this->options);
+            }
+        }
+    }
+    catch (...) {
+        RS_Debug::error("RS_DbStorage::RS_DbStorage: "
+            "cannot open document %s", fileName.c_str());
+        statementCache.clear();
+        statistics.setEnabled(false);
+        db.close();
+        throw;
+    }
+
+    // the cached size and number of steps of the undo log are wrong 
+    // after a rollback:
+    sqlite3_rollback_hook(handle, onRollback, this);
 }
 
 
 
 /**
- * Closes the DB connection.
+ * Cancels a running snapshot, closes the reader connections, stores 
+ * the selection, finalizes all cached statements and closes the DB 
+ * connection.
  */
 RS_DbStorage::~RS_DbStorage() {
+    // cancels a running snapshot:
+    delete snapshot;
+    delete readerPool;
+
+    // destructors must not throw:
+    try {
+        saveSelection();
+    }
+    catch (...) {
+        RS_Debug::error("RS_DbStorage::~RS_DbStorage: "
+            "cannot save the selection");
+    }
+
+    objectCache.clear();
+    statementCache.clear();
+    statistics.setEnabled(false);
     db.close();
 }
 
 
 
+/**
+ * Deletes the DB file of a document that is not open together with its
+ * journal, WAL and shared memory files. Files that do not exist are 
+ * ignored.
+ */
+void RS_DbStorage::removeFiles(const std::string& fileName) {
+    std::remove(fileName.c_str());
+    std::remove((fileName + "-journal").c_str());
+    std::remove((fileName + "-wal").c_str());
+    std::remove((fileName + "-shm").c_str());
+}
+
+
+
+/**
+ * \return Directory with the object type and undo status of all 
+ *      objects. The directory is built on first use.
+ */
+RS_DbsObjectDirectory& RS_DbStorage::getObjectDirectory() {
+    if (!objectDirectoryLoaded) {
+        objectDirectory.rebuild(db);
+        objectDirectoryLoaded = true;
+    }
+    return objectDirectory;
+}
+
+
+
+/**
+ * \return true if the given object exists, is not undone and is an 
+ *      entity. The selection may contain IDs of other objects, which
+ *      are not reported as selected entities.
+ */
+bool RS_DbStorage::isVisibleEntity(RS_Object::Id objectId) {
+    RS_DbsObjectDirectory& directory = getObjectDirectory();
+    if (directory.isUndone(objectId)) {
+        return false;
+    }
+    RS_DbsObjectType* dbObjectType = 
+        RS_DbsObjectTypeRegistry::getDbObject(directory.getObjectTypeId(objectId));
+    return dynamic_cast<RS_DbsEntityType*>(dbObjectType)!=NULL;
+}
+
+
+
 void RS_DbStorage::queryAllObjects(std::set<RS_Object::Id>& result) {
+    RS_DbsOperationTimer timer(statistics, "queryAllObjects");
     RS_DbsObjectType::queryAllObjects(db, result);
 }
 
 
 
 void RS_DbStorage::queryAllEntities(std::set<RS_Entity::Id>& result) {
+    RS_DbsOperationTimer timer(statistics, "queryAllEntities");
     return RS_DbsEntityType::queryAllEntities(db, result);
 }
 
 
 
 void RS_DbStorage::queryAllUcs(std::set<RS_Ucs::Id>& result) {
+    RS_DbsOperationTimer timer(statistics, "queryAllUcs");
     return RS_DbsUcsType::queryAllUcs(db, result);
 }
 
 
 
+/**
+ * Streaming variant of \ref queryAllObjects. Reports the IDs of all 
+ * objects that are not undone in ascending order to the given visitor
+ * without collecting them (see RS_DbsIdVisitor).
+ */
+void RS_DbStorage::queryAllObjects(RS_DbsIdVisitor& visitor) {
+    RS_DbsOperationTimer timer(statistics, "queryAllObjects");
+    RS_DbsObjectType::queryAllObjects(db, visitor);
+}
+
+
+
+/**
+ * Streaming variant of \ref queryAllEntities.
+ */
+void RS_DbStorage::queryAllEntities(RS_DbsIdVisitor& visitor) {
+    RS_DbsOperationTimer timer(statistics, "queryAllEntities");
+    RS_DbsEntityType::queryAllEntities(db, visitor);
+}
+
+
+
+/**
+ * Streaming variant of \ref queryAllUcs.
+ */
+void RS_DbStorage::queryAllUcs(RS_DbsIdVisitor& visitor) {
+    RS_DbsOperationTimer timer(statistics, "queryAllUcs");
+    RS_DbsUcsType::queryAllUcs(db, visitor);
+}
+
+
+
 void RS_DbStorage::querySelectedEntities(std::set<RS_Entity::Id>& result) {
-    return RS_DbsEntityType::querySelectedEntities(db, result);
+    RS_DbsOperationTimer timer(statistics, "querySelectedEntities");
+    const RS_DbsIdSet& selected = selection.getSelectedIds();
+
+    RS_DbsIdSet::const_iterator it;
+    for (it=selected.begin(); it!=selected.end(); ++it) {
+        if (isVisibleEntity(*it)) {
+            result.insert(result.end(), *it);
+        }
+    }
+}
+
+
+
+/**
+ * Streaming variant of \ref querySelectedEntities. The selection is 
+ * kept in memory, so no DB access is needed.
+ */
+void RS_DbStorage::querySelectedEntities(RS_DbsIdVisitor& visitor) {
+    RS_DbsOperationTimer timer(statistics, "querySelectedEntities");
+    const RS_DbsIdSet& selected = selection.getSelectedIds();
+
+    RS_DbsIdSet::const_iterator it;
+    for (it=selected.begin(); it!=selected.end(); ++it) {
+        if (isVisibleEntity(*it)) {
+            if (!visitor.visit(*it)) {
+                break;
+            }
+        }
+    }
+}
+
+
+
+/**
+ * Variant of \ref queryAllObjects that adds the IDs to a compact ID 
+ * set (see RS_DbsIdSet).
+ */
+void RS_DbStorage::queryAllObjects(RS_DbsIdSet& result) {
+    RS_DbsOperationTimer timer(statistics, "queryAllObjects");
+    RS_DbsObjectType::queryAllObjects(db, result);
+}
+
+
+
+void RS_DbStorage::queryAllEntities(RS_DbsIdSet& result) {
+    RS_DbsOperationTimer timer(statistics, "queryAllEntities");
+    RS_DbsEntityType::queryAllEntities(db, result);
+}
+
+
+
+void RS_DbStorage::queryAllUcs(RS_DbsIdSet& result) {
+    RS_DbsOperationTimer timer(statistics, "queryAllUcs");
+    RS_DbsUcsType::queryAllUcs(db, result);
+}
+
+
+
+void RS_DbStorage::querySelectedEntities(RS_DbsIdSet& result) {
+    RS_DbsOperationTimer timer(statistics, "querySelectedEntities");
+    const RS_DbsIdSet& selected = selection.getSelectedIds();
+
+    RS_DbsIdSet ids;
+    RS_DbsIdSet::const_iterator it;
+    for (it=selected.begin(); it!=selected.end(); ++it) {
+        if (isVisibleEntity(*it)) {
+            ids.insert(*it);
+        }
+    }
+    result.unite(ids);
 }
 
 
 
+void RS_DbStorage::queryEntitiesInBox(
+    const RS_Box& box, RS_DbsIdSet& result, bool inside) {
+    RS_DbsOperationTimer timer(statistics, "queryEntitiesInBox");
+
+    RS_DbsEntityType::queryEntitiesInBox(db, box, result, inside);
+}
+
+
+
+/**
+ * Queries all entities whose bounding box intersects the given box or,
+ * if \c inside is true, is completely inside the given box. Uses the
+ * spatial index, so the cost depends on the number of entities found
+ * rather than on the size of the document.
+ */
+void RS_DbStorage::queryEntitiesInBox(
+    const RS_Box& box, std::set<RS_Entity::Id>& result, bool inside) {
+    RS_DbsOperationTimer timer(statistics, "queryEntitiesInBox");
+
+    RS_DbsEntityType::queryEntitiesInBox(db, box, result, inside);
+}
+
+
+
+/**
+ * Instantiates the object with the given ID. If the object cache is
+ * enabled, the object is copied from the cache if possible. The caller
+ * is responsible for deleting the instance.
+ */
 RS_Object* RS_DbStorage::queryObject(RS_Object::Id objectId) {
+    RS_DbsOperationTimer timer(statistics, "queryObject");
     RS_Object::ObjectTypeId objectTypeId = getObjectTypeId(objectId);
     RS_DbsObjectType* dbsObjectType = RS_DbsObjectTypeRegistry::getDbObject(objectTypeId);
     if (dbsObjectType==NULL) {
@@ -108,7 +360,24 @@ RS_Object* RS_DbStorage::queryObject(RS_Object::Id objectId) {
         return NULL;
     }
 
-    return dbsObjectType->loadObject(db, objectId);
+    RS_Object* object = NULL;
+
+    if (objectCache.isEnabled()) {
+        RS_Object* cachedObject = objectCache.get(objectId);
+        if (cachedObject!=NULL) {
+            object = dbsObjectType->cloneObject(*cachedObject);
+        }
+    }
+
+    if (object==NULL) {
+        object = dbsObjectType->loadObject(db, objectId);
+        if (object!=NULL && objectCache.isEnabled()) {
+            objectCache.insert(dbsObjectType->cloneObject(*object));
+        }
+    }
+
+    updateSelectionStatus(object);
+    return object;
 }
 
 
@@ -148,6 +417,7 @@ RS_Ucs* RS_DbStorage::queryUcs(RS_Ucs::Id ucsId) {
 
 
 RS_Ucs* RS_DbStorage::queryUcs(const std::string& ucsName) {
+    RS_DbsOperationTimer timer(statistics, "queryUcs");
     RS_DbsUcsType dbsUcsType;
     
     RS_Ucs::Id ucsId = dbsUcsType.getUcsId(db, ucsName);
@@ -160,8 +430,105 @@ RS_Ucs* RS_DbStorage::queryUcs(const std::string& ucsName) {
 
 
 
+/**
+ * Instantiates all objects with the given IDs that exist and are not
+ * undone and appends them to \c result. The objects are grouped by 
+ * object type and each group is loaded with one batch query, which is 
+ * much faster than calling \ref queryObject for every object.
+ * Objects in the object cache are copied from the cache.
+ * The order of the result is undefined. The caller is responsible for 
+ * deleting the instances.
+ */
+void RS_DbStorage::queryObjects(
+    std::set<RS_Object::Id>& objectIds, std::vector<RS_Object*>& result) {
+    RS_DbsOperationTimer timer(statistics, "queryObjects");
+
+    if (objectIds.empty()) {
+        return;
+    }
+
+    // group object IDs by object type:
+    std::map<RS_Object::ObjectTypeId, std::set<RS_Object::Id> > objectIdsByType;
+
+    std::set<RS_Object::Id>::iterator idIt;
+    for (idIt=objectIds.begin(); idIt!=objectIds.end(); ++idIt) {
+        if (getObjectDirectory().isUndone(*idIt)) {
+            continue;
+        }
+
+        RS_Object::ObjectTypeId objectTypeId = getObjectDirectory().getObjectTypeId(*idIt);
+
+        // copy objects from the cache if possible:
+        if (objectCache.isEnabled()) {
+            RS_Object* cachedObject = objectCache.get(*idIt);
+            RS_DbsObjectType* dbsObjectType = RS_DbsObjectTypeRegistry::getDbObject(objectTypeId);
+            if (cachedObject!=NULL && dbsObjectType!=NULL) {
+                RS_Object* object = dbsObjectType->cloneObject(*cachedObject);
+                updateSelectionStatus(object);
+                result.push_back(object);
+                continue;
+            }
+        }
+
+        objectIdsByType[objectTypeId].insert(*idIt);
+    }
+
+    std::map<RS_Object::ObjectTypeId, std::set<RS_Object::Id> >::iterator it;
+    for (it=objectIdsByType.begin(); it!=objectIdsByType.end(); ++it) {
+        RS_DbsObjectType* dbsObjectType = RS_DbsObjectTypeRegistry::getDbObject(it->first);
+        if (dbsObjectType==NULL) {
+            RS_Debug::error("RS_DbStorage::queryObjects: "
+                "no DB object registered for object type %d", it->first);
+            continue;
+        }
+
+        size_t first = result.size();
+        dbsObjectType->loadObjects(db, it->second, result);
+
+        for (size_t i=first; i<result.size(); ++i) {
+            if (objectCache.isEnabled()) {
+                objectCache.insert(dbsObjectType->cloneObject(*result[i]));
+            }
+            updateSelectionStatus(result[i]);
+        }
+    }
+}
+
+
+
+/**
+ * Instantiates all entities with the given IDs that exist and are not
+ * undone. Objects that are not entities are ignored.
+ *
+ * \see queryObjects
+ */
+void RS_DbStorage::queryEntities(
+    std::set<RS_Entity::Id>& entityIds, std::vector<RS_Entity*>& result) {
+    RS_DbsOperationTimer timer(statistics, "queryEntities");
+
+    std::vector<RS_Object*> objects;
+    queryObjects(entityIds, objects);
+
+    std::vector<RS_Object*>::iterator it;
+    for (it=objects.begin(); it!=objects.end(); ++it) {
+        RS_Entity* entity = dynamic_cast<RS_Entity*>(*it);
+        if (entity==NULL) {
+            delete *it;
+            continue;
+        }
+        result.push_back(entity);
+    }
+}
+
+
+
+/**
+ * Deselects all entities. The selection is kept in memory, see 
+ * \ref saveSelection.
+ */
 void RS_DbStorage::clearEntitySelection(std::set<RS_Entity::Id>* affectedObjects) {
-    RS_DbsEntityType::clearEntitySelection(db, affectedObjects);
+    RS_DbsOperationTimer timer(statistics, "clearEntitySelection");
+    selection.clear(affectedObjects);
 }
 
 
@@ -169,8 +536,9 @@ void RS_DbStorage::clearEntitySelection(std::set<RS_Entity::Id>* affectedObjects
 void RS_DbStorage::selectEntity(
     RS_Entity::Id entityId, bool add, 
     std::set<RS_Entity::Id>* affectedObjects) {
+    RS_DbsOperationTimer timer(statistics, "selectEntity");
 
-    RS_DbsEntityType::selectEntity(db, entityId, add, affectedObjects);
+    selection.select(entityId, add, affectedObjects);
 }
 
 
@@ -179,19 +547,130 @@ void RS_DbStorage::selectEntities(
     std::set<RS_Entity::Id>& entityIds, 
     bool add, 
     std::set<RS_Entity::Id>* affectedObjects) {
+    RS_DbsOperationTimer timer(statistics, "selectEntities");
     
-    RS_DbsEntityType::selectEntities(db, entityIds, add, affectedObjects);
+    selection.select(entityIds, add, affectedObjects);
+}
+
+
+
+void RS_DbStorage::selectEntities(
+    const RS_DbsIdSet& entityIds, 
+    bool add, 
+    RS_DbsIdSet* affectedObjects) {
+    RS_DbsOperationTimer timer(statistics, "selectEntities");
+    
+    selection.select(entityIds, add, affectedObjects);
+}
+
+
+
+/**
+ * Writes the selection status of all entities that have changed their
+ * selection status to the DB. This is done automatically when the
+ * storage is closed.
+ */
+void RS_DbStorage::saveSelection() {
+    selection.save(db);
+}
+
+
+
+/**
+ * Sets the selection status of the given loaded object if it is an 
+ * entity. The selection status stored in the DB may be outdated.
+ */
+void RS_DbStorage::updateSelectionStatus(RS_Object* object) {
+    RS_Entity* entity = dynamic_cast<RS_Entity*>(object);
+    if (entity!=NULL) {
+        entity->setSelected(selection.isSelected(entity->getId()));
+    }
 }
 
 
 
+/**
+ * Sets the maximum number of loaded objects that are kept in memory
+ * to speed up repeated queries of the same objects. A capacity of 0 
+ * (the default) disables the cache.
+ */
+void RS_DbStorage::setObjectCacheCapacity(int capacity) {
+    objectCache.setCapacity(capacity);
+}
+
+
+
+/**
+ * \return Bounding box of all entities that are not undone. The box
+ *      is maintained incrementally and only recomputed from the DB 
+ *      after an entity on its boundary was deleted, undone or moved.
+ */
 RS_Box RS_DbStorage::getBoundingBox() {
-    return RS_DbsEntityType::getBoundingBox(db);
+    RS_DbsOperationTimer timer(statistics, "getBoundingBox");
+    if (!boundingBoxValid) {
+        boundingBoxEmpty = !RS_DbsEntityType::getBoundingBox(
+            db, boundingBoxMin, boundingBoxMax
+        );
+        boundingBoxValid = true;
+    }
+
+    if (boundingBoxEmpty) {
+        return RS_Box(RS_Vector(), RS_Vector());
+    }
+
+    return RS_Box(boundingBoxMin, boundingBoxMax);
+}
+
+
+
+/**
+ * Extends the document bounding box by the given entity bounding box.
+ * Called whenever an entity is added or restored.
+ */
+void RS_DbStorage::growBoundingBox(const RS_Vector& minV, const RS_Vector& maxV) {
+    if (!boundingBoxValid) {
+        return;
+    }
+
+    if (boundingBoxEmpty) {
+        boundingBoxMin = minV;
+        boundingBoxMax = maxV;
+        boundingBoxEmpty = false;
+        return;
+    }
+
+    boundingBoxMin.x = std::min(boundingBoxMin.x, minV.x);
+    boundingBoxMin.y = std::min(boundingBoxMin.y, minV.y);
+    boundingBoxMin.z = std::min(boundingBoxMin.z, minV.z);
+    boundingBoxMax.x = std::max(boundingBoxMax.x, maxV.x);
+    boundingBoxMax.y = std::max(boundingBoxMax.y, maxV.y);
+    boundingBoxMax.z = std::max(boundingBoxMax.z, maxV.z);
+}
+
+
+
+/**
+ * Called whenever an entity with the given bounding box is removed,
+ * undone or moved away. The document bounding box is only invalidated 
+ * if the entity touched its boundary.
+ */
+void RS_DbStorage::shrinkBoundingBox(const RS_Vector& minV, const RS_Vector& maxV) {
+    if (!boundingBoxValid || boundingBoxEmpty) {
+        return;
+    }
+
+    if (minV.x<=boundingBoxMin.x || minV.y<=boundingBoxMin.y || 
+        minV.z<=boundingBoxMin.z || maxV.x>=boundingBoxMax.x || 
+        maxV.y>=boundingBoxMax.y || maxV.z>=boundingBoxMax.z) {
+
+        boundingBoxValid = false;
+    }
 }
 
 
 
 void RS_DbStorage::saveObject(RS_Object& object) {
+    RS_DbsOperationTimer timer(statistics, "saveObject");
     bool isNew = (object.getId()==-1);
 
     // look up storage object for this object type in the object type registry:
@@ -206,13 +685,149 @@ void RS_DbStorage::saveObject(RS_Object& object) {
         return;
     }
 
+    // only entities that are not undone contribute to the bounding box:
+    bool isVisible = isNew;
+    if (!isNew) {
+        RS_Vector minV;
+        RS_Vector maxV;
+        isVisible = RS_DbsEntityType::getBoundingBox(db, object.getId(), minV, maxV);
+        if (isVisible) {
+            shrinkBoundingBox(minV, maxV);
+        }
+    }
+
     dbObjectType->saveObject(db, object, isNew);
+
+    if (isNew) {
+        getObjectDirectory().insert(object.getId(), object.getObjectTypeId());
+    }
+    else {
+        objectCache.invalidate(object.getId());
+    }
+
+    RS_Entity* entity = dynamic_cast<RS_Entity*>(&object);
+    if (entity!=NULL) {
+        selection.update(entity->getId(), entity->isSelected());
+    }
+    if (isVisible && entity!=NULL) {
+        RS_Vector minV;
+        RS_Vector maxV;
+        RS_DbsEntityType::getCorners(entity->getBoundingBox(), minV, maxV);
+        growBoundingBox(minV, maxV);
+    }
 }
 
 
 
+/**
+ * Saves the given objects in one batch. This is much faster than calling
+ * \ref saveObject for every object and should be used for imports.
+ * 
+ * New objects get consecutive IDs assigned up front and are stored
+ * with one bulk insert per object type. The spatial index is updated 
+ * at the end of the batch. Objects that already have an ID are updated 
+ * as usual. New objects that cannot be stored by the DB object type 
+ * of their type ID are skipped with an error and keep ID -1. The whole
+ * batch is atomic: if it fails, the DB is left unchanged, the new 
+ * objects get their IDs reset and the exception is rethrown.
+ */
+void RS_DbStorage::saveObjects(std::vector<RS_Object*>& objects) {
+    RS_DbsOperationTimer timer(statistics, "saveObjects");
+    db.executeNonQuery("SAVEPOINT saveObjects;");
+
+    // new objects, grouped by object type:
+    std::map<RS_Object::ObjectTypeId, std::vector<RS_Object*> > newObjects;
+    std::vector<RS_Object*>::iterator it;
+
+    RS_Object::Id firstId = RS_DbsObjectType::getMaxObjectId(db) + 1;
+    RS_Object::Id nextId = firstId;
+
+    try {
+        for (it=objects.begin(); it!=objects.end(); ++it) {
+            RS_Object* object = *it;
+            if (object->getId()!=-1) {
+                saveObject(*object);
+                continue;
+            }
+
+            if (RS_DbsObjectTypeRegistry::getDbObject(object->getObjectTypeId())==NULL) {
+                RS_Debug::error("RS_DbStorage::saveObjects: "
+                    "no DB storage object registered for object type %d", 
+                    object->getObjectTypeId());
+                continue;
+            }
+
+            object->setId(nextId++);
+            newObjects[object->getObjectTypeId()].push_back(object);
+        }
+
+        std::map<RS_Object::ObjectTypeId, std::vector<RS_Object*> >::iterator typeIt;
+        for (typeIt=newObjects.begin(); typeIt!=newObjects.end(); ++typeIt) {
+            RS_DbsObjectType* dbObjectType = 
+                RS_DbsObjectTypeRegistry::getDbObject(typeIt->first);
+            dbObjectType->saveObjects(db, typeIt->second);
+        }
+
+        if (nextId>firstId) {
+            RS_DbsEntityType::indexEntities(db, firstId, nextId-1);
+        }
+
+        db.executeNonQuery("RELEASE saveObjects;");
+    }
+    catch (...) {
+        // any exception, not only DB exceptions, must release the
+        // savepoint:
+        RS_Debug::error("RS_DbStorage::saveObjects: failed, rolling back");
+
+        db.executeNonQuery("ROLLBACK TO saveObjects;");
+        db.executeNonQuery("RELEASE saveObjects;");
+        invalidateUndoLog();
+
+        std::map<RS_Object::ObjectTypeId, std::vector<RS_Object*> >::iterator typeIt;
+        for (typeIt=newObjects.begin(); typeIt!=newObjects.end(); ++typeIt) {
+            for (it=typeIt->second.begin(); it!=typeIt->second.end(); ++it) {
+                (*it)->setId(-1);
+            }
+        }
+        boundingBoxValid = false;
+        throw;
+    }
+
+    // register new objects and grow document bounding box by all new 
+    // entities:
+    std::map<RS_Object::ObjectTypeId, std::vector<RS_Object*> >::iterator typeIt;
+    for (typeIt=newObjects.begin(); typeIt!=newObjects.end(); ++typeIt) {
+        for (it=typeIt->second.begin(); it!=typeIt->second.end(); ++it) {
+            // rejected by the DB object type:
+            if ((*it)->getId()==-1) {
+                continue;
+            }
+
+            getObjectDirectory().insert((*it)->getId(), typeIt->first);
+
+            RS_Entity* entity = dynamic_cast<RS_Entity*>(*it);
+            if (entity!=NULL) {
+                if (entity->isSelected()) {
+                    selection.update(entity->getId(), true);
+                }
+                RS_Vector minV;
+                RS_Vector maxV;
+                RS_DbsEntityType::getCorners(entity->getBoundingBox(), minV, maxV);
+                growBoundingBox(minV, maxV);
+            }
+        }
+    }
+}
+
+
+
+/**
+ * Deletes the given object permanently. Objects that are undone
+ * can also be deleted.
+ */
 void RS_DbStorage::deleteObject(RS_Object::Id objectId) {
-    RS_Object::ObjectTypeId objectTypeId = getObjectTypeId(objectId);
+    RS_DbsOperationTimer timer(statistics, "deleteObject");
+    RS_Object::ObjectTypeId objectTypeId = getObjectDirectory().getObjectTypeId(objectId);
     RS_DbsObjectType* dbsObjectType = RS_DbsObjectTypeRegistry::getDbObject(objectTypeId);
     if (dbsObjectType==NULL) {
         RS_Debug::error("RS_DbStorage::deleteObject: "
@@ -220,26 +835,94 @@ void RS_DbStorage::deleteObject(RS_Object::Id objectId) {
         return;
     }
 
+    RS_Vector minV;
+    RS_Vector maxV;
+    if (RS_DbsEntityType::getBoundingBox(db, objectId, minV, maxV)) {
+        shrinkBoundingBox(minV, maxV);
+    }
+
     // delete record in entity specific table(s) (e.g. from table Line):
     dbsObjectType->deleteObject(db, objectId);
+
+    getObjectDirectory().remove(objectId);
+    objectCache.invalidate(objectId);
+    selection.remove(objectId);
+}
+
+
+
+/**
+ * Deletes all given objects permanently. Objects that are undone can
+ * also be deleted. The objects are grouped by type and deleted with
+ * set based statements (see RS_DbsObjectType::deleteObjects).
+ */
+void RS_DbStorage::deleteObjects(std::set<RS_Object::Id>& objectIds) {
+    RS_DbsOperationTimer timer(statistics, "deleteObjects");
+    if (objectIds.empty()) {
+        return;
+    }
+
+    // group objects by type:
+    std::map<RS_Object::ObjectTypeId, std::set<RS_Object::Id> > objectsByType;
+    std::set<RS_Object::Id>::iterator it;
+    for (it=objectIds.begin(); it!=objectIds.end(); ++it) {
+        RS_Object::ObjectTypeId objectTypeId = getObjectDirectory().getObjectTypeId(*it);
+        objectsByType[objectTypeId].insert(*it);
+    }
+
+    // live entities that are deleted might shrink the bounding box:
+    RS_DbsIdTable::fill(db, "DeleteIds", objectIds);
+    std::map<RS_Entity::Id, RS_Box> boxes;
+    RS_DbsEntityType::getBoundingBoxes(db, "DeleteIds", boxes);
+    std::map<RS_Entity::Id, RS_Box>::iterator boxIt;
+    for (boxIt=boxes.begin(); boxIt!=boxes.end(); ++boxIt) {
+        if (!getObjectDirectory().isUndone(boxIt->first)) {
+            shrinkBoundingBox(
+                boxIt->second.getDefiningCorner1(), 
+                boxIt->second.getDefiningCorner2()
+            );
+        }
+    }
+
+    std::map<RS_Object::ObjectTypeId, std::set<RS_Object::Id> >::iterator typeIt;
+    for (typeIt=objectsByType.begin(); typeIt!=objectsByType.end(); ++typeIt) {
+        RS_DbsObjectType* dbsObjectType = 
+            RS_DbsObjectTypeRegistry::getDbObject(typeIt->first);
+        if (dbsObjectType==NULL) {
+            RS_Debug::error("RS_DbStorage::deleteObjects: "
+                "no DB Object registered for object type %d", typeIt->first);
+            continue;
+        }
+
+        dbsObjectType->deleteObjects(db, typeIt->second);
+
+        for (it=typeIt->second.begin(); it!=typeIt->second.end(); ++it) {
+            getObjectDirectory().remove(*it);
+            objectCache.invalidate(*it);
+            selection.remove(*it);
+        }
+    }
 }
 
 
 
 void RS_DbStorage::beginTransaction() {
+    RS_DbsOperationTimer timer(statistics, "beginTransaction");
     db.startTransaction();
 }
 
 
 
 void RS_DbStorage::commitTransaction() {
+    RS_DbsOperationTimer timer(statistics, "commitTransaction");
     db.endTransaction();
 }
 
 
 
 int RS_DbStorage::getLastTransactionId() {
-    RS_DbCommand cmd(
+    RS_DbsOperationTimer timer(statistics, "getLastTransactionId");
+    RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
         db, 
         "SELECT value "
         "FROM Variables "
@@ -251,8 +934,28 @@ int RS_DbStorage::getLastTransactionId() {
 
 
 
+/**
+ * Sets the ID of the last transaction that has been applied. Undo and
+ * redo move it by one.
+ *
+ * Transactions dropped from the undo log (see \ref compactUndoLog)
+ * cannot be undone. An ID before the oldest transaction in the log is
+ * clamped to the ID before that transaction. If the log is empty, the
+ * ID cannot be moved back. Both cases are logged as an error.
+ */
 void RS_DbStorage::setLastTransactionId(int cid) {
-    RS_DbCommand cmd(
+    RS_DbsOperationTimer timer(statistics, "setLastTransactionId");
+
+    int minId = getMinTransactionId();
+    int floor = (minId==-1 ? getLastTransactionId() : minId - 1);
+    if (cid<floor) {
+        RS_Debug::error("RS_DbStorage::setLastTransactionId: "
+            "transaction %d has been dropped from the undo log, "
+            "last transaction is %d", cid + 1, floor);
+        cid = floor;
+    }
+
+    RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
         db, 
         "UPDATE Variables "
         "SET value=? "
@@ -265,6 +968,7 @@ void RS_DbStorage::setLastTransactionId(int cid) {
 
 
 void RS_DbStorage::saveTransaction(RS_Transaction& transaction) {
+    RS_DbsOperationTimer timer(statistics, "saveTransaction");
     // if the given transaction is not undoable, we don't need to
     // store anything here:
     if (!transaction.isUndoable()) {
@@ -277,108 +981,82 @@ void RS_DbStorage::saveTransaction(RS_Transaction& transaction) {
     // delete transactions that are lost for good due to this transaction:
     deleteTransactionsFrom(transaction.getId());
     
+    long long size = transaction.getText().size();
+
+    // store the set of entities that are affected by the transaction
+    // with one statement:
+    std::set<RS_Object::Id> affectedObjects = transaction.getAffectedObjects();
+    RS_DbsIdTable::fill(db, "AffectedIds", affectedObjects);
+
+    RS_DbsStatement& cmd2 = RS_DbsStatementCache::prepare(
+        db, 
+        "INSERT INTO AffectedObjects "
+        "SELECT ?, id FROM temp.AffectedIds"
+    );
+    cmd2.bind(1, transaction.getId());
+    cmd2.executeNonQuery();
+
+    // store the property changes for all affected objects as one 
+    // binary record:
+    std::multimap<RS_Object::Id, RS_PropertyChange> propertyChanges = transaction.getPropertyChanges();
+    if (!propertyChanges.empty()) {
+        std::string data = RS_DbsPropertyChangeCodec::encode(
+            propertyChanges, undoLogCompression
+        );
+        RS_DbsStatement& cmd3 = RS_DbsStatementCache::prepare(
+            db, 
+            "INSERT INTO PropertyChangeLog VALUES(?,?)"
+        );
+        cmd3.bind(1, transaction.getId());
+        cmd3.bindBlob(2, data.data(), (int)data.size());
+        cmd3.executeNonQuery();
+        size += data.size();
+    }
+
+    // one row per affected object in AffectedObjects and its index:
+    size += (long long)affectedObjects.size() * bytesPerAffectedObject;
+
     // store the transaction in the transaction log:
-    RS_DbCommand cmd(
+    RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
         db, 
-        "INSERT INTO Transaction2 VALUES(?,?,?)"
+        "INSERT INTO Transaction2 VALUES(?,?,?,?)"
     );
     cmd.bind(1, transaction.getId());
     cmd.bind(2);
     cmd.bind(3, transaction.getText());
+    cmd.bind(4, size);
     cmd.executeNonQuery();
-    
-    RS_Debug::debug("RS_DbStorage::saveTransaction: store transaction: OK");
-
-    // store the set of entities that are affected by the transaction:
-    std::set<RS_Object::Id> affectedObjects = transaction.getAffectedObjects();
-    std::set<RS_Object::Id>::iterator it;
-    for (it=affectedObjects.begin(); it!=affectedObjects.end(); ++it) {
-        RS_Debug::debug("RS_DbStorage::saveTransaction: "
-            "INSERT INTO AffectedObjects VALUES(%d,%d)", transaction.getId(), *it);
 
-        RS_DbCommand cmd(
-            db, 
-            "INSERT INTO AffectedObjects VALUES(?,?)"
-        );
-        cmd.bind(1, transaction.getId());
-        cmd.bind(2, *it);
-        cmd.executeNonQuery();
-        
-        RS_Debug::debug("RS_DbStorage::saveTransaction: INSERT: OK");
+    if (undoLogSize!=-1) {
+        undoLogSize += size;
     }
-
-    // store the property changes for all affected objects:
-    std::multimap<RS_Object::Id, RS_PropertyChange> propertyChanges = transaction.getPropertyChanges();
-    std::multimap<RS_Object::Id, RS_PropertyChange>::iterator it2;
-    for (it2=propertyChanges.begin(); it2!=propertyChanges.end(); ++it2) {
-        RS_Debug::debug("RS_DbStorage::saveTransaction: "
-            "INSERT INTO PropertyChanges VALUES("
-        );
-        RS_Debug::debug("RS_DbStorage::saveTransaction: transaction ID: "
-            "%d",
-            transaction.getId()
-        );
-        RS_Debug::debug("RS_DbStorage::saveTransaction: object ID from map: "
-            "%d",
-            (*it2).first
-        );
-        RS_Debug::debug("RS_DbStorage::saveTransaction: property ID: "
-            "%d",
-            (*it2).second.propertyTypeId
-        );
-        RS_Debug::debug("RS_DbStorage::saveTransaction: data type: "
-            "%d",
-            (int)((*it2).second.oldValue.getDataType())
-        );
-        RS_Debug::debug("RS_DbStorage::saveTransaction: old value: "
-            "%s",
-            (*it2).second.oldValue.getString().c_str()
-        );
-        RS_Debug::debug("RS_DbStorage::saveTransaction: new value: "
-            "%s)",
-            (*it2).second.newValue.getString().c_str()
-        );
-
-        RS_DbCommand cmd(
-            db, 
-            "INSERT INTO PropertyChanges VALUES(?,?,?,?,?,?)"
-        );
-        cmd.bind(1, transaction.getId());
-        cmd.bind(2, (*it2).first);
-        cmd.bind(3, (*it2).second.propertyTypeId);
-        cmd.bind(4, (int)((*it2).second.oldValue.getDataType()));
-        // TODO: refactor into RS_PropertyValue::bind (?)
-        switch ((*it2).second.oldValue.getDataType()) {
-        case RS_PropertyValue::Boolean:
-            cmd.bind(5, (*it2).second.oldValue.getBool());
-            cmd.bind(6, (*it2).second.newValue.getBool());
-            break;
-        case RS_PropertyValue::Integer:
-            cmd.bind(5, (*it2).second.oldValue.getInt());
-            cmd.bind(6, (*it2).second.newValue.getInt());
-            break;
-        case RS_PropertyValue::Double:
-            cmd.bind(5, (*it2).second.oldValue.getDouble());
-            cmd.bind(6, (*it2).second.newValue.getDouble());
-            break;
-        case RS_PropertyValue::String:
-            cmd.bind(5, (*it2).second.oldValue.getString());
-            cmd.bind(6, (*it2).second.newValue.getString());
-            break;
-        default:
-            break;
-        }
-        cmd.executeNonQuery();
+    if (undoSteps!=-1) {
+        undoSteps++;
     }
+
+    RS_Debug::debug("RS_DbStorage::saveTransaction: transaction %d: "
+        "%d affected objects, %d property changes", 
+        transaction.getId(), (int)affectedObjects.size(), 
+        (int)propertyChanges.size());
     
     setLastTransactionId(transaction.getId());
+
+    // drop the oldest transactions if the undo budget is exceeded by 
+    // more than the slack. The slack makes sure that compaction only
+    // runs every few transactions:
+    if ((maxUndoSteps>0 && getUndoSteps() > maxUndoSteps + maxUndoSteps/8) ||
+        (maxUndoBytes>0 && getUndoLogSize() > maxUndoBytes + maxUndoBytes/8)) {
+
+        compactUndoLog();
+    }
 }
 
 
 
 RS_Transaction RS_DbStorage::getTransaction(int transactionId) {
+    RS_DbsOperationTimer timer(statistics, "getTransaction");
     // look up command:
-    RS_DbCommand cmd1(
+    RS_DbsStatement& cmd1 = RS_DbsStatementCache::prepare(
         db, 
         "SELECT text "
         "FROM Transaction2 "
@@ -395,7 +1073,7 @@ RS_Transaction RS_DbStorage::getTransaction(int transactionId) {
     }
 
     // look up set of affected objects:
-    RS_DbCommand cmd2(
+    RS_DbsStatement& cmd2 = RS_DbsStatementCache::prepare(
         db, 
         "SELECT oid "
         "FROM AffectedObjects "
@@ -405,51 +1083,28 @@ RS_Transaction RS_DbStorage::getTransaction(int transactionId) {
 
     std::set<RS_Object::Id> affectedObjects;
 
-    RS_DbReader reader = cmd2.executeReader();
+    RS_DbsReader reader = cmd2.executeReader();
     while (reader.read()) {
         affectedObjects.insert(reader.getInt64(0));
-        RS_Debug::debug("RS_DbStorage::getTransaction: "
-            "affected entity: %d", reader.getInt64(0));
     }
 
     std::multimap<RS_Object::Id, RS_PropertyChange> propertyChanges;
     
     // load property changes:
-    RS_DbCommand cmd3(
+    RS_DbsStatement& cmd3 = RS_DbsStatementCache::prepare(
         db, 
-        "SELECT oid, pid, dataType, oldValue, newValue "
-        "FROM PropertyChanges "
+        "SELECT data "
+        "FROM PropertyChangeLog "
         "WHERE tid=?"
     );
     cmd3.bind(1, transactionId);
 
     reader = cmd3.executeReader();
-    while (reader.read()) {
-        RS_PropertyChange pc;
-        pc.propertyTypeId = reader.getInt64(1);
-        switch((RS_PropertyValue::DataType)reader.getInt64(2)) {
-        case RS_PropertyValue::Boolean:
-            pc.oldValue = RS_PropertyValue((bool)reader.getInt(3));
-            pc.newValue = RS_PropertyValue((bool)reader.getInt(4));
-            break;
-        case RS_PropertyValue::Integer:
-            pc.oldValue = RS_PropertyValue(reader.getInt(3));
-            pc.newValue = RS_PropertyValue(reader.getInt(4));
-            break;
-        case RS_PropertyValue::Double:
-            pc.oldValue = RS_PropertyValue(reader.getDouble(3));
-            pc.newValue = RS_PropertyValue(reader.getDouble(4));
-            break;
-        case RS_PropertyValue::String:
-            pc.oldValue = RS_PropertyValue(reader.getString(3));
-            pc.newValue = RS_PropertyValue(reader.getString(4));
-            break;
-        default:
+    if (reader.read()) {
+        if (!RS_DbsPropertyChangeCodec::decode(reader.getBlob(0), propertyChanges)) {
             RS_Debug::error("RS_DbStorage::getTransaction: "
-                "unknown property value type");
-            break;
+                "cannot decode property changes of transaction %d", transactionId);
         }
-        propertyChanges.insert(std::pair<RS_Object::Id, RS_PropertyChange>(reader.getInt64(0), pc));
     }
 
     return RS_Transaction(
@@ -463,45 +1118,46 @@ RS_Transaction RS_DbStorage::getTransaction(int transactionId) {
     
     
     
+/**
+ * Deletes all transactions with an ID of \c transactionId or higher
+ * (the redo branch). Objects that are only referenced by deleted 
+ * transactions are orphaned and deleted permanently.
+ */
 void RS_DbStorage::deleteTransactionsFrom(int transactionId) {
+    RS_DbsOperationTimer timer(statistics, "deleteTransactionsFrom");
     RS_Debug::debug("RS_DbStorage::deleteTransactionsFrom: transactionId: %d", transactionId);
 
-    // delete orphaned objects:
-    RS_DbCommand cmd3(
+    // find orphaned objects (objects not referenced by any transaction
+    // we are keeping) with one anti-join. No DISTINCT, SQLite would 
+    // scan the whole oid index to get the IDs in order:
+    RS_DbsStatement& cmd3 = RS_DbsStatementCache::prepare(
         db, 
-        "SELECT oid "
-        "FROM AffectedObjects "
-        "WHERE tid>=?"
+        "SELECT a.oid "
+        "FROM AffectedObjects a "
+        "WHERE a.tid>=?1 "
+        "AND NOT EXISTS ("
+            "SELECT 1 "
+            "FROM AffectedObjects b "
+            "WHERE b.oid=a.oid AND b.tid<?1"
+        ")"
     );
     cmd3.bind(1, transactionId);
-    RS_DbReader reader = cmd3.executeReader();
+    std::set<RS_Object::Id> orphans;
+    RS_DbsReader reader = cmd3.executeReader();
     while (reader.read()) {
-        int oid = reader.getInt64(0);
-        RS_Debug::debug("RS_DbStorage::deleteTransactionsFrom: "
-            "check for previous transactions with object %d", oid);
-
-        // check if there are transactions we are keeping which still refer to the
-        // entity in question:
-        RS_DbCommand cmd4(
-            db, 
-            "SELECT oid "
-            "FROM AffectedObjects "
-            "WHERE tid<? AND oid=?"
-        );
-        cmd4.bind(1, transactionId);
-        cmd4.bind(2, oid);
-        RS_DbReader reader4 = cmd4.executeReader();
-        if (reader4.read()==false) {
-            RS_Debug::debug("RS_DbStorage::deleteTransactionsFrom: deleteObject: %d", oid);
-            deleteObject(oid);
-        }
+        orphans.insert(reader.getInt64(0));
     }
+    
+    RS_Debug::debug("RS_DbStorage::deleteTransactionsFrom: "
+        "delete %d orphaned objects", (int)orphans.size());
+
+    deleteObjects(orphans);
         
     RS_Debug::debug("RS_DbStorage::deleteTransactionsFrom: "
         "delete records of affected objects");
 
     // delete records of affected objects for the transactions:
-    RS_DbCommand cmd(
+    RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
         db, 
         "DELETE FROM AffectedObjects "
         "WHERE tid>=?"
@@ -513,9 +1169,9 @@ void RS_DbStorage::deleteTransactionsFrom(int transactionId) {
         "delete property changes of transactions");
 
     // delete property changes for transactions:
-    RS_DbCommand cmd5(
+    RS_DbsStatement& cmd5 = RS_DbsStatementCache::prepare(
         db, 
-        "DELETE FROM PropertyChanges "
+        "DELETE FROM PropertyChangeLog "
         "WHERE tid>=?"
     );
     cmd5.bind(1, transactionId);
@@ -523,45 +1179,435 @@ void RS_DbStorage::deleteTransactionsFrom(int transactionId) {
 
     RS_Debug::debug("RS_DbStorage::deleteTransactionsFrom: "
         "delete transaction");
+
+    subtractFromUndoLog(transactionId, false);
     
     // delete transaction:
-    RS_DbCommand cmd2(
+    RS_DbsStatement& cmd2 = RS_DbsStatementCache::prepare(
         db, 
         "DELETE FROM Transaction2 "
         "WHERE id>=?"
     );
     cmd2.bind(1, transactionId);
-    cmd2.executeNonQuery();
+    try {
+        cmd2.executeNonQuery();
+    }
+    catch (...) {
+        invalidateUndoLog();
+        throw;
+    }
     
     RS_Debug::debug("RS_DbStorage::deleteTransactionsFrom: OK");
 }
 
 
 
+/**
+ * \return ID of the newest transaction in the undo log or 0 if the
+ *      log is empty.
+ */
 int RS_DbStorage::getMaxTransactionId() {
-    RS_DbCommand cmd(
+    RS_DbsOperationTimer timer(statistics, "getMaxTransactionId");
+    RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
         db, 
         "SELECT max(id) "
         "FROM Transaction2"
     );
     return cmd.executeInt();
 }
+
+
+
+/**
+ * \return ID of the oldest transaction that is still in the undo log or
+ *      -1 if the log is empty. Transactions with lower IDs have been 
+ *      dropped due to the undo budget and cannot be undone anymore.
+ */
+int RS_DbStorage::getMinTransactionId() {
+    RS_DbsOperationTimer timer(statistics, "getMinTransactionId");
+    RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
+        db, 
+        "SELECT IFNULL(MIN(id), -1) "
+        "FROM Transaction2"
+    );
+    return cmd.executeInt();
+}
+
+
+
+/**
+ * Changes the SQLite settings of this storage, for example to switch
+ * from the bulk import preset to the interactive preset after an 
+ * import. The page size cannot be changed anymore at this point and
+ * the number of reader connections is fixed when the document is
+ * opened. Must not be called inside a transaction.
+ */
+void RS_DbStorage::setOptions(const RS_DbStorageOptions& options) {
+    this->options = options;
+    this->options.readerConnections = (readerPool==NULL ? 0 : readerPool->getSize());
+    if (readerPool!=NULL) {
+        // readers would block the writer in any other mode:
+        this->options.journalMode = RS_DbStorageOptions::JournalWal;
+    }
+    if (this->options.apply(db)!=RS_DbStorageOptions::JournalWal && 
+        readerPool!=NULL) {
+        RS_Debug::error("RS_DbStorage::setOptions: "
+            "document left WAL mode, readers block the writer");
+    }
+}
+
+
+
+/**
+ * Starts writing a copy of the document to the given file on a worker
+ * thread (see RS_DbsSnapshot). The document can be edited while the 
+ * snapshot is running. A snapshot that is still running from an 
+ * earlier call is cancelled. The selection is saved first, so the 
+ * snapshot contains the current selection.
+ *
+ * \return The snapshot which can be used to query the progress, to 
+ *      cancel or to wait for the snapshot. The snapshot is owned by 
+ *      this storage and valid until the next call or until this storage
+ *      is deleted.
+ */
+RS_DbsSnapshot* RS_DbStorage::snapshotTo(
+    const std::string& fileName, RS_DbsSnapshotListener* listener) {
+
+    delete snapshot;
+
+    // a snapshot without the selection is still useful:
+    try {
+        saveSelection();
+    }
+    catch (...) {
+        RS_Debug::error("RS_DbStorage::snapshotTo: "
+            "cannot save the selection");
+    }
+
+    snapshot = new RS_DbsSnapshot(handle, fileName, listener);
+    snapshot->start();
+    return snapshot;
+}
+
+
+
+/**
+ * Sets the undo budget. If the undo log grows beyond the budget, the 
+ * oldest transactions are dropped (see \ref compactUndoLog).
+ *
+ * \param maxSteps Maximum number of transactions or 0 for no limit.
+ * \param maxBytes Maximum size of the undo log in bytes or 0 for no 
+ *      limit.
+ */
+void RS_DbStorage::setUndoBudget(int maxSteps, long long maxBytes) {
+    maxUndoSteps = maxSteps;
+    maxUndoBytes = maxBytes;
+}
+
+
+
+/**
+ * \return Approximate size of the undo log in bytes. This is the size of
+ *      the property change records plus a fixed cost per affected 
+ *      object.
+ */
+long long RS_DbStorage::getUndoLogSize() {
+    RS_DbsOperationTimer timer(statistics, "getUndoLogSize");
+    if (undoLogSize==-1) {
+        RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
+            db, 
+            "SELECT IFNULL(SUM(size), 0) "
+            "FROM Transaction2"
+        );
+        RS_DbsReader reader = cmd.executeReader();
+        undoLogSize = reader.read() ? reader.getInt64(0) : 0;
+    }
+    return undoLogSize;
+}
+
+
+
+/**
+ * \return Number of transactions in the undo log, including 
+ *      transactions that can be redone.
+ */
+int RS_DbStorage::getUndoSteps() {
+    RS_DbsOperationTimer timer(statistics, "getUndoSteps");
+    if (undoSteps==-1) {
+        RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
+            db, 
+            "SELECT COUNT(*) "
+            "FROM Transaction2"
+        );
+        undoSteps = cmd.executeInt();
+    }
+    return undoSteps;
+}
+
+
+
+/**
+ * Makes the cached size and number of steps of the undo log to be read
+ * again on next use. Called whenever changes of the undo log may have
+ * been rolled back. SQLite does not call \ref onRollback when a 
+ * savepoint is rolled back (ROLLBACK TO) or when a single statement
+ * fails, so these paths call this directly.
+ */
+void RS_DbStorage::invalidateUndoLog() {
+    undoLogSize = -1;
+    undoSteps = -1;
+}
+
+
+
+/**
+ * Called by SQLite when a transaction of the connection is rolled back,
+ * explicitly or after an error (see \ref invalidateUndoLog).
+ *
+ * SQLite also calls this for some statements that run outside of a 
+ * transaction, for example on temporary ID tables. Such statements 
+ * cannot roll back changes of the undo log, so the cache is kept.
+ */
+void RS_DbStorage::onRollback(void* storage) {
+    RS_DbStorage* s = (RS_DbStorage*)storage;
+    if (sqlite3_get_autocommit(s->handle)) {
+        return;
+    }
+    s->invalidateUndoLog();
+}
+
+
+
+/**
+ * Subtracts the transactions that are about to be deleted from the 
+ * cached size and number of steps of the undo log, so the undo budget 
+ * can be checked after every transaction without reading the whole 
+ * transaction log.
+ *
+ * \param before True for the transactions with an ID lower than 
+ *      \c transactionId, false for the transactions with an ID of
+ *      \c transactionId or higher.
+ */
+void RS_DbStorage::subtractFromUndoLog(int transactionId, bool before) {
+    if (undoLogSize==-1 && undoSteps==-1) {
+        return;
+    }
+
+    RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
+        db, 
+        before ? 
+            "SELECT COUNT(*), IFNULL(SUM(size), 0) "
+            "FROM Transaction2 "
+            "WHERE id<?" :
+            "SELECT COUNT(*), IFNULL(SUM(size), 0) "
+            "FROM Transaction2 "
+            "WHERE id>=?"
+    );
+    cmd.bind(1, transactionId);
+    RS_DbsReader reader = cmd.executeReader();
+    if (!reader.read()) {
+        return;
+    }
+
+    if (undoSteps!=-1) {
+        undoSteps -= reader.getInt(0);
+    }
+    if (undoLogSize!=-1) {
+        undoLogSize -= reader.getInt64(1);
+    }
+}
+
+
+
+/**
+ * Drops the oldest transactions until the undo log fits into the undo 
+ * budget. Only transactions that have been applied (IDs up to 
+ * \ref getLastTransactionId) are dropped, the redo branch is never 
+ * touched. Objects that are undone and no longer referenced by any 
+ * remaining transaction are purged.
+ *
+ * This is called automatically by \ref saveTransaction when the budget
+ * is exceeded but may also be called by the application, e.g. when idle.
+ */
+void RS_DbStorage::compactUndoLog() {
+    RS_DbsOperationTimer timer(statistics, "compactUndoLog");
+    if (maxUndoSteps<=0 && maxUndoBytes<=0) {
+        return;
+    }
+
+    int lastTransactionId = getLastTransactionId();
+    int steps = getUndoSteps();
+    long long bytes = getUndoLogSize();
+
+    // find first transaction to keep:
+    int firstKept = -1;
+    RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
+        db, 
+        "SELECT id, size "
+        "FROM Transaction2 "
+        "WHERE id<=? "
+        "ORDER BY id"
+    );
+    cmd.bind(1, lastTransactionId);
+    RS_DbsReader reader = cmd.executeReader();
+    while (reader.read()) {
+        if ((maxUndoSteps<=0 || steps<=maxUndoSteps) &&
+            (maxUndoBytes<=0 || bytes<=maxUndoBytes)) {
+            break;
+        }
+        firstKept = reader.getInt64(0) + 1;
+        steps--;
+        bytes -= reader.getInt64(1);
+    }
+
+    if (firstKept!=-1) {
+        deleteTransactionsBefore(firstKept);
+    }
+}
+
+
+
+/**
+ * Deletes all transactions with an ID lower than \c transactionId. 
+ * Objects that are undone and not affected by any of the remaining
+ * transactions can never be restored and are deleted permanently.
+ */
+void RS_DbStorage::deleteTransactionsBefore(int transactionId) {
+    RS_DbsOperationTimer timer(statistics, "deleteTransactionsBefore");
+    RS_Debug::debug("RS_DbStorage::deleteTransactionsBefore: transactionId: %d", transactionId);
+
+    // find dead objects (no DISTINCT, see deleteTransactionsFrom):
+    RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
+        db, 
+        "SELECT a.oid "
+        "FROM AffectedObjects a, Object o "
+        "WHERE a.tid<?1 "
+        "AND o.id=a.oid "
+        "AND o.undoStatus=1 "
+        "AND NOT EXISTS ("
+            "SELECT 1 "
+            "FROM AffectedObjects b "
+            "WHERE b.oid=a.oid AND b.tid>=?1"
+        ")"
+    );
+    cmd.bind(1, transactionId);
+    std::set<RS_Object::Id> deadObjects;
+    RS_DbsReader reader = cmd.executeReader();
+    while (reader.read()) {
+        deadObjects.insert(reader.getInt64(0));
+    }
+
+    RS_DbsStatement& cmd2 = RS_DbsStatementCache::prepare(
+        db, 
+        "DELETE FROM AffectedObjects "
+        "WHERE tid<?"
+    );
+    cmd2.bind(1, transactionId);
+    cmd2.executeNonQuery();
+
+    RS_DbsStatement& cmd3 = RS_DbsStatementCache::prepare(
+        db, 
+        "DELETE FROM PropertyChangeLog "
+        "WHERE tid<?"
+    );
+    cmd3.bind(1, transactionId);
+    cmd3.executeNonQuery();
+
+    subtractFromUndoLog(transactionId, true);
+
+    RS_DbsStatement& cmd4 = RS_DbsStatementCache::prepare(
+        db, 
+        "DELETE FROM Transaction2 "
+        "WHERE id<?"
+    );
+    cmd4.bind(1, transactionId);
+    try {
+        cmd4.executeNonQuery();
+    }
+    catch (...) {
+        invalidateUndoLog();
+        throw;
+    }
+
+    RS_Debug::debug("RS_DbStorage::deleteTransactionsBefore: "
+        "purge %d dead objects", (int)deadObjects.size());
+
+    deleteObjects(deadObjects);
+}
     
     
     
+/**
+ * Toggles the undo status of all given objects with one set based 
+ * update. The document bounding box and all in-memory structures are
+ * updated in the same pass.
+ */
 void RS_DbStorage::toggleUndoStatus(std::set<RS_Object::Id>& objects) {
-    std::set<RS_Object::Id>::iterator it;
-    for (it=objects.begin(); it!=objects.end(); it++) {
-        RS_Debug::debug("RS_DbStorage::undo: toggle object: %d", *it);
+    toggleUndoStatus(RS_DbsIdSet(objects));
+}
+
+
+
+void RS_DbStorage::toggleUndoStatus(const RS_DbsIdSet& objects) {
+    RS_DbsOperationTimer timer(statistics, "toggleUndoStatus");
+    if (objects.isEmpty()) {
+        return;
+    }
+
+    RS_DbsIdTable::fill(db, "ToggleIds", objects.getIds());
+
+    // bounding boxes of all affected entities:
+    std::map<RS_Entity::Id, RS_Box> boxes;
+    RS_DbsEntityType::getBoundingBoxes(db, "ToggleIds", boxes);
+
+    RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
+        db, 
+        "UPDATE Object "
+        "SET undoStatus=NOT(undoStatus) "
+        "WHERE id IN (SELECT id FROM temp.ToggleIds)"
+    );
+    cmd.executeNonQuery();
+
+    // entities that are undone might shrink the bounding box:
+    std::map<RS_Entity::Id, RS_Box>::iterator boxIt;
+    for (boxIt=boxes.begin(); boxIt!=boxes.end(); ++boxIt) {
+        if (!getObjectDirectory().isUndone(boxIt->first)) {
+            shrinkBoundingBox(
+                boxIt->second.getDefiningCorner1(), 
+                boxIt->second.getDefiningCorner2()
+            );
+        }
+    }
 
-        toggleUndoStatus(*it);
+    // entities that are restored grow the bounding box:
+    for (boxIt=boxes.begin(); boxIt!=boxes.end(); ++boxIt) {
+        if (getObjectDirectory().isUndone(boxIt->first)) {
+            growBoundingBox(
+                boxIt->second.getDefiningCorner1(), 
+                boxIt->second.getDefiningCorner2()
+            );
+        }
+    }
+
+    RS_DbsIdSet::const_iterator it;
+    for (it=objects.begin(); it!=objects.end(); ++it) {
+        getObjectDirectory().toggleUndoStatus(*it);
+        objectCache.invalidate(*it);
     }
 }
 
 
 
 void RS_DbStorage::toggleUndoStatus(RS_Object::Id objectId) {
-    RS_DbCommand cmd(
+    RS_DbsOperationTimer timer(statistics, "toggleUndoStatus");
+    RS_Vector minV;
+    RS_Vector maxV;
+    if (RS_DbsEntityType::getBoundingBox(db, objectId, minV, maxV)) {
+        // entity is about to be undone:
+        shrinkBoundingBox(minV, maxV);
+    }
+
+    RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
         db, 
         "UPDATE Object "
         "SET undoStatus=NOT(undoStatus) "
@@ -569,44 +1615,42 @@ void RS_DbStorage::toggleUndoStatus(RS_Object::Id objectId) {
     );
     cmd.bind(1, objectId);
     cmd.executeNonQuery();
+
+    getObjectDirectory().toggleUndoStatus(objectId);
+    objectCache.invalidate(objectId);
+
+    if (RS_DbsEntityType::getBoundingBox(db, objectId, minV, maxV)) {
+        // entity was restored:
+        growBoundingBox(minV, maxV);
+    }
 }
 
 
 
+/**
+ * \return true if the given object is undone. Objects that do not 
+ *      exist are reported as undone, like in RS_MemoryStorage, so 
+ *      callers treat them as invisible. Before the object directory,
+ *      the lookup found no row for them and threw an RS_DbException.
+ */
 bool RS_DbStorage::getUndoStatus(RS_Object::Id objectId) {
-    RS_DbCommand cmd(
-        db, 
-        "SELECT undoStatus "
-        "FROM Object "
-        "WHERE id=?"
-    );
-    cmd.bind(1, objectId);
-    return (cmd.executeInt()!=0);
+    RS_DbsOperationTimer timer(statistics, "getUndoStatus");
+    return getObjectDirectory().isUndone(objectId);
 }
 
 
 
 /**
  * \return Object type ID of the given object or RS_Object::UnknownObject if 
- *      the object does not exist.
+ *      the object does not exist or is undone.
  */
 RS_Object::ObjectTypeId RS_DbStorage::getObjectTypeId(RS_Object::Id objectId) {
-    // query object type ID:
-    RS_DbCommand cmd(
-        db, 
-        "SELECT objectTypeId "
-        "FROM Object "
-        "WHERE id=? "
-        "  AND undoStatus=0"
-    );
-    cmd.bind(1, objectId);
-
-    RS_DbReader reader = cmd.executeReader();
-    if (!reader.read()) {
+    RS_DbsOperationTimer timer(statistics, "getObjectTypeId");
+    if (getObjectDirectory().isUndone(objectId)) {
         return RS_Object::UnknownObject;
     }
 
-    return (RS_Object::ObjectTypeId)reader.getInt64(0);
+    return getObjectDirectory().getObjectTypeId(objectId);
 }
 
 
@@ -615,6 +1659,9 @@ RS_Object::ObjectTypeId RS_DbStorage::getObjectTypeId(RS_Object::Id objectId) {
  * Helper function that turns the given list of IDs into an SQL
  * string list.
  *
+ * \deprecated Embedding IDs into SQL strings is slow for large sets. 
+ *      Use RS_DbsIdTable instead.
+ *
  * \return List of IDs as string for use in SQL queries. 
  *      E.g. "(1,7,5,17)"
  */
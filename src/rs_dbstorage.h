@@ -3,10 +3,21 @@
 
 #include <sstream>
 #include <set>
+#include <vector>
 
 #include "RS_Transaction"
 #include "RS_AbstractStorage"
 #include "RS_DbClient"
+#include "RS_DbsIdSet"
+#include "RS_DbsIdVisitor"
+#include "RS_DbsObjectCache"
+#include "RS_DbsObjectDirectory"
+#include "RS_DbsReaderPool"
+#include "RS_DbsSelection"
+#include "RS_DbsSnapshot"
+#include "RS_DbsStatementCache"
+#include "RS_DbsStatistics"
+#include "RS_DbStorageOptions"
 
 
 
@@ -32,6 +43,8 @@
  * \b Transaction
  * - \b id: Log entry ID.
  * - \b text: Description of transaction.
+ * - \b size: Approximate number of bytes the transaction occupies in 
+ *          the undo log.
  *
  * The \b Transaction table is used for the undo/redo mechanism.
  *
@@ -49,6 +62,15 @@
  * last transaction. This pointer wanders up and down the transaction log
  * if the user hits undo / redo.
  *
+ * The undo log can be limited to a number of steps and / or a number 
+ * of bytes (see \ref setUndoBudget). Transactions that exceed the 
+ * budget are dropped from the start of the log and objects that can no
+ * longer be restored by any remaining transaction are purged.
+ *
+ * All functions of a storage must be called from the same thread. 
+ * Other threads can query the document through the reader pool (see
+ * \ref getReaderPool).
+ *
  * \author Andrew Mustun
  * \ingroup qcaddbstorage
  */
@@ -61,20 +83,55 @@ public:
     };
 
 public:
-    RS_DbStorage(const std::string& fileName = ":memory:");
+    RS_DbStorage(
+        const std::string& fileName = ":memory:", 
+        const RS_DbStorageOptions& options = RS_DbStorageOptions()
+    );
     virtual ~RS_DbStorage();
 
+    static void removeFiles(const std::string& fileName);
+
     virtual void queryAllObjects(std::set<RS_Object::Id>& result);
     virtual void queryAllEntities(std::set<RS_Entity::Id>& result);
     virtual void queryAllUcs(std::set<RS_Ucs::Id>& result);
     
     virtual void querySelectedEntities(std::set<RS_Entity::Id>& result);
 
+    void queryAllObjects(RS_DbsIdVisitor& visitor);
+    void queryAllEntities(RS_DbsIdVisitor& visitor);
+    void queryAllUcs(RS_DbsIdVisitor& visitor);
+    void querySelectedEntities(RS_DbsIdVisitor& visitor);
+
+    void queryAllObjects(RS_DbsIdSet& result);
+    void queryAllEntities(RS_DbsIdSet& result);
+    void queryAllUcs(RS_DbsIdSet& result);
+    void querySelectedEntities(RS_DbsIdSet& result);
+    void queryEntitiesInBox(
+        const RS_Box& box, 
+        RS_DbsIdSet& result, 
+        bool inside=false
+    );
+
+    virtual void queryEntitiesInBox(
+        const RS_Box& box, 
+        std::set<RS_Entity::Id>& result, 
+        bool inside=false
+    );
+
     virtual RS_Object* queryObject(RS_Object::Id objectId);
     virtual RS_Entity* queryEntity(RS_Entity::Id entityId);
     virtual RS_Ucs* queryUcs(RS_Ucs::Id ucsId);
     virtual RS_Ucs* queryUcs(const std::string& ucsName);
 
+    virtual void queryObjects(
+        std::set<RS_Object::Id>& objectIds, 
+        std::vector<RS_Object*>& result
+    );
+    virtual void queryEntities(
+        std::set<RS_Entity::Id>& entityIds, 
+        std::vector<RS_Entity*>& result
+    );
+
     virtual void clearEntitySelection(
         std::set<RS_Entity::Id>* affectedEntities=NULL
     );
@@ -89,11 +146,20 @@ public:
         bool add=false, 
         std::set<RS_Entity::Id>* affectedEntities=NULL
     );
+    void selectEntities(
+        const RS_DbsIdSet& entityIds, 
+        bool add=false, 
+        RS_DbsIdSet* affectedEntities=NULL
+    );
+
+    void saveSelection();
 
     virtual RS_Box getBoundingBox();
     
     virtual void saveObject(RS_Object& object);
+    virtual void saveObjects(std::vector<RS_Object*>& objects);
     virtual void deleteObject(RS_Object::Id objectId);
+    virtual void deleteObjects(std::set<RS_Object::Id>& objectIds);
 
     virtual void beginTransaction();
     virtual void commitTransaction();
@@ -104,20 +170,173 @@ public:
     virtual void deleteTransactionsFrom(int transactionId);
     virtual RS_Transaction getTransaction(int transactionId);
     virtual int getMaxTransactionId();
+    int getMinTransactionId();
 
     virtual void toggleUndoStatus(std::set<RS_Object::Id>& objectIds);
+    void toggleUndoStatus(const RS_DbsIdSet& objectIds);
     virtual void toggleUndoStatus(RS_Object::Id objectId);
     virtual bool getUndoStatus(RS_Object::Id objectId);
     
     static std::string getSqlList(std::set<RS_Object::Id>& values);
 
+    /**
+     * \return Cache of prepared statements used for this storage. Can
+     *      be used to query hit / miss statistics.
+     */
+    RS_DbsStatementCache& getStatementCache() {
+        return statementCache;
+    }
+
+    /**
+     * \return Timing and row counts of the operations and SQL 
+     *      statements of this storage. Disabled by default.
+     */
+    RS_DbsStatistics& getStatistics() {
+        return statistics;
+    }
+
+    /**
+     * \return Cache of loaded objects used for this storage. Can be 
+     *      used to query hit / miss statistics.
+     */
+    RS_DbsObjectCache& getObjectCache() {
+        return objectCache;
+    }
+
+    void setObjectCacheCapacity(int capacity);
+
+    /**
+     * Enables or disables the compression of the property changes 
+     * stored in the undo log. Existing records are not affected.
+     */
+    void setUndoLogCompression(bool on) {
+        undoLogCompression = on;
+    }
+
+    bool getUndoLogCompression() const {
+        return undoLogCompression;
+    }
+
+    void setOptions(const RS_DbStorageOptions& options);
+
+    /**
+     * \return SQLite settings of this storage.
+     */
+    const RS_DbStorageOptions& getOptions() const {
+        return options;
+    }
+
+    RS_DbsSnapshot* snapshotTo(
+        const std::string& fileName, 
+        RS_DbsSnapshotListener* listener = NULL
+    );
+
+    /**
+     * \return The snapshot started last with \ref snapshotTo or NULL.
+     */
+    RS_DbsSnapshot* getSnapshot() {
+        return snapshot;
+    }
+
+    /**
+     * \return Pool of read-only connections for other threads or NULL
+     *      if no reader connections are configured (see
+     *      RS_DbStorageOptions::readerConnections).
+     */
+    RS_DbsReaderPool* getReaderPool() {
+        return readerPool;
+    }
+
+    void setUndoBudget(int maxSteps, long long maxBytes);
+
+    /**
+     * \return Maximum number of transactions kept in the undo log or 
+     *      0 for no limit.
+     */
+    int getMaxUndoSteps() const {
+        return maxUndoSteps;
+    }
+
+    /**
+     * \return Maximum size of the undo log in bytes or 0 for no limit.
+     */
+    long long getMaxUndoBytes() const {
+        return maxUndoBytes;
+    }
+
+    long long getUndoLogSize();
+    int getUndoSteps();
+    void compactUndoLog();
+
+    /**
+     * Approximate cost in bytes of one affected object of a transaction
+     * (row in AffectedObjects and in its index).
+     */
+    static const int bytesPerAffectedObject = 16;
+
 protected:
     RS_Object::ObjectTypeId getObjectTypeId(RS_Object::Id objectId);
     RS_Object* queryObject(RS_Object::Id objectId, RS_Object::ObjectTypeId objectTypeId);
 
+    void updateSelectionStatus(RS_Object* object);
+
+    void growBoundingBox(const RS_Vector& minV, const RS_Vector& maxV);
+    void shrinkBoundingBox(const RS_Vector& minV, const RS_Vector& maxV);
+
+    void deleteTransactionsBefore(int transactionId);
+    void subtractFromUndoLog(int transactionId, bool before);
+    void invalidateUndoLog();
+    static void onRollback(void* storage);
+
+    RS_DbsObjectDirectory& getObjectDirectory();
+    bool isVisibleEntity(RS_Object::Id objectId);
+
 private:
     //! connection to SQLite DB:
     RS_DbConnection db;
+    //! SQLite handle of the connection (see RS_DbsHandle):
+    sqlite3* handle;
+    //! prepared statements for the connection:
+    RS_DbsStatementCache statementCache;
+    //! timing of operations and statements:
+    RS_DbsStatistics statistics;
+    //! object type and undo status of all objects:
+    RS_DbsObjectDirectory objectDirectory;
+    //! recently loaded objects:
+    RS_DbsObjectCache objectCache;
+    //! selection status of all entities:
+    RS_DbsSelection selection;
+
+    //! bounding box of all entities that are not undone:
+    RS_Vector boundingBoxMin;
+    RS_Vector boundingBoxMax;
+    //! true if the document has no entities that are not undone:
+    bool boundingBoxEmpty;
+    //! false if the bounding box has to be recomputed:
+    bool boundingBoxValid;
+
+    //! SQLite settings:
+    RS_DbStorageOptions options;
+
+    //! true to compress the property changes in the undo log:
+    bool undoLogCompression;
+
+    //! undo budget, 0 for no limit:
+    int maxUndoSteps;
+    long long maxUndoBytes;
+    //! size of the undo log in bytes or -1 if it has to be recomputed:
+    long long undoLogSize;
+    //! number of transactions or -1 if it has to be recomputed:
+    int undoSteps;
+
+    //! true if the object directory has been built:
+    bool objectDirectoryLoaded;
+
+    //! snapshot started last, may still be running:
+    RS_DbsSnapshot* snapshot;
+
+    //! read-only connections for other threads or NULL:
+    RS_DbsReaderPool* readerPool;
 };
 
 #endif
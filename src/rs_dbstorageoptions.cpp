@@ -0,0 +1,163 @@
+#include <cctype>
+#include <sstream>
+
+#include "RS_DbStorageOptions"
+#include "RS_Debug"
+
+
+
+/**
+ * Default constructor. Leaves all SQLite defaults untouched.
+ */
+RS_DbStorageOptions::RS_DbStorageOptions()
+    : journalMode(JournalDefault),
+      synchronous(SynchronousDefault),
+      pageSize(0),
+      cacheSize(0),
+      mmapSize(-1),
+      tempStore(TempStoreDefault),
+      readerConnections(0),
+      statistics(false) {
+}
+
+
+
+/**
+ * \return Preset for documents that are edited interactively.
+ */
+RS_DbStorageOptions RS_DbStorageOptions::getInteractive() {
+    RS_DbStorageOptions ret;
+    ret.journalMode = JournalWal;
+    ret.synchronous = SynchronousNormal;
+    ret.cacheSize = 64*1024;
+    ret.mmapSize = 256*1024*1024;
+    ret.tempStore = TempStoreMemory;
+    return ret;
+}
+
+
+
+/**
+ * \return Preset for importing large amounts of data into a new
+ *      document.
+ */
+RS_DbStorageOptions RS_DbStorageOptions::getBulkImport() {
+    RS_DbStorageOptions ret;
+    ret.journalMode = JournalMemory;
+    ret.synchronous = SynchronousOff;
+    ret.pageSize = 8192;
+    ret.cacheSize = 256*1024;
+    ret.tempStore = TempStoreMemory;
+    return ret;
+}
+
+
+
+static const char* journalModes[] = {
+    NULL, "DELETE", "TRUNCATE", "PERSIST", "MEMORY", "WAL", "OFF"
+};
+
+
+
+/**
+ * Applies the options to the given DB connection. The page size must
+ * be applied before the first table is created to have an effect.
+ * Must not be called inside a transaction.
+ *
+ * SQLite does not switch to every journal mode, for example documents
+ * in an :memory: DB always use MEMORY and WAL is not available on all
+ * file systems. The journal mode SQLite reports back is returned and
+ * an error is logged if a file document does not use the requested 
+ * mode.
+ *
+ * \return Journal mode in effect.
+ */
+RS_DbStorageOptions::JournalMode RS_DbStorageOptions::apply(RS_DbConnection& db) const {
+    static const char* synchronousLevels[] = {
+        NULL, "OFF", "NORMAL", "FULL"
+    };
+    static const char* tempStores[] = {
+        NULL, "FILE", "MEMORY"
+    };
+
+    if (pageSize>0) {
+        std::stringstream ss;
+        ss << "PRAGMA page_size=" << pageSize << ";";
+        db.executeNonQuery(ss.str().c_str());
+    }
+
+    // the pragma returns the journal mode in effect:
+    std::string mode;
+    if (journalMode!=JournalDefault) {
+        std::stringstream ss;
+        ss << "PRAGMA journal_mode=" << journalModes[journalMode] << ";";
+        RS_DbCommand cmd(db, ss.str().c_str());
+        mode = cmd.executeString();
+    }
+    else {
+        RS_DbCommand cmd(db, "PRAGMA journal_mode;");
+        mode = cmd.executeString();
+    }
+    JournalMode journalModeInEffect = getJournalMode(mode);
+    // :memory: DBs always report MEMORY:
+    if (journalMode!=JournalDefault && journalModeInEffect!=journalMode && 
+        journalModeInEffect!=JournalMemory) {
+        RS_Debug::error("RS_DbStorageOptions::apply: "
+            "journal mode %s requested, SQLite uses %s", 
+            journalModes[journalMode], mode.c_str());
+    }
+
+    if (synchronous!=SynchronousDefault) {
+        std::stringstream ss;
+        ss << "PRAGMA synchronous=" << synchronousLevels[synchronous] << ";";
+        db.executeNonQuery(ss.str().c_str());
+    }
+
+    if (cacheSize>0) {
+        // negative values are interpreted by SQLite as KB:
+        std::stringstream ss;
+        ss << "PRAGMA cache_size=" << -cacheSize << ";";
+        db.executeNonQuery(ss.str().c_str());
+    }
+
+    if (mmapSize>=0) {
+        std::stringstream ss;
+        ss << "PRAGMA mmap_size=" << mmapSize << ";";
+        db.executeNonQuery(ss.str().c_str());
+    }
+
+    if (tempStore!=TempStoreDefault) {
+        std::stringstream ss;
+        ss << "PRAGMA temp_store=" << tempStores[tempStore] << ";";
+        db.executeNonQuery(ss.str().c_str());
+    }
+
+    RS_Debug::debug("RS_DbStorageOptions::apply: journal mode: %s, "
+        "synchronous: %d, page size: %d, cache size: %dKB, temp store: %d",
+        mode.c_str(), (int)synchronous, pageSize, cacheSize, (int)tempStore);
+
+    return journalModeInEffect;
+}
+
+
+
+/**
+ * \return Journal mode with the given name as reported by 
+ *      PRAGMA journal_mode (case insensitive) or JournalDefault for 
+ *      unknown names.
+ */
+RS_DbStorageOptions::JournalMode RS_DbStorageOptions::getJournalMode(
+    const std::string& name) {
+
+    std::string upperName = name;
+    for (size_t i=0; i<upperName.size(); i++) {
+        upperName[i] = (char)toupper((unsigned char)upperName[i]);
+    }
+
+    for (int i=JournalDelete; i<=JournalOff; i++) {
+        if (upperName==journalModes[i]) {
+            return (JournalMode)i;
+        }
+    }
+    return JournalDefault;
+}
@@ -0,0 +1,98 @@
+#ifndef RS_DBSTORAGEOPTIONS_H
+#define RS_DBSTORAGEOPTIONS_H
+
+#include <string>
+
+#include "RS_DbClient"
+
+
+
+/**
+ * SQLite settings for the DB of a document. The options are passed to
+ * the RS_DbStorage constructor and applied right after the DB has been
+ * opened. Every setting has a default value which leaves the SQLite
+ * default untouched.
+ *
+ * The settings mainly matter for file-backed documents. For documents
+ * in an :memory: DB, journal mode and synchronous level have no effect.
+ *
+ * Presets:
+ *
+ * - \ref getInteractive: For documents that are edited interactively.
+ *   WAL journal, synchronous NORMAL (a commit is durable after the next
+ *   checkpoint, the DB is never corrupted), 64MB page cache, 256MB
+ *   memory mapped I/O and temporary tables in memory. Commits are cheap
+ *   and readers are never blocked by the writer.
+ *
+ * - \ref getBulkImport: For importing a large file into a new document.
+ *   Rollback journal in memory, no syncs, 8KB pages, 256MB page cache
+ *   and temporary tables in memory. The DB may be corrupted if the
+ *   process dies during the import, so the document should be switched
+ *   to the interactive preset (see RS_DbStorage::setOptions) once the
+ *   import is done.
+ *
+ * \author Andrew Mustun
+ * \ingroup qcaddbstorage
+ */
+class RS_DbStorageOptions {
+public:
+    enum JournalMode {
+        JournalDefault,
+        JournalDelete,
+        JournalTruncate,
+        JournalPersist,
+        JournalMemory,
+        JournalWal,
+        JournalOff
+    };
+
+    enum Synchronous {
+        SynchronousDefault,
+        SynchronousOff,
+        SynchronousNormal,
+        SynchronousFull
+    };
+
+    enum TempStore {
+        TempStoreDefault,
+        TempStoreFile,
+        TempStoreMemory
+    };
+
+public:
+    RS_DbStorageOptions();
+
+    static RS_DbStorageOptions getInteractive();
+    static RS_DbStorageOptions getBulkImport();
+
+    JournalMode apply(RS_DbConnection& db) const;
+
+    static JournalMode getJournalMode(const std::string& name);
+
+public:
+    //! journal mode (PRAGMA journal_mode):
+    JournalMode journalMode;
+    //! synchronous level (PRAGMA synchronous):
+    Synchronous synchronous;
+    //! page size in bytes or 0 for the default. Only has an effect for
+    //! new DBs (PRAGMA page_size):
+    int pageSize;
+    //! size of the page cache in KB or 0 for the default
+    //! (PRAGMA cache_size):
+    int cacheSize;
+    //! maximum number of bytes used for memory mapped I/O or -1 for
+    //! the default (PRAGMA mmap_size):
+    long long mmapSize;
+    //! storage of temporary tables and indices (PRAGMA temp_store):
+    TempStore tempStore;
+    //! number of read-only connections for other threads or 0 for 
+    //! none (see RS_DbsReaderPool). Only used when a file document is 
+    //! opened and SQLite switches it to WAL mode:
+    int readerConnections;
+    //! true to enable the statistics of the storage and of its reader
+    //! connections while the document is opened, so they include the
+    //! statements that open it (see RS_DbStorage::getStatistics):
+    bool statistics;
+};
+
+#endif
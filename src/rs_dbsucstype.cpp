@@ -1,7 +1,11 @@
 #include "RS_DbsUcsType"
 #include "RS_DbClient"
 #include "RS_Ucs"
+#include "RS_DbsIdTable"
 #include "RS_DbsObjectTypeRegistry"
+#include "RS_DbsIdSet"
+#include "RS_DbsIdVisitor"
+#include "RS_DbsStatementCache"
 
 
 
@@ -18,7 +22,7 @@ void RS_DbsUcsType::initDb(RS_DbConnection& db) {
     RS_DbsObjectType::initDb(db);
     
     db.executeNonQuery(
-        "CREATE TABLE Ucs("
+        "CREATE TABLE IF NOT EXISTS Ucs("
             "id INTEGER PRIMARY KEY, "
             "name TEXT UNIQUE, "
             "originX REAL, "
@@ -58,7 +62,7 @@ void RS_DbsUcsType::loadObject(RS_DbConnection& db, RS_Object& object, RS_Object
     RS_Vector xAxisDirection;
     RS_Vector yAxisDirection;
 
-    RS_DbCommand cmd(
+    RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
         db, 
         "SELECT name, "
         "       originX,originY,originZ, "
@@ -69,7 +73,7 @@ void RS_DbsUcsType::loadObject(RS_DbConnection& db, RS_Object& object, RS_Object
     );
     cmd.bind(1, objectId);
 
-    RS_DbReader reader = cmd.executeReader();
+    RS_DbsReader reader = cmd.executeReader();
     if (!reader.read()) {
         RS_Debug::error("RS_DbStorage::queryUcs: "
             "cannot read data for UCS %d", objectId);
@@ -98,6 +102,24 @@ void RS_DbsUcsType::loadObject(RS_DbConnection& db, RS_Object& object, RS_Object
 
 
 
+RS_Object* RS_DbsUcsType::cloneObject(RS_Object& object) {
+    RS_Ucs* ucs = dynamic_cast<RS_Ucs*>(&object);
+    if (ucs==NULL) {
+        RS_Debug::error("RS_DbsUcsType::cloneObject: given object not a UCS");
+        return NULL;
+    }
+
+    RS_Ucs* clone = new RS_Ucs();
+    clone->setId(ucs->getId());
+    clone->name = ucs->name;
+    clone->setOrigin(ucs->origin);
+    clone->setXAxisDirection(ucs->xAxisDirection);
+    clone->setYAxisDirection(ucs->yAxisDirection);
+    return clone;
+}
+
+
+
 void RS_DbsUcsType::saveObject(RS_DbConnection& db, RS_Object& object, bool isNew) {
     RS_DbsObjectType::saveObject(db, object, isNew);
 
@@ -109,7 +131,7 @@ void RS_DbsUcsType::saveObject(RS_DbConnection& db, RS_Object& object, bool isNe
 
     // add ucs as new entity:
     if (isNew) {
-        RS_DbCommand cmd(
+        RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
             db, 
             "INSERT INTO Ucs "
             "VALUES(?, ?, ?,?,?, ?,?,?, ?,?,?);"
@@ -138,7 +160,7 @@ void RS_DbsUcsType::saveObject(RS_DbConnection& db, RS_Object& object, bool isNe
 
     // update existing UCS:
     else {
-        RS_DbCommand cmd(
+        RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
             db, 
             "UPDATE Ucs "
             "SET name=?, "
@@ -167,7 +189,7 @@ void RS_DbsUcsType::saveObject(RS_DbConnection& db, RS_Object& object, bool isNe
 
 
 void RS_DbsUcsType::deleteObject(RS_DbConnection& db, RS_Object::Id objectId) {
-    RS_DbCommand cmd(
+    RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
         db, 
         "DELETE FROM Ucs "
         "WHERE id=?"
@@ -184,7 +206,7 @@ void RS_DbsUcsType::deleteObject(RS_DbConnection& db, RS_Object::Id objectId) {
  * \return The ID of the UCS with the given name or -1.
  */
 RS_Ucs::Id RS_DbsUcsType::getUcsId(RS_DbConnection& db, const std::string& ucsName) {
-    RS_DbCommand cmd(
+    RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
         db, 
         "SELECT id "
         "FROM Ucs "
@@ -192,7 +214,7 @@ RS_Ucs::Id RS_DbsUcsType::getUcsId(RS_DbConnection& db, const std::string& ucsNa
     );
     cmd.bind(1, ucsName);
 
-    RS_DbReader reader = cmd.executeReader();
+    RS_DbsReader reader = cmd.executeReader();
     if (reader.read()) {
         return reader.getInt64(0);
     }
@@ -206,7 +228,28 @@ RS_Ucs::Id RS_DbsUcsType::getUcsId(RS_DbConnection& db, const std::string& ucsNa
  * Helper function for RS_DbStorage.
  */
 void RS_DbsUcsType::queryAllUcs(RS_DbConnection& db, std::set<RS_Ucs::Id>& result) {
-    RS_DbCommand cmd(
+    RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
+        db, 
+        "SELECT Object.id "
+        "FROM Object, Ucs "
+        "WHERE Object.undoStatus=0 "
+        "  AND Object.id=Ucs.id"
+    );
+
+    // IDs are read in ascending order:
+    RS_DbsReader reader = cmd.executeReader();
+    while (reader.read()) {
+        result.insert(result.end(), reader.getInt64(0));
+    }
+}
+
+
+
+/**
+ * \overload
+ */
+void RS_DbsUcsType::queryAllUcs(RS_DbConnection& db, RS_DbsIdSet& result) {
+    RS_DbsStatement& cmd = RS_DbsStatementCache::prepare(
         db, 
         "SELECT Object.id "
         "FROM Object, Ucs "
@@ -214,8 +257,46 @@ void RS_DbsUcsType::queryAllUcs(RS_DbConnection& db, std::set<RS_Ucs::Id>& resul
         "  AND Object.id=Ucs.id"
     );
 
-    RS_DbReader reader = cmd.executeReader();
+    // IDs are read in ascending order, so every insert is O(1):
+    RS_DbsIdSet ids;
+    RS_DbsReader reader = cmd.executeReader();
     while (reader.read()) {
-        result.insert(reader.getInt64(0));
+        ids.insert(reader.getInt64(0));
     }
+    result.unite(ids);
+}
+
+
+
+/**
+ * Helper function for RS_DbStorage. Reports the IDs of all UCSs that
+ * are not undone to the given visitor.
+ */
+void RS_DbsUcsType::queryAllUcs(RS_DbConnection& db, RS_DbsIdVisitor& visitor) {
+    visitIds(
+        db, 
+        "SELECT Object.id "
+        "FROM Object, Ucs "
+        "WHERE Object.undoStatus=0 "
+        "  AND Object.id=Ucs.id "
+        "ORDER BY Object.id", 
+        visitor
+    );
+}
+
+
+
+/**
+ * Deletes all UCSs with the given IDs with one statement per table.
+ */
+void RS_DbsUcsType::deleteObjects(RS_DbConnection& db, std::set<RS_Object::Id>& objectIds) {
+    RS_DbsIdTable::fill(db, "DeleteIds", objectIds);
+
+    RS_DbsStatementCache::prepare(
+        db, 
+        "DELETE FROM Ucs "
+        "WHERE id IN (SELECT id FROM temp.DeleteIds)"
+    ).executeNonQuery();
+
+    deleteObjectRecords(db, "DeleteIds");
 }
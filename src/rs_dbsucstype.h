@@ -19,10 +19,14 @@ public:
     virtual void initDb(RS_DbConnection& db);
     virtual RS_Object* loadObject(RS_DbConnection& db, RS_Object::Id objectId);
     virtual void loadObject(RS_DbConnection& db, RS_Object& object, RS_Object::Id objectId);
+    virtual RS_Object* cloneObject(RS_Object& object);
     virtual void saveObject(RS_DbConnection& db, RS_Object& entity, bool isNew);
     virtual void deleteObject(RS_DbConnection& db, RS_Object::Id objectId);
+    virtual void deleteObjects(RS_DbConnection& db, std::set<RS_Object::Id>& objectIds);
 
     RS_Ucs::Id getUcsId(RS_DbConnection& db, const std::string& ucsName);
     
     static void queryAllUcs(RS_DbConnection& db, std::set<RS_Ucs::Id>& result);
+    static void queryAllUcs(RS_DbConnection& db, RS_DbsIdVisitor& visitor);
+    static void queryAllUcs(RS_DbConnection& db, RS_DbsIdSet& result);
 };
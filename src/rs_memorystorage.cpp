@@ -0,0 +1,1311 @@
+#include <algorithm>
+#include <limits>
+
+#include "RS_Debug"
+#include "RS_LineEntity"
+#include "RS_MemoryStorage"
+
+
+
+/**
+ * Creates an empty document.
+ */
+RS_MemoryStorage::RS_MemoryStorage()
+    : objectCount(0),
+      boundingBoxEmpty(true),
+      boundingBoxValid(true),
+      lastTransactionId(-1),
+      maxUndoSteps(0),
+      maxUndoBytes(0),
+      undoLogSize(0) {
+
+    // object IDs start at 1 like in RS_DbStorage, slot 0 is never used:
+    double nan = std::numeric_limits<double>::quiet_NaN();
+    tables.push_back(tableNone);
+    rows.push_back(-1);
+    undoStatus.push_back(0);
+    minX.push_back(nan);
+    minY.push_back(nan);
+    minZ.push_back(nan);
+    maxX.push_back(nan);
+    maxY.push_back(nan);
+    maxZ.push_back(nan);
+    addBlock();
+}
+
+
+
+RS_MemoryStorage::~RS_MemoryStorage() {
+}
+
+
+
+void RS_MemoryStorage::queryAllObjects(std::set<RS_Object::Id>& result) {
+    for (RS_Object::Id id=1; id<(RS_Object::Id)tables.size(); id++) {
+        if (tables[id]!=tableNone && undoStatus[id]==0) {
+            result.insert(result.end(), id);
+        }
+    }
+}
+
+
+
+void RS_MemoryStorage::queryAllEntities(std::set<RS_Entity::Id>& result) {
+    for (RS_Object::Id id=1; id<(RS_Object::Id)tables.size(); id++) {
+        if (tables[id]==tableLine && undoStatus[id]==0) {
+            result.insert(result.end(), id);
+        }
+    }
+}
+
+
+
+void RS_MemoryStorage::queryAllUcs(std::set<RS_Ucs::Id>& result) {
+    for (RS_Object::Id id=1; id<(RS_Object::Id)tables.size(); id++) {
+        if (tables[id]==tableUcs && undoStatus[id]==0) {
+            result.insert(result.end(), id);
+        }
+    }
+}
+
+
+
+void RS_MemoryStorage::querySelectedEntities(std::set<RS_Entity::Id>& result) {
+    const RS_DbsIdSet& selected = selection.getSelectedIds();
+
+    RS_DbsIdSet::const_iterator it;
+    for (it=selected.begin(); it!=selected.end(); ++it) {
+        if (isVisibleEntity(*it)) {
+            result.insert(result.end(), *it);
+        }
+    }
+}
+
+
+
+/**
+ * Streaming variant of \ref queryAllObjects (see RS_DbsIdVisitor).
+ */
+void RS_MemoryStorage::queryAllObjects(RS_DbsIdVisitor& visitor) {
+    for (RS_Object::Id id=1; id<(RS_Object::Id)tables.size(); id++) {
+        if (tables[id]!=tableNone && undoStatus[id]==0) {
+            if (!visitor.visit(id)) {
+                break;
+            }
+        }
+    }
+}
+
+
+
+/**
+ * Streaming variant of \ref queryAllEntities.
+ */
+void RS_MemoryStorage::queryAllEntities(RS_DbsIdVisitor& visitor) {
+    for (RS_Object::Id id=1; id<(RS_Object::Id)tables.size(); id++) {
+        if (tables[id]==tableLine && undoStatus[id]==0) {
+            if (!visitor.visit(id)) {
+                break;
+            }
+        }
+    }
+}
+
+
+
+/**
+ * Streaming variant of \ref queryAllUcs.
+ */
+void RS_MemoryStorage::queryAllUcs(RS_DbsIdVisitor& visitor) {
+    for (RS_Object::Id id=1; id<(RS_Object::Id)tables.size(); id++) {
+        if (tables[id]==tableUcs && undoStatus[id]==0) {
+            if (!visitor.visit(id)) {
+                break;
+            }
+        }
+    }
+}
+
+
+
+/**
+ * Streaming variant of \ref querySelectedEntities.
+ */
+void RS_MemoryStorage::querySelectedEntities(RS_DbsIdVisitor& visitor) {
+    const RS_DbsIdSet& selected = selection.getSelectedIds();
+
+    RS_DbsIdSet::const_iterator it;
+    for (it=selected.begin(); it!=selected.end(); ++it) {
+        if (isVisibleEntity(*it)) {
+            if (!visitor.visit(*it)) {
+                break;
+            }
+        }
+    }
+}
+
+
+
+/**
+ * Variant of \ref queryAllObjects that adds the IDs to a compact ID
+ * set (see RS_DbsIdSet).
+ */
+void RS_MemoryStorage::queryAllObjects(RS_DbsIdSet& result) {
+    RS_DbsIdSet ids;
+    ids.reserve(objectCount);
+    for (RS_Object::Id id=1; id<(RS_Object::Id)tables.size(); id++) {
+        if (tables[id]!=tableNone && undoStatus[id]==0) {
+            ids.insert(id);
+        }
+    }
+    result.unite(ids);
+}
+
+
+
+void RS_MemoryStorage::queryAllEntities(RS_DbsIdSet& result) {
+    RS_DbsIdSet ids;
+    ids.reserve((int)lineIds.size());
+    for (RS_Object::Id id=1; id<(RS_Object::Id)tables.size(); id++) {
+        if (tables[id]==tableLine && undoStatus[id]==0) {
+            ids.insert(id);
+        }
+    }
+    result.unite(ids);
+}
+
+
+
+void RS_MemoryStorage::queryAllUcs(RS_DbsIdSet& result) {
+    RS_DbsIdSet ids;
+    for (RS_Object::Id id=1; id<(RS_Object::Id)tables.size(); id++) {
+        if (tables[id]==tableUcs && undoStatus[id]==0) {
+            ids.insert(id);
+        }
+    }
+    result.unite(ids);
+}
+
+
+
+void RS_MemoryStorage::querySelectedEntities(RS_DbsIdSet& result) {
+    RS_DbsIdSet ids;
+    const RS_DbsIdSet& selected = selection.getSelectedIds();
+
+    RS_DbsIdSet::const_iterator it;
+    for (it=selected.begin(); it!=selected.end(); ++it) {
+        if (isVisibleEntity(*it)) {
+            ids.insert(*it);
+        }
+    }
+    result.unite(ids);
+}
+
+
+
+void RS_MemoryStorage::queryEntitiesInBox(
+    const RS_Box& box, RS_DbsIdSet& result, bool inside) {
+
+    std::vector<RS_Entity::Id> ids;
+    scanEntitiesInBox(box, inside, ids);
+
+    // IDs are found in ascending order, so every insert is O(1):
+    RS_DbsIdSet idSet;
+    idSet.reserve((int)ids.size());
+    for (unsigned int i=0; i<ids.size(); i++) {
+        idSet.insert(ids[i]);
+    }
+    result.unite(idSet);
+}
+
+
+
+/**
+ * Queries all entities whose bounding box intersects the given box or,
+ * if \c inside is true, is completely inside the given box.
+ */
+void RS_MemoryStorage::queryEntitiesInBox(
+    const RS_Box& box, std::set<RS_Entity::Id>& result, bool inside) {
+
+    std::vector<RS_Entity::Id> ids;
+    scanEntitiesInBox(box, inside, ids);
+
+    for (unsigned int i=0; i<ids.size(); i++) {
+        result.insert(result.end(), ids[i]);
+    }
+}
+
+
+
+/**
+ * Scans the block and bounding box columns for \ref queryEntitiesInBox.
+ * The columns are NaN for IDs that are not entities and for blocks
+ * without entities, so they never match.
+ *
+ * \param result Receives the IDs in ascending order.
+ */
+void RS_MemoryStorage::scanEntitiesInBox(
+    const RS_Box& box, bool inside, std::vector<RS_Entity::Id>& result) {
+
+    RS_Vector c1 = box.getDefiningCorner1();
+    RS_Vector c2 = box.getDefiningCorner2();
+    double bx1 = std::min(c1.x, c2.x);
+    double by1 = std::min(c1.y, c2.y);
+    double bz1 = std::min(c1.z, c2.z);
+    double bx2 = std::max(c1.x, c2.x);
+    double by2 = std::max(c1.y, c2.y);
+    double bz2 = std::max(c1.z, c2.z);
+
+    RS_Object::Id n = (RS_Object::Id)tables.size();
+    int blocks = (int)blockMinX.size();
+    for (int b=0; b<blocks; b++) {
+        // entities inside the box also intersect it:
+        if (!(blockMaxX[b]>=bx1 && blockMinX[b]<=bx2 &&
+              blockMaxY[b]>=by1 && blockMinY[b]<=by2 &&
+              blockMaxZ[b]>=bz1 && blockMinZ[b]<=bz2)) {
+            continue;
+        }
+
+        RS_Object::Id last = std::min((b+1)*blockSize, n);
+        for (RS_Object::Id id=b*blockSize; id<last; id++) {
+            bool match;
+            if (inside) {
+                match = minX[id]>=bx1 && maxX[id]<=bx2 &&
+                        minY[id]>=by1 && maxY[id]<=by2 &&
+                        minZ[id]>=bz1 && maxZ[id]<=bz2;
+            }
+            else {
+                match = maxX[id]>=bx1 && minX[id]<=bx2 &&
+                        maxY[id]>=by1 && minY[id]<=by2 &&
+                        maxZ[id]>=bz1 && minZ[id]<=bz2;
+            }
+
+            if (match && undoStatus[id]==0) {
+                result.push_back(id);
+            }
+        }
+    }
+}
+
+
+
+/**
+ * Instantiates the object with the given ID. The caller is responsible
+ * for deleting the instance.
+ *
+ * \return The object or NULL if the object does not exist or is undone.
+ */
+RS_Object* RS_MemoryStorage::queryObject(RS_Object::Id objectId) {
+    if (!contains(objectId) || undoStatus[objectId]!=0) {
+        return NULL;
+    }
+
+    int row = rows[objectId];
+    RS_Object* object = NULL;
+
+    switch (tables[objectId]) {
+    case tableLine: {
+        RS_LineData data;
+        data.startPoint.x = x1[row];
+        data.startPoint.y = y1[row];
+        data.startPoint.z = z1[row];
+        data.endPoint.x = x2[row];
+        data.endPoint.y = y2[row];
+        data.endPoint.z = z2[row];
+        object = new RS_LineEntity(data, objectId);
+        break;
+    }
+
+    case tableUcs: {
+        RS_Ucs* ucs = new RS_Ucs();
+        ucs->setId(objectId);
+        ucs->name = ucsNames[row];
+        ucs->setOrigin(ucsOrigins[row]);
+        ucs->setXAxisDirection(ucsXAxisDirections[row]);
+        ucs->setYAxisDirection(ucsYAxisDirections[row]);
+        object = ucs;
+        break;
+    }
+
+    default:
+        break;
+    }
+
+    updateSelectionStatus(object);
+    return object;
+}
+
+
+
+RS_Entity* RS_MemoryStorage::queryEntity(RS_Entity::Id entityId) {
+    RS_Object* object = queryObject(entityId);
+    if (object==NULL) {
+        return NULL;
+    }
+
+    RS_Entity* entity = dynamic_cast<RS_Entity*>(object);
+    if (entity==NULL) {
+        delete object;
+        return NULL;
+    }
+
+    return entity;
+}
+
+
+
+RS_Ucs* RS_MemoryStorage::queryUcs(RS_Ucs::Id ucsId) {
+    RS_Object* object = queryObject(ucsId);
+    if (object==NULL) {
+        return NULL;
+    }
+
+    RS_Ucs* ucs = dynamic_cast<RS_Ucs*>(object);
+    if (ucs==NULL) {
+        delete object;
+        return NULL;
+    }
+
+    return ucs;
+}
+
+
+
+RS_Ucs* RS_MemoryStorage::queryUcs(const std::string& ucsName) {
+    int row = getUcsRow(ucsName);
+    if (row==-1) {
+        return NULL;
+    }
+
+    return queryUcs(ucsIds[row]);
+}
+
+
+
+/**
+ * Instantiates all objects with the given IDs that exist and are not
+ * undone and appends them to \c result. The caller is responsible for
+ * deleting the instances.
+ */
+void RS_MemoryStorage::queryObjects(
+    std::set<RS_Object::Id>& objectIds, std::vector<RS_Object*>& result) {
+
+    std::set<RS_Object::Id>::iterator it;
+    for (it=objectIds.begin(); it!=objectIds.end(); ++it) {
+        RS_Object* object = queryObject(*it);
+        if (object!=NULL) {
+            result.push_back(object);
+        }
+    }
+}
+
+
+
+/**
+ * Instantiates all entities with the given IDs that exist and are not
+ * undone. Objects that are not entities are ignored.
+ */
+void RS_MemoryStorage::queryEntities(
+    std::set<RS_Entity::Id>& entityIds, std::vector<RS_Entity*>& result) {
+
+    std::set<RS_Entity::Id>::iterator it;
+    for (it=entityIds.begin(); it!=entityIds.end(); ++it) {
+        if (isVisibleEntity(*it)) {
+            result.push_back(queryEntity(*it));
+        }
+    }
+}
+
+
+
+void RS_MemoryStorage::clearEntitySelection(std::set<RS_Entity::Id>* affectedObjects) {
+    selection.clear(affectedObjects);
+}
+
+
+
+void RS_MemoryStorage::selectEntity(
+    RS_Entity::Id entityId, bool add,
+    std::set<RS_Entity::Id>* affectedObjects) {
+
+    selection.select(entityId, add, affectedObjects);
+}
+
+
+
+void RS_MemoryStorage::selectEntities(
+    std::set<RS_Entity::Id>& entityIds,
+    bool add,
+    std::set<RS_Entity::Id>* affectedObjects) {
+
+    selection.select(entityIds, add, affectedObjects);
+}
+
+
+
+void RS_MemoryStorage::selectEntities(
+    const RS_DbsIdSet& entityIds,
+    bool add,
+    RS_DbsIdSet* affectedObjects) {
+
+    selection.select(entityIds, add, affectedObjects);
+}
+
+
+
+/**
+ * Sets the selection status of the given object if it is an entity.
+ */
+void RS_MemoryStorage::updateSelectionStatus(RS_Object* object) {
+    RS_Entity* entity = dynamic_cast<RS_Entity*>(object);
+    if (entity!=NULL) {
+        entity->setSelected(selection.isSelected(entity->getId()));
+    }
+}
+
+
+
+/**
+ * \return Bounding box of all entities that are not undone. The box
+ *      is maintained incrementally and only recomputed from the
+ *      bounding box columns after an entity on its boundary was
+ *      deleted, undone or moved.
+ */
+RS_Box RS_MemoryStorage::getBoundingBox() {
+    if (!boundingBoxValid) {
+        boundingBoxValid = true;
+        boundingBoxEmpty = true;
+        for (RS_Entity::Id id=1; id<(RS_Entity::Id)tables.size(); id++) {
+            if (isVisibleEntity(id)) {
+                RS_Vector minV;
+                RS_Vector maxV;
+                getEntityBoundingBox(id, minV, maxV);
+                growBoundingBox(minV, maxV);
+            }
+        }
+    }
+
+    if (boundingBoxEmpty) {
+        return RS_Box(RS_Vector(), RS_Vector());
+    }
+
+    return RS_Box(boundingBoxMin, boundingBoxMax);
+}
+
+
+
+/**
+ * Extends the document bounding box by the given entity bounding box.
+ * Called whenever an entity is added or restored.
+ */
+void RS_MemoryStorage::growBoundingBox(const RS_Vector& minV, const RS_Vector& maxV) {
+    if (!boundingBoxValid) {
+        return;
+    }
+
+    if (boundingBoxEmpty) {
+        boundingBoxMin = minV;
+        boundingBoxMax = maxV;
+        boundingBoxEmpty = false;
+        return;
+    }
+
+    boundingBoxMin.x = std::min(boundingBoxMin.x, minV.x);
+    boundingBoxMin.y = std::min(boundingBoxMin.y, minV.y);
+    boundingBoxMin.z = std::min(boundingBoxMin.z, minV.z);
+    boundingBoxMax.x = std::max(boundingBoxMax.x, maxV.x);
+    boundingBoxMax.y = std::max(boundingBoxMax.y, maxV.y);
+    boundingBoxMax.z = std::max(boundingBoxMax.z, maxV.z);
+}
+
+
+
+/**
+ * Called whenever an entity with the given bounding box is removed,
+ * undone or moved away. The document bounding box is only invalidated
+ * if the entity touched its boundary.
+ */
+void RS_MemoryStorage::shrinkBoundingBox(const RS_Vector& minV, const RS_Vector& maxV) {
+    if (!boundingBoxValid || boundingBoxEmpty) {
+        return;
+    }
+
+    if (minV.x<=boundingBoxMin.x || minV.y<=boundingBoxMin.y ||
+        minV.z<=boundingBoxMin.z || maxV.x>=boundingBoxMax.x ||
+        maxV.y>=boundingBoxMax.y || maxV.z>=boundingBoxMax.z) {
+
+        boundingBoxValid = false;
+    }
+}
+
+
+
+/**
+ * Saves the given object. New objects (with ID -1) get the next free
+ * ID assigned.
+ */
+void RS_MemoryStorage::saveObject(RS_Object& object) {
+    bool isNew = (object.getId()==-1);
+
+    Table table = getTable(object.getObjectTypeId());
+    if (table==tableNone) {
+        RS_Debug::error("RS_MemoryStorage::saveObject: "
+            "object type %d cannot be stored", object.getObjectTypeId());
+        return;
+    }
+
+    RS_Object::Id objectId = object.getId();
+    if (!isNew && (!contains(objectId) || tables[objectId]!=table)) {
+        RS_Debug::error("RS_MemoryStorage::saveObject: "
+            "no object %d of type %d", objectId, object.getObjectTypeId());
+        return;
+    }
+
+    // only entities that are not undone contribute to the bounding box:
+    bool isVisible = isNew || isVisibleEntity(objectId);
+    if (!isNew && isVisibleEntity(objectId)) {
+        RS_Vector minV;
+        RS_Vector maxV;
+        getEntityBoundingBox(objectId, minV, maxV);
+        shrinkBoundingBox(minV, maxV);
+    }
+
+    switch (table) {
+    case tableLine: {
+        RS_LineEntity* line = dynamic_cast<RS_LineEntity*>(&object);
+        if (line==NULL) {
+            RS_Debug::error("RS_MemoryStorage::saveObject: given object not a line");
+            return;
+        }
+        if (isNew) {
+            objectId = addObject(table, addLine(*line));
+            object.setId(objectId);
+        }
+        else {
+            setLine(rows[objectId], *line);
+        }
+        break;
+    }
+
+    case tableUcs: {
+        RS_Ucs* ucs = dynamic_cast<RS_Ucs*>(&object);
+        if (ucs==NULL) {
+            RS_Debug::error("RS_MemoryStorage::saveObject: given object not a UCS");
+            return;
+        }
+        // UCS names are unique like in table Ucs of RS_DbStorage:
+        int row = getUcsRow(ucs->name);
+        if (row!=-1 && ucsIds[row]!=objectId) {
+            RS_Debug::error("RS_MemoryStorage::saveObject: "
+                "duplicate UCS name: %s", ucs->name.c_str());
+            return;
+        }
+        if (isNew) {
+            objectId = addObject(table, addUcs(*ucs));
+            object.setId(objectId);
+        }
+        else {
+            setUcs(rows[objectId], *ucs);
+        }
+        break;
+    }
+
+    default:
+        break;
+    }
+
+    RS_Entity* entity = dynamic_cast<RS_Entity*>(&object);
+    if (entity!=NULL) {
+        RS_Box box = entity->getBoundingBox();
+        setEntityBoundingBox(objectId, box);
+        selection.update(objectId, entity->isSelected());
+        if (isVisible) {
+            growBoundingBox(box.getDefiningCorner1(), box.getDefiningCorner2());
+        }
+    }
+}
+
+
+
+/**
+ * Saves the given objects. New objects get consecutive IDs assigned.
+ * The columns are grown once for the whole batch.
+ */
+void RS_MemoryStorage::saveObjects(std::vector<RS_Object*>& objects) {
+    size_t n = tables.size() + objects.size();
+    tables.reserve(n);
+    rows.reserve(n);
+    undoStatus.reserve(n);
+    minX.reserve(n);
+    minY.reserve(n);
+    minZ.reserve(n);
+    maxX.reserve(n);
+    maxY.reserve(n);
+    maxZ.reserve(n);
+
+    std::vector<RS_Object*>::iterator it;
+    for (it=objects.begin(); it!=objects.end(); ++it) {
+        saveObject(**it);
+    }
+}
+
+
+
+/**
+ * Deletes the given object permanently. Objects that are undone
+ * can also be deleted.
+ */
+void RS_MemoryStorage::deleteObject(RS_Object::Id objectId) {
+    if (!contains(objectId)) {
+        RS_Debug::error("RS_MemoryStorage::deleteObject: "
+            "no object %d", objectId);
+        return;
+    }
+
+    if (isVisibleEntity(objectId)) {
+        RS_Vector minV;
+        RS_Vector maxV;
+        getEntityBoundingBox(objectId, minV, maxV);
+        shrinkBoundingBox(minV, maxV);
+    }
+
+    switch (tables[objectId]) {
+    case tableLine:
+        removeLine(rows[objectId]);
+        break;
+    case tableUcs:
+        removeUcs(rows[objectId]);
+        break;
+    default:
+        break;
+    }
+
+    removeObject(objectId);
+    selection.remove(objectId);
+}
+
+
+
+/**
+ * Deletes all given objects permanently. IDs that are not in use are
+ * ignored.
+ */
+void RS_MemoryStorage::deleteObjects(std::set<RS_Object::Id>& objectIds) {
+    // delete from the highest ID down, so the columns shrink in one go
+    // if the objects are at the end:
+    std::set<RS_Object::Id>::reverse_iterator it;
+    for (it=objectIds.rbegin(); it!=objectIds.rend(); ++it) {
+        if (contains(*it)) {
+            deleteObject(*it);
+        }
+    }
+}
+
+
+
+/**
+ * Transactions of the storage are no-ops: every change is applied
+ * immediately and there is no rollback in the storage interface.
+ */
+void RS_MemoryStorage::beginTransaction() {
+}
+
+
+
+void RS_MemoryStorage::commitTransaction() {
+}
+
+
+
+int RS_MemoryStorage::getLastTransactionId() {
+    return lastTransactionId;
+}
+
+
+
+/**
+ * Sets the ID of the last transaction that has been applied. IDs of
+ * transactions that have been dropped from the undo log are clamped
+ * like in RS_DbStorage::setLastTransactionId.
+ */
+void RS_MemoryStorage::setLastTransactionId(int transactionId) {
+    int floor = transactions.empty() ? lastTransactionId : transactions.begin()->first - 1;
+    if (transactionId<floor) {
+        RS_Debug::error("RS_MemoryStorage::setLastTransactionId: "
+            "transaction %d has been dropped from the undo log, "
+            "last transaction is %d", transactionId + 1, floor);
+        transactionId = floor;
+    }
+    lastTransactionId = transactionId;
+}
+
+
+
+void RS_MemoryStorage::saveTransaction(RS_Transaction& transaction) {
+    // if the given transaction is not undoable, we don't need to
+    // store anything here:
+    if (!transaction.isUndoable()) {
+        return;
+    }
+
+    // assign new unique ID for this transaction:
+    transaction.setId(getLastTransactionId() + 1);
+
+    // delete transactions that are lost for good due to this transaction:
+    deleteTransactionsFrom(transaction.getId());
+
+    TransactionRecord& record = transactions[transaction.getId()];
+    record.text = transaction.getText();
+    record.affectedObjects = RS_DbsIdSet(transaction.getAffectedObjects());
+    record.propertyChanges = transaction.getPropertyChanges();
+    record.size = record.text.size() +
+        (long long)record.affectedObjects.size() * bytesPerAffectedObject +
+        (long long)record.propertyChanges.size() * bytesPerPropertyChange;
+
+    RS_DbsIdSet::const_iterator it;
+    for (it=record.affectedObjects.begin(); it!=record.affectedObjects.end(); ++it) {
+        if (*it<0) {
+            continue;
+        }
+        if (*it>=(RS_Object::Id)references.size()) {
+            references.resize(*it + 1, 0);
+        }
+        references[*it]++;
+    }
+
+    undoLogSize += record.size;
+
+    RS_Debug::debug("RS_MemoryStorage::saveTransaction: transaction %d: "
+        "%d affected objects, %d property changes",
+        transaction.getId(), record.affectedObjects.size(),
+        (int)record.propertyChanges.size());
+
+    setLastTransactionId(transaction.getId());
+
+    // drop the oldest transactions if the undo budget is exceeded by
+    // more than the slack, like RS_DbStorage:
+    if ((maxUndoSteps>0 && getUndoSteps() > maxUndoSteps + maxUndoSteps/8) ||
+        (maxUndoBytes>0 && getUndoLogSize() > maxUndoBytes + maxUndoBytes/8)) {
+
+        compactUndoLog();
+    }
+}
+
+
+
+RS_Transaction RS_MemoryStorage::getTransaction(int transactionId) {
+    std::set<RS_Object::Id> affectedObjects;
+    std::multimap<RS_Object::Id, RS_PropertyChange> propertyChanges;
+    std::string text;
+
+    TransactionMap::iterator it = transactions.find(transactionId);
+    if (it!=transactions.end()) {
+        text = it->second.text;
+        it->second.affectedObjects.toSet(affectedObjects);
+        propertyChanges = it->second.propertyChanges;
+    }
+
+    return RS_Transaction(
+        *this,
+        transactionId,
+        text,
+        affectedObjects,
+        propertyChanges
+    );
+}
+
+
+
+/**
+ * Removes the given transactions from the undo log and decrements the
+ * reference counts of their affected objects.
+ *
+ * \param unreferenced Receives the IDs of all objects that are no longer
+ *      affected by any transaction in the undo log.
+ */
+void RS_MemoryStorage::releaseReferences(
+    TransactionMap::iterator first,
+    TransactionMap::iterator last,
+    std::set<RS_Object::Id>& unreferenced) {
+
+    TransactionMap::iterator it;
+    for (it=first; it!=last; ++it) {
+        const RS_DbsIdSet& affectedObjects = it->second.affectedObjects;
+        RS_DbsIdSet::const_iterator idIt;
+        for (idIt=affectedObjects.begin(); idIt!=affectedObjects.end(); ++idIt) {
+            if (*idIt<0 || *idIt>=(RS_Object::Id)references.size()) {
+                continue;
+            }
+            if (--references[*idIt]==0) {
+                unreferenced.insert(*idIt);
+            }
+        }
+        undoLogSize -= it->second.size;
+    }
+
+    transactions.erase(first, last);
+}
+
+
+
+/**
+ * Deletes all transactions with an ID of \c transactionId or higher
+ * (the redo branch). Objects that are only referenced by deleted
+ * transactions are orphaned and deleted permanently.
+ */
+void RS_MemoryStorage::deleteTransactionsFrom(int transactionId) {
+    std::set<RS_Object::Id> orphans;
+    releaseReferences(
+        transactions.lower_bound(transactionId), transactions.end(), orphans
+    );
+
+    RS_Debug::debug("RS_MemoryStorage::deleteTransactionsFrom: "
+        "delete %d orphaned objects", (int)orphans.size());
+
+    deleteObjects(orphans);
+}
+
+
+
+/**
+ * \return ID of the newest transaction in the undo log or 0 if the
+ *      log is empty, like RS_DbStorage.
+ */
+int RS_MemoryStorage::getMaxTransactionId() {
+    if (transactions.empty()) {
+        return 0;
+    }
+    return transactions.rbegin()->first;
+}
+
+
+
+/**
+ * \return ID of the oldest transaction that is still in the undo log or
+ *      -1 if the log is empty.
+ */
+int RS_MemoryStorage::getMinTransactionId() {
+    if (transactions.empty()) {
+        return -1;
+    }
+    return transactions.begin()->first;
+}
+
+
+
+/**
+ * Sets the undo budget. If the undo log grows beyond the budget, the
+ * oldest transactions are dropped (see \ref compactUndoLog).
+ *
+ * \param maxSteps Maximum number of transactions or 0 for no limit.
+ * \param maxBytes Maximum size of the undo log in bytes or 0 for no
+ *      limit.
+ */
+void RS_MemoryStorage::setUndoBudget(int maxSteps, long long maxBytes) {
+    maxUndoSteps = maxSteps;
+    maxUndoBytes = maxBytes;
+}
+
+
+
+/**
+ * Drops the oldest transactions until the undo log fits into the undo
+ * budget. Only transactions that have been applied are dropped, the
+ * redo branch is never touched.
+ *
+ * \see RS_DbStorage::compactUndoLog
+ */
+void RS_MemoryStorage::compactUndoLog() {
+    if (maxUndoSteps<=0 && maxUndoBytes<=0) {
+        return;
+    }
+
+    int steps = getUndoSteps();
+    long long bytes = getUndoLogSize();
+
+    // find first transaction to keep:
+    int firstKept = -1;
+    TransactionMap::iterator it;
+    for (it=transactions.begin();
+         it!=transactions.end() && it->first<=lastTransactionId; ++it) {
+
+        if ((maxUndoSteps<=0 || steps<=maxUndoSteps) &&
+            (maxUndoBytes<=0 || bytes<=maxUndoBytes)) {
+            break;
+        }
+        firstKept = it->first + 1;
+        steps--;
+        bytes -= it->second.size;
+    }
+
+    if (firstKept!=-1) {
+        deleteTransactionsBefore(firstKept);
+    }
+}
+
+
+
+/**
+ * Deletes all transactions with an ID lower than \c transactionId.
+ * Objects that are undone and not affected by any of the remaining
+ * transactions can never be restored and are deleted permanently.
+ */
+void RS_MemoryStorage::deleteTransactionsBefore(int transactionId) {
+    std::set<RS_Object::Id> unreferenced;
+    releaseReferences(
+        transactions.begin(), transactions.lower_bound(transactionId), unreferenced
+    );
+
+    std::set<RS_Object::Id> deadObjects;
+    std::set<RS_Object::Id>::iterator it;
+    for (it=unreferenced.begin(); it!=unreferenced.end(); ++it) {
+        if (contains(*it) && undoStatus[*it]!=0) {
+            deadObjects.insert(deadObjects.end(), *it);
+        }
+    }
+
+    RS_Debug::debug("RS_MemoryStorage::deleteTransactionsBefore: "
+        "purge %d dead objects", (int)deadObjects.size());
+
+    deleteObjects(deadObjects);
+}
+
+
+
+void RS_MemoryStorage::toggleUndoStatus(std::set<RS_Object::Id>& objects) {
+    std::set<RS_Object::Id>::iterator it;
+    for (it=objects.begin(); it!=objects.end(); ++it) {
+        toggleUndoStatus(*it);
+    }
+}
+
+
+
+void RS_MemoryStorage::toggleUndoStatus(const RS_DbsIdSet& objects) {
+    RS_DbsIdSet::const_iterator it;
+    for (it=objects.begin(); it!=objects.end(); ++it) {
+        toggleUndoStatus(*it);
+    }
+}
+
+
+
+/**
+ * Toggles the undo status of the given object and updates the document
+ * bounding box. IDs that are not in use are ignored.
+ */
+void RS_MemoryStorage::toggleUndoStatus(RS_Object::Id objectId) {
+    if (!contains(objectId)) {
+        return;
+    }
+
+    RS_Vector minV;
+    RS_Vector maxV;
+    if (isVisibleEntity(objectId)) {
+        // entity is about to be undone:
+        getEntityBoundingBox(objectId, minV, maxV);
+        shrinkBoundingBox(minV, maxV);
+    }
+
+    undoStatus[objectId] = !undoStatus[objectId];
+
+    if (isVisibleEntity(objectId)) {
+        // entity was restored:
+        getEntityBoundingBox(objectId, minV, maxV);
+        growBoundingBox(minV, maxV);
+    }
+}
+
+
+
+/**
+ * \return true if the given object is undone or does not exist.
+ */
+bool RS_MemoryStorage::getUndoStatus(RS_Object::Id objectId) {
+    if (!contains(objectId)) {
+        return true;
+    }
+    return undoStatus[objectId]!=0;
+}
+
+
+
+/**
+ * \return Table that stores objects of the given type or tableNone.
+ */
+RS_MemoryStorage::Table RS_MemoryStorage::getTable(RS_Object::ObjectTypeId objectTypeId) {
+    if (objectTypeId==RS_LineEntity::getObjectTypeIdStatic()) {
+        return tableLine;
+    }
+    if (objectTypeId==RS_Ucs::getObjectTypeIdStatic()) {
+        return tableUcs;
+    }
+    return tableNone;
+}
+
+
+
+/**
+ * Appends a new object to the object and entity columns.
+ *
+ * \return ID of the new object.
+ */
+RS_Object::Id RS_MemoryStorage::addObject(Table table, int row) {
+    double nan = std::numeric_limits<double>::quiet_NaN();
+
+    RS_Object::Id objectId = (RS_Object::Id)tables.size();
+    tables.push_back(table);
+    rows.push_back(row);
+    undoStatus.push_back(0);
+    minX.push_back(nan);
+    minY.push_back(nan);
+    minZ.push_back(nan);
+    maxX.push_back(nan);
+    maxY.push_back(nan);
+    maxZ.push_back(nan);
+    if (objectId/blockSize>=(RS_Object::Id)blockMinX.size()) {
+        addBlock();
+    }
+
+    switch (table) {
+    case tableLine:
+        lineIds[row] = objectId;
+        break;
+    case tableUcs:
+        ucsIds[row] = objectId;
+        break;
+    default:
+        break;
+    }
+
+    objectCount++;
+    return objectId;
+}
+
+
+
+/**
+ * Marks the given ID as unused. Unused IDs at the end of the columns
+ * are dropped, so the next new object gets the highest ID in use plus
+ * one, like in RS_DbStorage.
+ */
+void RS_MemoryStorage::removeObject(RS_Object::Id objectId) {
+    double nan = std::numeric_limits<double>::quiet_NaN();
+
+    tables[objectId] = tableNone;
+    rows[objectId] = -1;
+    undoStatus[objectId] = 0;
+    minX[objectId] = nan;
+    minY[objectId] = nan;
+    minZ[objectId] = nan;
+    maxX[objectId] = nan;
+    maxY[objectId] = nan;
+    maxZ[objectId] = nan;
+    objectCount--;
+
+    size_t n = tables.size();
+    while (n>1 && tables[n-1]==tableNone) {
+        n--;
+    }
+    if (n<tables.size()) {
+        tables.resize(n);
+        rows.resize(n);
+        undoStatus.resize(n);
+        minX.resize(n);
+        minY.resize(n);
+        minZ.resize(n);
+        maxX.resize(n);
+        maxY.resize(n);
+        maxZ.resize(n);
+
+        size_t blocks = (n + blockSize - 1) / blockSize;
+        blockMinX.resize(blocks);
+        blockMinY.resize(blocks);
+        blockMinZ.resize(blocks);
+        blockMaxX.resize(blocks);
+        blockMaxY.resize(blocks);
+        blockMaxZ.resize(blocks);
+    }
+}
+
+
+
+/**
+ * Appends an empty row to the block columns.
+ */
+void RS_MemoryStorage::addBlock() {
+    double nan = std::numeric_limits<double>::quiet_NaN();
+
+    blockMinX.push_back(nan);
+    blockMinY.push_back(nan);
+    blockMinZ.push_back(nan);
+    blockMaxX.push_back(nan);
+    blockMaxY.push_back(nan);
+    blockMaxZ.push_back(nan);
+}
+
+
+
+void RS_MemoryStorage::setEntityBoundingBox(RS_Entity::Id entityId, const RS_Box& box) {
+    RS_Vector c1 = box.getDefiningCorner1();
+    RS_Vector c2 = box.getDefiningCorner2();
+    minX[entityId] = std::min(c1.x, c2.x);
+    minY[entityId] = std::min(c1.y, c2.y);
+    minZ[entityId] = std::min(c1.z, c2.z);
+    maxX[entityId] = std::max(c1.x, c2.x);
+    maxY[entityId] = std::max(c1.y, c2.y);
+    maxZ[entityId] = std::max(c1.z, c2.z);
+
+    int b = entityId / blockSize;
+    if (blockMinX[b]!=blockMinX[b]) {
+        // first entity in this block (NaN):
+        blockMinX[b] = minX[entityId];
+        blockMinY[b] = minY[entityId];
+        blockMinZ[b] = minZ[entityId];
+        blockMaxX[b] = maxX[entityId];
+        blockMaxY[b] = maxY[entityId];
+        blockMaxZ[b] = maxZ[entityId];
+        return;
+    }
+
+    blockMinX[b] = std::min(blockMinX[b], minX[entityId]);
+    blockMinY[b] = std::min(blockMinY[b], minY[entityId]);
+    blockMinZ[b] = std::min(blockMinZ[b], minZ[entityId]);
+    blockMaxX[b] = std::max(blockMaxX[b], maxX[entityId]);
+    blockMaxY[b] = std::max(blockMaxY[b], maxY[entityId]);
+    blockMaxZ[b] = std::max(blockMaxZ[b], maxZ[entityId]);
+}
+
+
+
+void RS_MemoryStorage::getEntityBoundingBox(
+    RS_Entity::Id entityId, RS_Vector& minV, RS_Vector& maxV) const {
+
+    minV = RS_Vector(minX[entityId], minY[entityId], minZ[entityId]);
+    maxV = RS_Vector(maxX[entityId], maxY[entityId], maxZ[entityId]);
+}
+
+
+
+/**
+ * Appends a row for the given line to the line columns. The ID is set
+ * by \ref addObject.
+ *
+ * \return Row index.
+ */
+int RS_MemoryStorage::addLine(RS_LineEntity& line) {
+    int row = (int)lineIds.size();
+    lineIds.push_back(-1);
+    x1.push_back(0.0);
+    y1.push_back(0.0);
+    z1.push_back(0.0);
+    x2.push_back(0.0);
+    y2.push_back(0.0);
+    z2.push_back(0.0);
+    setLine(row, line);
+    return row;
+}
+
+
+
+void RS_MemoryStorage::setLine(int row, RS_LineEntity& line) {
+    const RS_LineData& data = line.getData();
+    x1[row] = data.startPoint.x;
+    y1[row] = data.startPoint.y;
+    z1[row] = data.startPoint.z;
+    x2[row] = data.endPoint.x;
+    y2[row] = data.endPoint.y;
+    z2[row] = data.endPoint.z;
+}
+
+
+
+/**
+ * Removes the given row from the line columns by moving the last row
+ * into its place.
+ */
+void RS_MemoryStorage::removeLine(int row) {
+    int last = (int)lineIds.size() - 1;
+    if (row!=last) {
+        lineIds[row] = lineIds[last];
+        x1[row] = x1[last];
+        y1[row] = y1[last];
+        z1[row] = z1[last];
+        x2[row] = x2[last];
+        y2[row] = y2[last];
+        z2[row] = z2[last];
+        rows[lineIds[row]] = row;
+    }
+    lineIds.pop_back();
+    x1.pop_back();
+    y1.pop_back();
+    z1.pop_back();
+    x2.pop_back();
+    y2.pop_back();
+    z2.pop_back();
+}
+
+
+
+/**
+ * Appends a row for the given UCS to the UCS columns.
+ *
+ * \return Row index.
+ */
+int RS_MemoryStorage::addUcs(RS_Ucs& ucs) {
+    int row = (int)ucsIds.size();
+    ucsIds.push_back(-1);
+    ucsNames.push_back(std::string());
+    ucsOrigins.push_back(RS_Vector());
+    ucsXAxisDirections.push_back(RS_Vector());
+    ucsYAxisDirections.push_back(RS_Vector());
+    setUcs(row, ucs);
+    return row;
+}
+
+
+
+/**
+ * \return Row of the UCS with the given name or -1. Documents have
+ *      only a few UCS, so the names are searched linearly.
+ */
+int RS_MemoryStorage::getUcsRow(const std::string& ucsName) const {
+    for (unsigned int row=0; row<ucsNames.size(); row++) {
+        if (ucsNames[row]==ucsName) {
+            return (int)row;
+        }
+    }
+    return -1;
+}
+
+
+
+void RS_MemoryStorage::setUcs(int row, RS_Ucs& ucs) {
+    ucsNames[row] = ucs.name;
+    ucsOrigins[row] = ucs.origin;
+    ucsXAxisDirections[row] = ucs.xAxisDirection;
+    ucsYAxisDirections[row] = ucs.yAxisDirection;
+}
+
+
+
+/**
+ * Removes the given row from the UCS columns by moving the last row
+ * into its place.
+ */
+void RS_MemoryStorage::removeUcs(int row) {
+    int last = (int)ucsIds.size() - 1;
+    if (row!=last) {
+        ucsIds[row] = ucsIds[last];
+        ucsNames[row] = ucsNames[last];
+        ucsOrigins[row] = ucsOrigins[last];
+        ucsXAxisDirections[row] = ucsXAxisDirections[last];
+        ucsYAxisDirections[row] = ucsYAxisDirections[last];
+        rows[ucsIds[row]] = row;
+    }
+    ucsIds.pop_back();
+    ucsNames.pop_back();
+    ucsOrigins.pop_back();
+    ucsXAxisDirections.pop_back();
+    ucsYAxisDirections.pop_back();
+}
@@ -0,0 +1,367 @@
+#ifndef RS_MEMORYSTORAGE_H
+#define RS_MEMORYSTORAGE_H
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "RS_AbstractStorage"
+#include "RS_Transaction"
+#include "RS_DbsIdSet"
+#include "RS_DbsIdVisitor"
+#include "RS_DbsSelection"
+
+class RS_LineEntity;
+
+
+
+/**
+ * A memory storage object implements the storage interface without a
+ * DB. It is an alternative to RS_DbStorage for interactive sessions
+ * that do not need the document to be durable: every query and update
+ * is a direct access to a few arrays instead of an SQL statement.
+ *
+ * The data is stored in columns (struct of arrays) that correspond to
+ * the tables of RS_DbStorage:
+ *
+ * \b Object columns, indexed by object ID:
+ * - \b table: Type table that stores the object or \c tableNone for
+ *          IDs that are not in use.
+ * - \b row: Row of the object in its type table.
+ * - \b undoStatus: 1 for objects that are undone.
+ *
+ * \b Entity columns, indexed by object ID:
+ * - \b minX, \b minY, \b minZ, \b maxX, \b maxY, \b maxZ: Bounding box
+ *          of the entity or NaN for IDs that are not entities, so that
+ *          every comparison in a box query fails for them.
+ *
+ * \b Block columns, one row per block of \ref blockSize consecutive IDs:
+ * - \b blockMinX ... \b blockMaxZ: Box that contains the bounding boxes
+ *          of all entities that were stored in the block or NaN. Box
+ *          queries skip blocks that do not intersect the query box. The
+ *          block boxes only grow and are reset when the block is
+ *          dropped, so they can be larger than necessary.
+ *
+ * \b Line columns, one row per line:
+ * - \b id: Entity ID.
+ * - \b x1, \b y1, \b z1, \b x2, \b y2, \b z2: Start and end point.
+ *
+ * \b Ucs columns, one row per UCS:
+ * - \b id, \b name, \b origin, \b xAxisDirection, \b yAxisDirection.
+ *
+ * Object IDs are assigned densely like in RS_DbStorage (highest ID in
+ * use plus one), so the object and entity columns have no holes except
+ * for deleted objects. Rows are removed from the type tables by moving
+ * the last row into the gap.
+ *
+ * Box queries scan the block columns and the entity columns of matching
+ * blocks sequentially and return IDs in ascending order. Entities that
+ * are close to each other usually have IDs that are close to each other
+ * (drawings are imported and drawn area by area), so most blocks are
+ * skipped. For documents where this is not the case, the cost of a box
+ * query grows linearly with the number of entities.
+ *
+ * Transactions and undo / redo behave like in RS_DbStorage, including
+ * the purging of orphaned objects and the undo budget. The undo log
+ * keeps the property changes as they are. The undo log size is
+ * estimated from the number of affected objects and property changes.
+ *
+ * Only lines and UCS can be stored. Objects of other types are
+ * rejected with an error.
+ *
+ * All functions of a storage must be called from the same thread.
+ *
+ * \author Andrew Mustun
+ * \ingroup qcaddbstorage
+ */
+class RS_MemoryStorage : public RS_AbstractStorage {
+public:
+    RS_MemoryStorage();
+    virtual ~RS_MemoryStorage();
+
+    virtual void queryAllObjects(std::set<RS_Object::Id>& result);
+    virtual void queryAllEntities(std::set<RS_Entity::Id>& result);
+    virtual void queryAllUcs(std::set<RS_Ucs::Id>& result);
+
+    virtual void querySelectedEntities(std::set<RS_Entity::Id>& result);
+
+    void queryAllObjects(RS_DbsIdVisitor& visitor);
+    void queryAllEntities(RS_DbsIdVisitor& visitor);
+    void queryAllUcs(RS_DbsIdVisitor& visitor);
+    void querySelectedEntities(RS_DbsIdVisitor& visitor);
+
+    void queryAllObjects(RS_DbsIdSet& result);
+    void queryAllEntities(RS_DbsIdSet& result);
+    void queryAllUcs(RS_DbsIdSet& result);
+    void querySelectedEntities(RS_DbsIdSet& result);
+    void queryEntitiesInBox(
+        const RS_Box& box,
+        RS_DbsIdSet& result,
+        bool inside=false
+    );
+
+    virtual void queryEntitiesInBox(
+        const RS_Box& box,
+        std::set<RS_Entity::Id>& result,
+        bool inside=false
+    );
+
+    virtual RS_Object* queryObject(RS_Object::Id objectId);
+    virtual RS_Entity* queryEntity(RS_Entity::Id entityId);
+    virtual RS_Ucs* queryUcs(RS_Ucs::Id ucsId);
+    virtual RS_Ucs* queryUcs(const std::string& ucsName);
+
+    virtual void queryObjects(
+        std::set<RS_Object::Id>& objectIds,
+        std::vector<RS_Object*>& result
+    );
+    virtual void queryEntities(
+        std::set<RS_Entity::Id>& entityIds,
+        std::vector<RS_Entity*>& result
+    );
+
+    virtual void clearEntitySelection(
+        std::set<RS_Entity::Id>* affectedEntities=NULL
+    );
+
+    virtual void selectEntity(
+        RS_Entity::Id entityId,
+        bool add=false,
+        std::set<RS_Entity::Id>* affectedEntities=NULL
+    );
+    virtual void selectEntities(
+        std::set<RS_Entity::Id>& entityIds,
+        bool add=false,
+        std::set<RS_Entity::Id>* affectedEntities=NULL
+    );
+    void selectEntities(
+        const RS_DbsIdSet& entityIds,
+        bool add=false,
+        RS_DbsIdSet* affectedEntities=NULL
+    );
+
+    virtual RS_Box getBoundingBox();
+
+    virtual void saveObject(RS_Object& object);
+    virtual void saveObjects(std::vector<RS_Object*>& objects);
+    virtual void deleteObject(RS_Object::Id objectId);
+    virtual void deleteObjects(std::set<RS_Object::Id>& objectIds);
+
+    virtual void beginTransaction();
+    virtual void commitTransaction();
+
+    virtual int getLastTransactionId();
+    virtual void setLastTransactionId(int transactionId);
+    virtual void saveTransaction(RS_Transaction& transaction);
+    virtual void deleteTransactionsFrom(int transactionId);
+    virtual RS_Transaction getTransaction(int transactionId);
+    virtual int getMaxTransactionId();
+    int getMinTransactionId();
+
+    virtual void toggleUndoStatus(std::set<RS_Object::Id>& objectIds);
+    void toggleUndoStatus(const RS_DbsIdSet& objectIds);
+    virtual void toggleUndoStatus(RS_Object::Id objectId);
+    virtual bool getUndoStatus(RS_Object::Id objectId);
+
+    void setUndoBudget(int maxSteps, long long maxBytes);
+
+    /**
+     * \return Maximum number of transactions kept in the undo log or
+     *      0 for no limit.
+     */
+    int getMaxUndoSteps() const {
+        return maxUndoSteps;
+    }
+
+    /**
+     * \return Maximum size of the undo log in bytes or 0 for no limit.
+     */
+    long long getMaxUndoBytes() const {
+        return maxUndoBytes;
+    }
+
+    /**
+     * \return Approximate size of the undo log in bytes.
+     */
+    long long getUndoLogSize() const {
+        return undoLogSize;
+    }
+
+    /**
+     * \return Number of transactions in the undo log, including
+     *      transactions that can be redone.
+     */
+    int getUndoSteps() const {
+        return (int)transactions.size();
+    }
+
+    void compactUndoLog();
+
+    /**
+     * \return Number of objects in the storage, including objects
+     *      that are undone.
+     */
+    int getObjectCount() const {
+        return objectCount;
+    }
+
+protected:
+    enum Table {
+        tableNone = 0,
+        tableLine = 1,
+        tableUcs = 2
+    };
+
+    /**
+     * Entry of the undo log.
+     */
+    struct TransactionRecord {
+        TransactionRecord() : size(0) {}
+        std::string text;
+        RS_DbsIdSet affectedObjects;
+        std::multimap<RS_Object::Id, RS_PropertyChange> propertyChanges;
+        //! approximate size in bytes:
+        long long size;
+    };
+    typedef std::map<int, TransactionRecord> TransactionMap;
+
+    /**
+     * \return true if the given ID is in use.
+     */
+    bool contains(RS_Object::Id objectId) const {
+        return objectId>0 &&
+            objectId<(RS_Object::Id)tables.size() &&
+            tables[objectId]!=tableNone;
+    }
+
+    /**
+     * \return true if the given object exists, is not undone and is
+     *      an entity.
+     */
+    bool isVisibleEntity(RS_Object::Id objectId) const {
+        return contains(objectId) &&
+            tables[objectId]==tableLine &&
+            undoStatus[objectId]==0;
+    }
+
+    static Table getTable(RS_Object::ObjectTypeId objectTypeId);
+
+    RS_Object::Id addObject(Table table, int row);
+    void removeObject(RS_Object::Id objectId);
+    void addBlock();
+
+    void setEntityBoundingBox(RS_Entity::Id entityId, const RS_Box& box);
+    void getEntityBoundingBox(RS_Entity::Id entityId, RS_Vector& minV, RS_Vector& maxV) const;
+
+    int addLine(RS_LineEntity& line);
+    void setLine(int row, RS_LineEntity& line);
+    void removeLine(int row);
+
+    int addUcs(RS_Ucs& ucs);
+    int getUcsRow(const std::string& ucsName) const;
+    void setUcs(int row, RS_Ucs& ucs);
+    void removeUcs(int row);
+
+    void scanEntitiesInBox(
+        const RS_Box& box,
+        bool inside,
+        std::vector<RS_Entity::Id>& result
+    );
+
+    void updateSelectionStatus(RS_Object* object);
+
+    void growBoundingBox(const RS_Vector& minV, const RS_Vector& maxV);
+    void shrinkBoundingBox(const RS_Vector& minV, const RS_Vector& maxV);
+
+    void releaseReferences(
+        TransactionMap::iterator first,
+        TransactionMap::iterator last,
+        std::set<RS_Object::Id>& unreferenced
+    );
+    void deleteTransactionsBefore(int transactionId);
+
+    /**
+     * Number of consecutive IDs summarized by one row of the block
+     * columns.
+     */
+    static const int blockSize = 64;
+
+    /**
+     * Approximate cost in bytes of one affected object of a transaction.
+     * Same as in RS_DbStorage.
+     */
+    static const int bytesPerAffectedObject = 16;
+
+    /**
+     * Approximate cost in bytes of one property change in the undo log.
+     */
+    static const int bytesPerPropertyChange = 24;
+
+private:
+    //! object columns, indexed by object ID:
+    std::vector<unsigned char> tables;
+    std::vector<int> rows;
+    std::vector<unsigned char> undoStatus;
+    //! number of objects in use:
+    int objectCount;
+
+    //! entity columns, indexed by object ID:
+    std::vector<double> minX;
+    std::vector<double> minY;
+    std::vector<double> minZ;
+    std::vector<double> maxX;
+    std::vector<double> maxY;
+    std::vector<double> maxZ;
+
+    //! block columns, indexed by object ID / blockSize:
+    std::vector<double> blockMinX;
+    std::vector<double> blockMinY;
+    std::vector<double> blockMinZ;
+    std::vector<double> blockMaxX;
+    std::vector<double> blockMaxY;
+    std::vector<double> blockMaxZ;
+
+    //! line columns:
+    std::vector<RS_Entity::Id> lineIds;
+    std::vector<double> x1;
+    std::vector<double> y1;
+    std::vector<double> z1;
+    std::vector<double> x2;
+    std::vector<double> y2;
+    std::vector<double> z2;
+
+    //! UCS columns:
+    std::vector<RS_Ucs::Id> ucsIds;
+    std::vector<std::string> ucsNames;
+    std::vector<RS_Vector> ucsOrigins;
+    std::vector<RS_Vector> ucsXAxisDirections;
+    std::vector<RS_Vector> ucsYAxisDirections;
+
+    //! selection status of all entities:
+    RS_DbsSelection selection;
+
+    //! bounding box of all entities that are not undone:
+    RS_Vector boundingBoxMin;
+    RS_Vector boundingBoxMax;
+    //! true if the document has no entities that are not undone:
+    bool boundingBoxEmpty;
+    //! false if the bounding box has to be recomputed:
+    bool boundingBoxValid;
+
+    //! undo log by transaction ID:
+    TransactionMap transactions;
+    //! number of transactions in the undo log that affect an object,
+    //! indexed by object ID. Like the AffectedObjects table of
+    //! RS_DbStorage, this is kept when an object is deleted:
+    std::vector<int> references;
+    int lastTransactionId;
+
+    //! undo budget, 0 for no limit:
+    int maxUndoSteps;
+    long long maxUndoBytes;
+    //! approximate size of the undo log in bytes:
+    long long undoLogSize;
+};
+
+#endif
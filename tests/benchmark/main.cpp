@@ -0,0 +1,164 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "rs_dbsbenchmark.h"
+#include "RS_DbsObjectTypeRegistry"
+#include "RS_DbsStatistics"
+
+
+
+static void usage() {
+    fprintf(stderr,
+        "Usage: qcaddbstorage_benchmark [options]\n"
+        "\n"
+        "  --backends=LIST  Comma separated list of sqlite, sqlite-file\n"
+        "                   and memory (default: sqlite,memory)\n"
+        "  --sizes=LIST     Comma separated list of document sizes\n"
+        "                   (default: 10000,100000,1000000)\n"
+        "  --options=NAME   Preset of the SQLite backends: interactive,\n"
+        "                   bulk or default (default: interactive)\n"
+        "  --format=FORMAT  json or csv (default: json)\n"
+        "  --seed=N         Seed of the random numbers (default: 1)\n"
+        "  --output=FILE    Write results to FILE instead of stdout\n"
+    );
+}
+
+
+
+static std::vector<std::string> split(const std::string& str) {
+    std::vector<std::string> ret;
+    std::string::size_type start = 0;
+    while (start<=str.size()) {
+        std::string::size_type end = str.find(',', start);
+        if (end==std::string::npos) {
+            end = str.size();
+        }
+        if (end>start) {
+            ret.push_back(str.substr(start, end-start));
+        }
+        start = end + 1;
+    }
+    return ret;
+}
+
+
+
+static bool getOption(const char* arg, const char* name, std::string& value) {
+    size_t len = strlen(name);
+    if (strncmp(arg, name, len)!=0 || arg[len]!='=') {
+        return false;
+    }
+    value = arg + len + 1;
+    return true;
+}
+
+
+
+/**
+ * Runs the storage benchmark (see RS_DbsBenchmark) for all given
+ * backends and document sizes and writes the results as JSON or CSV.
+ * Progress is reported on stderr.
+ */
+int main(int argc, char** argv) {
+    std::vector<std::string> backends = split("sqlite,memory");
+    std::vector<std::string> sizes = split("10000,100000,1000000");
+    std::string options = "interactive";
+    std::string format = "json";
+    std::string outputFile;
+    unsigned int seed = 1;
+
+    for (int i=1; i<argc; i++) {
+        std::string value;
+        if (getOption(argv[i], "--backends", value)) {
+            backends = split(value);
+        }
+        else if (getOption(argv[i], "--sizes", value)) {
+            sizes = split(value);
+        }
+        else if (getOption(argv[i], "--options", value)) {
+            options = value;
+        }
+        else if (getOption(argv[i], "--format", value)) {
+            format = value;
+        }
+        else if (getOption(argv[i], "--seed", value)) {
+            seed = (unsigned int)strtoul(value.c_str(), NULL, 10);
+        }
+        else if (getOption(argv[i], "--output", value)) {
+            outputFile = value;
+        }
+        else {
+            usage();
+            return 1;
+        }
+    }
+
+    if (format!="json" && format!="csv") {
+        usage();
+        return 1;
+    }
+    if (!RS_DbsBenchmark::isOptions(options)) {
+        fprintf(stderr, "unknown options: %s\n", options.c_str());
+        return 1;
+    }
+    for (unsigned int i=0; i<backends.size(); i++) {
+        if (!RS_DbsBenchmark::isBackend(backends[i])) {
+            fprintf(stderr, "unknown backend: %s\n", backends[i].c_str());
+            return 1;
+        }
+    }
+
+    RS_DbsObjectTypeRegistry::registerStandardObjectTypes();
+
+    std::vector<RS_DbsBenchmark::Result> results;
+    for (unsigned int s=0; s<sizes.size(); s++) {
+        int size = atoi(sizes[s].c_str());
+        if (size<=0) {
+            fprintf(stderr, "invalid size: %s\n", sizes[s].c_str());
+            return 1;
+        }
+
+        for (unsigned int b=0; b<backends.size(); b++) {
+            fprintf(stderr, "%s, %d entities...\n", backends[b].c_str(), size);
+            double start = RS_DbsStatistics::now();
+
+            // every backend gets the same sequence of operations:
+            RS_DbsBenchmark benchmark(backends[b], options, size, seed);
+            benchmark.run();
+            results.insert(
+                results.end(),
+                benchmark.getResults().begin(),
+                benchmark.getResults().end()
+            );
+
+            fprintf(stderr, "%s, %d entities: %.1fs\n",
+                backends[b].c_str(), size, RS_DbsStatistics::now() - start);
+        }
+    }
+
+    FILE* fp = stdout;
+    if (!outputFile.empty()) {
+        fp = fopen(outputFile.c_str(), "w");
+        if (fp==NULL) {
+            fprintf(stderr, "cannot write %s\n", outputFile.c_str());
+            return 1;
+        }
+    }
+
+    if (format=="json") {
+        RS_DbsBenchmark::writeJson(fp, results, seed);
+    }
+    else {
+        RS_DbsBenchmark::writeCsv(fp, results);
+    }
+
+    if (fp!=stdout) {
+        fclose(fp);
+    }
+
+    RS_DbsObjectTypeRegistry::cleanUp();
+    return 0;
+}
@@ -0,0 +1,530 @@
+#include <algorithm>
+#include <map>
+#include <set>
+
+#include "rs_dbsbenchmark.h"
+#include "RS_DbStorage"
+#include "RS_LineEntity"
+#include "RS_MemoryStorage"
+#include "RS_Transaction"
+
+// document file of the sqlite-file backend:
+static const char* fileName = "qcaddbstorage_benchmark.db";
+
+
+
+/**
+ * \param backend "sqlite" (RS_DbStorage with an in-memory DB),
+ *      "sqlite-file" (RS_DbStorage with a DB file in the current
+ *      directory) or "memory" (RS_MemoryStorage).
+ * \param options Preset of RS_DbStorageOptions for the SQLite backends:
+ *      "interactive", "bulk" or "default".
+ * \param size Number of line entities in the document.
+ * \param seed Seed of the random numbers.
+ */
+RS_DbsBenchmark::RS_DbsBenchmark(
+    const std::string& backend, const std::string& options, 
+    int size, unsigned int seed)
+    : backend(backend),
+      options(options),
+      size(size),
+      state(seed),
+      cornerId(-1),
+      startTime(0.0) {
+}
+
+
+
+/**
+ * \return true if the given backend name is known.
+ */
+bool RS_DbsBenchmark::isBackend(const std::string& backend) {
+    return backend=="sqlite" || backend=="sqlite-file" || backend=="memory";
+}
+
+
+
+/**
+ * \return true if the given preset name is known.
+ */
+bool RS_DbsBenchmark::isOptions(const std::string& options) {
+    return options=="interactive" || options=="bulk" || options=="default";
+}
+
+
+
+/**
+ * Runs all scenarios in order. Every scenario works on the document
+ * as left by the previous scenarios.
+ *
+ * \return false if the backend is unknown.
+ */
+bool RS_DbsBenchmark::run() {
+    RS_AbstractStorage* storage = createStorage();
+    if (storage==NULL) {
+        return false;
+    }
+
+    // the batch operations are not part of RS_AbstractStorage:
+    RS_DbStorage* dbStorage = dynamic_cast<RS_DbStorage*>(storage);
+    if (dbStorage!=NULL) {
+        runScenarios(*dbStorage);
+    }
+    else {
+        runScenarios(*dynamic_cast<RS_MemoryStorage*>(storage));
+    }
+
+    delete storage;
+    if (backend=="sqlite-file") {
+        RS_DbStorage::removeFiles(fileName);
+    }
+    return true;
+}
+
+
+
+RS_AbstractStorage* RS_DbsBenchmark::createStorage() {
+    RS_DbStorageOptions dbOptions;
+    if (options=="interactive") {
+        dbOptions = RS_DbStorageOptions::getInteractive();
+    }
+    else if (options=="bulk") {
+        dbOptions = RS_DbStorageOptions::getBulkImport();
+    }
+
+    if (backend=="sqlite") {
+        return new RS_DbStorage(":memory:", dbOptions);
+    }
+    if (backend=="sqlite-file") {
+        RS_DbStorage::removeFiles(fileName);
+        return new RS_DbStorage(fileName, dbOptions);
+    }
+    if (backend=="memory") {
+        return new RS_MemoryStorage();
+    }
+    return NULL;
+}
+
+
+
+template <class Storage>
+void RS_DbsBenchmark::runScenarios(Storage& storage) {
+    benchSaveObject(storage);
+    benchQueryEntity(storage);
+    benchQueryEntities(storage);
+    benchQueryEntitiesInBox(storage);
+    benchQueryAllEntities(storage);
+    benchSelectEntity(storage);
+    benchSelectEntities(storage);
+    benchGetBoundingBox(storage);
+    benchSaveTransaction(storage);
+    benchGetTransaction(storage);
+    benchUndoRedo(storage);
+    benchDeleteTransactionsFrom(storage);
+    benchSaveObjects(storage);
+}
+
+
+
+/**
+ * Fills the document with a grid of short lines, 1000 per row.
+ */
+void RS_DbsBenchmark::benchSaveObject(RS_AbstractStorage& storage) {
+    entityIds.reserve(size);
+
+    for (int i=0; i<size; i++) {
+        RS_LineData data;
+        data.startPoint = RS_Vector(i%1000, i/1000);
+        data.endPoint = RS_Vector(i%1000 + 0.8, i/1000 + 0.8);
+        RS_LineEntity line(data);
+
+        start();
+        if (i%1000==0) {
+            storage.beginTransaction();
+        }
+        storage.saveObject(line);
+        if (i%1000==999 || i==size-1) {
+            storage.commitTransaction();
+        }
+        stop();
+
+        entityIds.push_back(line.getId());
+    }
+
+    cornerId = entityIds.front();
+    addResult("saveObject");
+}
+
+
+
+void RS_DbsBenchmark::benchQueryEntity(RS_AbstractStorage& storage) {
+    for (int i=0; i<10000; i++) {
+        RS_Object::Id id = randomEntity();
+        start();
+        RS_Entity* entity = storage.queryEntity(id);
+        stop();
+        delete entity;
+    }
+    addResult("queryEntity");
+}
+
+
+
+template <class Storage>
+void RS_DbsBenchmark::benchQueryEntities(Storage& storage) {
+    for (int i=0; i<100; i++) {
+        std::set<RS_Entity::Id> ids;
+        for (int k=0; k<1000; k++) {
+            ids.insert(randomEntity());
+        }
+        std::vector<RS_Entity*> entities;
+        start();
+        storage.queryEntities(ids, entities);
+        stop();
+        for (unsigned int k=0; k<entities.size(); k++) {
+            delete entities[k];
+        }
+    }
+    addResult("queryEntities");
+}
+
+
+
+/**
+ * Queries boxes at random positions of the grid of lines.
+ */
+template <class Storage>
+void RS_DbsBenchmark::benchQueryEntitiesInBox(Storage& storage) {
+    int rows = (size + 999) / 1000;
+    for (int i=0; i<1000; i++) {
+        double x = random() % 1000;
+        double y = random() % rows;
+        RS_Box box(RS_Vector(x, y), RS_Vector(x + 20, y + 20));
+        std::set<RS_Entity::Id> ids;
+        start();
+        storage.queryEntitiesInBox(box, ids);
+        stop();
+    }
+    addResult("queryEntitiesInBox");
+}
+
+
+
+void RS_DbsBenchmark::benchQueryAllEntities(RS_AbstractStorage& storage) {
+    int n = getRepetitions(1000000, 3, 100);
+    for (int i=0; i<n; i++) {
+        std::set<RS_Entity::Id> ids;
+        start();
+        storage.queryAllEntities(ids);
+        stop();
+    }
+    addResult("queryAllEntities");
+}
+
+
+
+void RS_DbsBenchmark::benchSelectEntity(RS_AbstractStorage& storage) {
+    for (int i=0; i<10000; i++) {
+        RS_Object::Id id = randomEntity();
+        std::set<RS_Entity::Id> affected;
+        start();
+        storage.selectEntity(id, false, &affected);
+        stop();
+    }
+    addResult("selectEntity");
+}
+
+
+
+void RS_DbsBenchmark::benchSelectEntities(RS_AbstractStorage& storage) {
+    for (int i=0; i<100; i++) {
+        std::set<RS_Entity::Id> ids;
+        for (int k=0; k<1000; k++) {
+            ids.insert(randomEntity());
+        }
+        std::set<RS_Entity::Id> affected;
+        start();
+        storage.selectEntities(ids, false, &affected);
+        stop();
+    }
+    addResult("selectEntities");
+
+    storage.clearEntitySelection();
+}
+
+
+
+/**
+ * Undoes the line at the origin before every operation, so the
+ * bounding box has to be recomputed.
+ */
+void RS_DbsBenchmark::benchGetBoundingBox(RS_AbstractStorage& storage) {
+    int n = getRepetitions(10000000, 10, 1000);
+    for (int i=0; i<n; i++) {
+        storage.beginTransaction();
+        storage.toggleUndoStatus(cornerId);
+        storage.commitTransaction();
+
+        start();
+        storage.getBoundingBox();
+        stop();
+
+        storage.beginTransaction();
+        storage.toggleUndoStatus(cornerId);
+        storage.commitTransaction();
+    }
+    addResult("getBoundingBox");
+}
+
+
+
+/**
+ * Edits random lines the way an application does: the line is
+ * replaced by a moved copy and the original is undone. Only storing
+ * the transaction and committing is timed.
+ */
+void RS_DbsBenchmark::benchSaveTransaction(RS_AbstractStorage& storage) {
+    for (int i=0; i<edits; i++) {
+        int index = random() % entityIds.size();
+        RS_Object::Id id = entityIds[index];
+
+        storage.beginTransaction();
+
+        RS_Entity* entity = storage.queryEntity(id);
+        RS_LineEntity* line = dynamic_cast<RS_LineEntity*>(entity);
+        if (line==NULL) {
+            storage.commitTransaction();
+            delete entity;
+            continue;
+        }
+        line->setId(-1);
+        line->getData().startPoint.y += 0.1;
+        line->getData().endPoint.y += 0.1;
+        storage.saveObject(*line);
+        storage.toggleUndoStatus(id);
+
+        std::set<RS_Object::Id> affectedObjects;
+        affectedObjects.insert(id);
+        affectedObjects.insert(line->getId());
+        RS_Transaction transaction(
+            storage, -1, "move",
+            affectedObjects,
+            std::multimap<RS_Object::Id, RS_PropertyChange>()
+        );
+
+        start();
+        storage.saveTransaction(transaction);
+        storage.commitTransaction();
+        stop();
+
+        entityIds[index] = line->getId();
+        delete entity;
+    }
+    addResult("saveTransaction");
+}
+
+
+
+void RS_DbsBenchmark::benchGetTransaction(RS_AbstractStorage& storage) {
+    int last = storage.getLastTransactionId();
+    for (int i=0; i<10000 && last>=0; i++) {
+        int id = random() % (last + 1);
+        start();
+        storage.getTransaction(id);
+        stop();
+    }
+    addResult("getTransaction");
+}
+
+
+
+void RS_DbsBenchmark::benchUndoRedo(RS_AbstractStorage& storage) {
+    int n = storage.getLastTransactionId() + 1;
+
+    for (int i=0; i<n; i++) {
+        start();
+        undo(storage);
+        stop();
+    }
+    addResult("undo");
+
+    for (int i=0; i<n; i++) {
+        start();
+        redo(storage);
+        stop();
+    }
+    addResult("redo");
+}
+
+
+
+/**
+ * Undoes 10 transactions before every operation and drops them as
+ * redo branch, which also deletes the lines they created.
+ */
+void RS_DbsBenchmark::benchDeleteTransactionsFrom(RS_AbstractStorage& storage) {
+    while (storage.getLastTransactionId()>=10) {
+        for (int k=0; k<10; k++) {
+            undo(storage);
+        }
+
+        start();
+        storage.beginTransaction();
+        storage.deleteTransactionsFrom(storage.getLastTransactionId() + 1);
+        storage.commitTransaction();
+        stop();
+    }
+    addResult("deleteTransactionsFrom");
+}
+
+
+
+/**
+ * Adds a second grid of lines below the first one, in batches of 1000
+ * lines.
+ */
+template <class Storage>
+void RS_DbsBenchmark::benchSaveObjects(Storage& storage) {
+    for (int i=0; i<size; i+=1000) {
+        std::vector<RS_Object*> lines;
+        for (int k=i; k<size && k<i+1000; k++) {
+            RS_LineData data;
+            data.startPoint = RS_Vector(k%1000, -1 - k/1000);
+            data.endPoint = RS_Vector(k%1000 + 0.8, -1 - k/1000 + 0.8);
+            lines.push_back(new RS_LineEntity(data));
+        }
+
+        start();
+        storage.beginTransaction();
+        storage.saveObjects(lines);
+        storage.commitTransaction();
+        stop();
+
+        for (unsigned int k=0; k<lines.size(); k++) {
+            delete lines[k];
+        }
+    }
+    addResult("saveObjects");
+}
+
+
+
+void RS_DbsBenchmark::undo(RS_AbstractStorage& storage) {
+    storage.beginTransaction();
+    int last = storage.getLastTransactionId();
+    RS_Transaction transaction = storage.getTransaction(last);
+    std::set<RS_Object::Id> affectedObjects = transaction.getAffectedObjects();
+    storage.toggleUndoStatus(affectedObjects);
+    storage.setLastTransactionId(last - 1);
+    storage.commitTransaction();
+}
+
+
+
+void RS_DbsBenchmark::redo(RS_AbstractStorage& storage) {
+    storage.beginTransaction();
+    int next = storage.getLastTransactionId() + 1;
+    RS_Transaction transaction = storage.getTransaction(next);
+    std::set<RS_Object::Id> affectedObjects = transaction.getAffectedObjects();
+    storage.toggleUndoStatus(affectedObjects);
+    storage.setLastTransactionId(next);
+    storage.commitTransaction();
+}
+
+
+
+/**
+ * Computes the result of the given scenario from the latencies recorded
+ * since the last call.
+ */
+void RS_DbsBenchmark::addResult(const std::string& scenario) {
+    Result result;
+    result.backend = backend;
+    result.options = (backend=="memory" ? "" : options);
+    result.size = size;
+    result.scenario = scenario;
+    result.operations = (int)latencies.size();
+    result.seconds = 0.0;
+    result.operationsPerSecond = 0.0;
+    result.p50 = 0.0;
+    result.p99 = 0.0;
+    result.max = 0.0;
+
+    if (!latencies.empty()) {
+        for (unsigned int i=0; i<latencies.size(); i++) {
+            result.seconds += latencies[i];
+        }
+        std::sort(latencies.begin(), latencies.end());
+        if (result.seconds>0.0) {
+            result.operationsPerSecond = latencies.size() / result.seconds;
+        }
+        result.p50 = latencies[latencies.size() * 50 / 100] * 1.0e6;
+        result.p99 = latencies[latencies.size() * 99 / 100] * 1.0e6;
+        result.max = latencies.back() * 1.0e6;
+    }
+
+    results.push_back(result);
+    latencies.clear();
+}
+
+
+
+/**
+ * \return Next pseudo random number (LCG of Numerical Recipes).
+ */
+unsigned int RS_DbsBenchmark::random() {
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+}
+
+
+
+/**
+ * \return ID of a random line that is not undone.
+ */
+RS_Object::Id RS_DbsBenchmark::randomEntity() {
+    return entityIds[random() % entityIds.size()];
+}
+
+
+
+/**
+ * Writes the given results as JSON object with one array element per
+ * scenario. Latencies are in microseconds.
+ */
+void RS_DbsBenchmark::writeJson(FILE* fp, const std::vector<Result>& results, unsigned int seed) {
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"benchmark\": \"qcaddbstorage\",\n");
+    fprintf(fp, "  \"seed\": %u,\n", seed);
+    fprintf(fp, "  \"results\": [\n");
+    for (unsigned int i=0; i<results.size(); i++) {
+        const Result& r = results[i];
+        fprintf(fp,
+            "    {\"backend\": \"%s\", \"options\": \"%s\", \"size\": %d, "
+            "\"scenario\": \"%s\", "
+            "\"operations\": %d, \"seconds\": %.6f, \"opsPerSec\": %.1f, "
+            "\"p50Us\": %.2f, \"p99Us\": %.2f, \"maxUs\": %.2f}%s\n",
+            r.backend.c_str(), r.options.c_str(), r.size, r.scenario.c_str(),
+            r.operations, r.seconds, r.operationsPerSecond,
+            r.p50, r.p99, r.max,
+            i+1<results.size() ? "," : "");
+    }
+    fprintf(fp, "  ]\n");
+    fprintf(fp, "}\n");
+}
+
+
+
+/**
+ * Writes the given results as CSV with a header line.
+ */
+void RS_DbsBenchmark::writeCsv(FILE* fp, const std::vector<Result>& results) {
+    fprintf(fp, "backend,options,size,scenario,operations,seconds,opsPerSec,p50Us,p99Us,maxUs\n");
+    for (unsigned int i=0; i<results.size(); i++) {
+        const Result& r = results[i];
+        fprintf(fp, "%s,%s,%d,%s,%d,%.6f,%.1f,%.2f,%.2f,%.2f\n",
+            r.backend.c_str(), r.options.c_str(), r.size, r.scenario.c_str(),
+            r.operations, r.seconds, r.operationsPerSecond,
+            r.p50, r.p99, r.max);
+    }
+}
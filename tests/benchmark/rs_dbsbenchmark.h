@@ -0,0 +1,171 @@
+#ifndef RS_DBSBENCHMARK_H
+#define RS_DBSBENCHMARK_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "RS_AbstractStorage"
+#include "RS_DbsStatistics"
+#include "RS_Object"
+
+
+
+/**
+ * Repeatable benchmark of the storage operations. One benchmark runs
+ * all scenarios against one storage backend filled with a given number
+ * of line entities:
+ *
+ * - \b saveObject: Stores the lines one by one, in transactions of 1000
+ *          objects. The commit is part of the last operation of each
+ *          transaction.
+ * - \b queryEntity: Loads random entities.
+ * - \b queryEntities: Loads sets of 1000 random entities.
+ * - \b queryEntitiesInBox: Queries the IDs of the entities in random 
+ *          20x20 boxes, about 400 lines each.
+ * - \b queryAllEntities: Queries the IDs of all entities.
+ * - \b selectEntity: Selects random single entities.
+ * - \b selectEntities: Selects sets of 1000 random entities.
+ * - \b getBoundingBox: Computes the document bounding box after an
+ *          entity on its boundary was undone (worst case).
+ * - \b saveTransaction: Stores the transaction of an edit that replaces
+ *          a random line by a moved copy.
+ * - \b getTransaction: Loads random transactions.
+ * - \b undo / \b redo: Undoes and redoes all edits with
+ *          RS_AbstractStorage::toggleUndoStatus.
+ * - \b deleteTransactionsFrom: Drops a redo branch of 10 transactions.
+ * - \b saveObjects: Stores as many lines as \b saveObject in batches of
+ *          1000, one transaction per batch. An operation is a batch 
+ *          including the commit.
+ *
+ * The SQLite backends open the document with one of the presets of
+ * RS_DbStorageOptions: "interactive" (the default), "bulk" or 
+ * "default" (SQLite defaults), so the presets can be compared.
+ *
+ * Random numbers come from a fixed linear congruential generator, so
+ * every run with the same seed performs the same operations on every
+ * platform.
+ *
+ * For every scenario, the throughput and the latency percentiles of
+ * the single operations are reported (see \ref Result).
+ *
+ * \author Andrew Mustun
+ * \ingroup qcaddbstorage
+ */
+class RS_DbsBenchmark {
+public:
+    /**
+     * Result of one scenario.
+     */
+    struct Result {
+        std::string backend;
+        //! preset of the SQLite backends:
+        std::string options;
+        int size;
+        std::string scenario;
+        //! number of timed operations:
+        int operations;
+        //! sum of the time of all operations in seconds:
+        double seconds;
+        double operationsPerSecond;
+        //! latency percentiles in microseconds:
+        double p50;
+        double p99;
+        double max;
+    };
+
+public:
+    RS_DbsBenchmark(
+        const std::string& backend, const std::string& options, 
+        int size, unsigned int seed
+    );
+
+    static bool isBackend(const std::string& backend);
+    static bool isOptions(const std::string& options);
+
+    bool run();
+
+    const std::vector<Result>& getResults() const {
+        return results;
+    }
+
+    static void writeJson(FILE* fp, const std::vector<Result>& results, unsigned int seed);
+    static void writeCsv(FILE* fp, const std::vector<Result>& results);
+
+private:
+    RS_AbstractStorage* createStorage();
+
+    template <class Storage>
+    void runScenarios(Storage& storage);
+
+    void benchSaveObject(RS_AbstractStorage& storage);
+    void benchQueryEntity(RS_AbstractStorage& storage);
+    template <class Storage>
+    void benchQueryEntities(Storage& storage);
+    template <class Storage>
+    void benchQueryEntitiesInBox(Storage& storage);
+    void benchQueryAllEntities(RS_AbstractStorage& storage);
+    void benchSelectEntity(RS_AbstractStorage& storage);
+    void benchSelectEntities(RS_AbstractStorage& storage);
+    void benchGetBoundingBox(RS_AbstractStorage& storage);
+    void benchSaveTransaction(RS_AbstractStorage& storage);
+    void benchGetTransaction(RS_AbstractStorage& storage);
+    void benchUndoRedo(RS_AbstractStorage& storage);
+    void benchDeleteTransactionsFrom(RS_AbstractStorage& storage);
+    template <class Storage>
+    void benchSaveObjects(Storage& storage);
+
+    void undo(RS_AbstractStorage& storage);
+    void redo(RS_AbstractStorage& storage);
+
+    /**
+     * Starts timing one operation.
+     */
+    void start() {
+        startTime = RS_DbsStatistics::now();
+    }
+
+    /**
+     * Stops timing one operation and records its latency.
+     */
+    void stop() {
+        latencies.push_back(RS_DbsStatistics::now() - startTime);
+    }
+
+    void addResult(const std::string& scenario);
+
+    unsigned int random();
+    RS_Object::Id randomEntity();
+
+    /**
+     * \return Number of repetitions for scenarios whose operations
+     *      take time proportional to the document size: \c budget
+     *      divided by the size, but between \c min and \c max.
+     */
+    int getRepetitions(int budget, int min, int max) const {
+        int n = budget / size;
+        return n<min ? min : (n>max ? max : n);
+    }
+
+    /**
+     * Number of edits (transactions) for the transaction scenarios.
+     */
+    static const int edits = 1000;
+
+private:
+    std::string backend;
+    std::string options;
+    int size;
+    unsigned int state;
+
+    //! IDs of all lines that are not undone:
+    std::vector<RS_Object::Id> entityIds;
+    //! ID of the line at the origin, which is on the boundary:
+    RS_Object::Id cornerId;
+
+    double startTime;
+    std::vector<double> latencies;
+    std::vector<Result> results;
+};
+
+#endif
@@ -0,0 +1,56 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "rs_dbsconformancecheck.h"
+#include "RS_DbsObjectTypeRegistry"
+
+
+
+static void usage() {
+    fprintf(stderr,
+        "Usage: qcaddbstorage_conformance [options]\n"
+        "\n"
+        "  --scripts=N  Number of scripts (default: 100)\n"
+        "  --steps=N    Number of steps per script (default: 100)\n"
+        "  --seed=N     Seed of the random numbers (default: 1)\n"
+    );
+}
+
+
+
+/**
+ * Checks that RS_MemoryStorage behaves like RS_DbStorage (see
+ * RS_DbsConformanceCheck). Exits with 1 if the storages disagree.
+ */
+int main(int argc, char** argv) {
+    int scripts = 100;
+    int steps = 100;
+    unsigned int seed = 1;
+
+    for (int i=1; i<argc; i++) {
+        if (strncmp(argv[i], "--scripts=", 10)==0) {
+            scripts = atoi(argv[i] + 10);
+        }
+        else if (strncmp(argv[i], "--steps=", 8)==0) {
+            steps = atoi(argv[i] + 8);
+        }
+        else if (strncmp(argv[i], "--seed=", 7)==0) {
+            seed = (unsigned int)strtoul(argv[i] + 7, NULL, 10);
+        }
+        else {
+            usage();
+            return 1;
+        }
+    }
+
+    RS_DbsObjectTypeRegistry::registerStandardObjectTypes();
+
+    RS_DbsConformanceCheck check(scripts, steps, seed);
+    bool ok = check.run();
+    check.writeReport(stdout);
+
+    RS_DbsObjectTypeRegistry::cleanUp();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,470 @@
+#include <cstdio>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "rs_dbsconformancecheck.h"
+#include "RS_DbStorage"
+#include "RS_LineEntity"
+#include "RS_MemoryStorage"
+#include "RS_Transaction"
+#include "RS_Ucs"
+
+
+
+/**
+ * \param scripts Number of scripts to run. Every script starts with
+ *      new, empty storages.
+ * \param steps Number of steps of every script.
+ * \param seed Seed of the random numbers.
+ */
+RS_DbsConformanceCheck::RS_DbsConformanceCheck(int scripts, int steps, unsigned int seed)
+    : scripts(scripts),
+      steps(steps),
+      state(seed),
+      stepCount(0) {
+}
+
+
+
+/**
+ * Runs all scripts until the states of the storages differ.
+ *
+ * \return true if the states were the same after all steps.
+ */
+bool RS_DbsConformanceCheck::run() {
+    failure.clear();
+    stepCount = 0;
+    for (int script=0; script<scripts; script++) {
+        if (!runScript(script)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+
+/**
+ * Runs one script.
+ *
+ * \return false if the states of the storages differ.
+ */
+bool RS_DbsConformanceCheck::runScript(int script) {
+    RS_DbStorage dbStorage;
+    RS_MemoryStorage memoryStorage;
+
+    if (script%3==2) {
+        dbStorage.setUndoBudget(4, 0);
+        memoryStorage.setUndoBudget(4, 0);
+    }
+
+    char buf[256];
+    std::string dbState = getState(dbStorage);
+    std::string memoryState = getState(memoryStorage);
+    if (dbState!=memoryState) {
+        sprintf(buf, "script %d, empty storage:\n", script);
+        failure = std::string(buf) +
+            "  RS_DbStorage:     " + dbState + "\n" +
+            "  RS_MemoryStorage: " + memoryState + "\n";
+        return false;
+    }
+
+    for (int i=0; i<steps; i++) {
+        Step step = createStep();
+
+        apply(dbStorage, step);
+        apply(memoryStorage, step);
+        stepCount++;
+
+        dbState = getState(dbStorage);
+        memoryState = getState(memoryStorage);
+        if (dbState!=memoryState) {
+            sprintf(buf, "script %d, step %d (%s %d %g %g):\n",
+                script, i, getOperationName(step.operation),
+                step.n, step.x, step.y);
+            failure = std::string(buf) +
+                "  RS_DbStorage:     " + dbState + "\n" +
+                "  RS_MemoryStorage: " + memoryState + "\n";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+
+/**
+ * \return Next step of the script.
+ */
+RS_DbsConformanceCheck::Step RS_DbsConformanceCheck::createStep() {
+    Step step;
+    step.operation = (Operation)(random() % OperationCount);
+    step.n = random() % 7 + 1;
+    step.x = random() % 50;
+    step.y = random() % 50;
+    return step;
+}
+
+
+
+/**
+ * Applies one step of the script to the given storage, in one DB
+ * transaction.
+ */
+template <class Storage>
+void RS_DbsConformanceCheck::apply(Storage& storage, const Step& step) {
+    storage.beginTransaction();
+
+    switch (step.operation) {
+    case AddLines: {
+        std::set<RS_Object::Id> affectedObjects;
+        for (int i=0; i<step.n; i++) {
+            RS_LineData data(
+                RS_Vector(step.x + i, step.y),
+                RS_Vector(step.x + i + 3, step.y + 2)
+            );
+            RS_LineEntity line(data);
+            storage.saveObject(line);
+            affectedObjects.insert(line.getId());
+        }
+        saveTransaction(storage, "addLines", affectedObjects);
+        break;
+    }
+
+    case AddUcs: {
+        char name[32];
+        sprintf(name, "Ucs%d", stepCount);
+        RS_Ucs ucs;
+        ucs.name = name;
+        ucs.setOrigin(RS_Vector(step.x, step.y));
+        ucs.setXAxisDirection(RS_Vector(1, 0));
+        ucs.setYAxisDirection(RS_Vector(0, 1));
+        storage.saveObject(ucs);
+        std::set<RS_Object::Id> affectedObjects;
+        affectedObjects.insert(ucs.getId());
+        saveTransaction(storage, "addUcs", affectedObjects);
+        break;
+    }
+
+    case Edit: {
+        RS_Object::Id id = getObject(storage, step.n, true);
+        if (id==-1) {
+            break;
+        }
+        RS_Entity* entity = storage.queryEntity(id);
+        RS_LineEntity* line = dynamic_cast<RS_LineEntity*>(entity);
+        if (line!=NULL) {
+            line->getData().endPoint = RS_Vector(step.x, step.y);
+            line->setId(-1);
+            storage.saveObject(*line);
+            storage.toggleUndoStatus(id);
+
+            std::set<RS_Object::Id> affectedObjects;
+            affectedObjects.insert(id);
+            affectedObjects.insert(line->getId());
+            saveTransaction(storage, "edit", affectedObjects);
+        }
+        delete entity;
+        break;
+    }
+
+    case Update: {
+        RS_Object::Id id = getObject(storage, step.n, true);
+        if (id==-1) {
+            break;
+        }
+        RS_Entity* entity = storage.queryEntity(id);
+        RS_LineEntity* line = dynamic_cast<RS_LineEntity*>(entity);
+        if (line!=NULL) {
+            line->getData().startPoint = RS_Vector(step.x, step.y);
+            storage.saveObject(*line);
+        }
+        delete entity;
+        break;
+    }
+
+    case SaveObjects: {
+        std::vector<RS_Object*> objects;
+        for (int i=0; i<step.n; i++) {
+            RS_LineData data(
+                RS_Vector(step.x, step.y + i),
+                RS_Vector(step.x - 5, step.y)
+            );
+            objects.push_back(new RS_LineEntity(data));
+        }
+        storage.saveObjects(objects);
+        for (unsigned int i=0; i<objects.size(); i++) {
+            delete objects[i];
+        }
+        break;
+    }
+
+    case Delete: {
+        RS_Object::Id id = getObject(storage, step.n, false);
+        if (id!=-1) {
+            storage.deleteObject(id);
+        }
+        break;
+    }
+
+    case Undo: {
+        // transactions dropped from the undo log are not skipped here,
+        // the storage has to refuse to undo them:
+        int last = storage.getLastTransactionId();
+        if (last>=0) {
+            RS_Transaction transaction = storage.getTransaction(last);
+            std::set<RS_Object::Id> affectedObjects = transaction.getAffectedObjects();
+            storage.toggleUndoStatus(affectedObjects);
+            storage.setLastTransactionId(last - 1);
+        }
+        break;
+    }
+
+    case Redo: {
+        int last = storage.getLastTransactionId();
+        if (last<storage.getMaxTransactionId()) {
+            RS_Transaction transaction = storage.getTransaction(last + 1);
+            std::set<RS_Object::Id> affectedObjects = transaction.getAffectedObjects();
+            storage.toggleUndoStatus(affectedObjects);
+            storage.setLastTransactionId(last + 1);
+        }
+        break;
+    }
+
+    case Select: {
+        RS_Object::Id id = getObject(storage, step.n, true);
+        if (id!=-1) {
+            std::set<RS_Entity::Id> affectedEntities;
+            storage.selectEntity(id, step.n%2==0, &affectedEntities);
+        }
+        break;
+    }
+
+    case SelectBox: {
+        std::set<RS_Entity::Id> ids;
+        RS_Box box(RS_Vector(step.x, step.y), RS_Vector(step.x + 20, step.y + 20));
+        storage.queryEntitiesInBox(box, ids);
+        storage.selectEntities(ids, step.n%2==0);
+        break;
+    }
+
+    case ClearSelection: {
+        std::set<RS_Entity::Id> affectedEntities;
+        storage.clearEntitySelection(&affectedEntities);
+        break;
+    }
+
+    case Compact:
+        storage.compactUndoLog();
+        break;
+
+    default:
+        break;
+    }
+
+    storage.commitTransaction();
+}
+
+
+
+/**
+ * Stores a transaction with the given affected objects after dropping
+ * the redo branch, like an application does after every edit.
+ */
+template <class Storage>
+void RS_DbsConformanceCheck::saveTransaction(
+    Storage& storage,
+    const std::string& text,
+    std::set<RS_Object::Id>& affectedObjects) {
+
+    int last = storage.getLastTransactionId();
+    if (last<storage.getMaxTransactionId()) {
+        storage.deleteTransactionsFrom(last + 1);
+    }
+
+    std::multimap<RS_Object::Id, RS_PropertyChange> propertyChanges;
+    RS_PropertyChange propertyChange;
+    propertyChange.propertyTypeId = 1;
+    propertyChange.oldValue = RS_PropertyValue((int)affectedObjects.size());
+    propertyChange.newValue = RS_PropertyValue(text);
+    propertyChanges.insert(
+        std::pair<RS_Object::Id, RS_PropertyChange>(*affectedObjects.begin(), propertyChange)
+    );
+
+    RS_Transaction transaction(storage, -1, text, affectedObjects, propertyChanges);
+    storage.saveTransaction(transaction);
+}
+
+
+
+/**
+ * \return ID of the object or entity with the given index (modulo the
+ *      number of objects / entities) or -1 if there is none.
+ */
+template <class Storage>
+RS_Object::Id RS_DbsConformanceCheck::getObject(Storage& storage, int index, bool entity) {
+    std::set<RS_Object::Id> ids;
+    if (entity) {
+        storage.queryAllEntities(ids);
+    }
+    else {
+        storage.queryAllObjects(ids);
+    }
+    if (ids.empty()) {
+        return -1;
+    }
+    std::set<RS_Object::Id>::iterator it = ids.begin();
+    for (int i=index % ids.size(); i>0; i--) {
+        ++it;
+    }
+    return *it;
+}
+
+
+
+/**
+ * \return Observable state of the given storage as text.
+ */
+template <class Storage>
+std::string RS_DbsConformanceCheck::getState(Storage& storage) {
+    std::string ret;
+    char buf[256];
+
+    // objects:
+    std::set<RS_Object::Id> objectIds;
+    storage.queryAllObjects(objectIds);
+    std::set<RS_Object::Id>::iterator it;
+    for (it=objectIds.begin(); it!=objectIds.end(); ++it) {
+        RS_Object* object = storage.queryObject(*it);
+        RS_LineEntity* line = dynamic_cast<RS_LineEntity*>(object);
+        RS_Ucs* ucs = dynamic_cast<RS_Ucs*>(object);
+        if (line!=NULL) {
+            sprintf(buf, "line %d (%g,%g)-(%g,%g)%s undone %d; ",
+                *it,
+                line->getData().startPoint.x, line->getData().startPoint.y,
+                line->getData().endPoint.x, line->getData().endPoint.y,
+                line->isSelected() ? " selected" : "",
+                (int)storage.getUndoStatus(*it));
+        }
+        else if (ucs!=NULL) {
+            sprintf(buf, "ucs %d %s (%g,%g) undone %d; ",
+                *it, ucs->name.c_str(), ucs->origin.x, ucs->origin.y,
+                (int)storage.getUndoStatus(*it));
+        }
+        else {
+            sprintf(buf, "object %d: %s; ", *it,
+                object==NULL ? "not found" : "unknown type");
+        }
+        ret += buf;
+        delete object;
+    }
+
+    // entities and queries:
+    std::set<RS_Entity::Id> entityIds;
+    std::set<RS_Entity::Id> selectedIds;
+    std::set<RS_Entity::Id> boxIds;
+    std::set<RS_Entity::Id> insideIds;
+    std::set<RS_Ucs::Id> ucsIds;
+    storage.queryAllEntities(entityIds);
+    storage.querySelectedEntities(selectedIds);
+    storage.queryAllUcs(ucsIds);
+    RS_Box box(RS_Vector(10, 10), RS_Vector(40, 40));
+    storage.queryEntitiesInBox(box, boxIds);
+    storage.queryEntitiesInBox(box, insideIds, true);
+
+    const std::set<RS_Object::Id>* sets[] = {
+        &entityIds, &selectedIds, &ucsIds, &boxIds, &insideIds
+    };
+    const char* names[] = {
+        "entities", "selected", "ucs", "box", "inside"
+    };
+    for (int i=0; i<5; i++) {
+        ret += std::string("| ") + names[i] + ":";
+        for (it=sets[i]->begin(); it!=sets[i]->end(); ++it) {
+            sprintf(buf, " %d", *it);
+            ret += buf;
+        }
+        ret += " ";
+    }
+
+    RS_Box boundingBox = storage.getBoundingBox();
+    sprintf(buf, "| bounding box (%g,%g)-(%g,%g) ",
+        boundingBox.getDefiningCorner1().x, boundingBox.getDefiningCorner1().y,
+        boundingBox.getDefiningCorner2().x, boundingBox.getDefiningCorner2().y);
+    ret += buf;
+
+    // undo log:
+    int minId = storage.getMinTransactionId();
+    int maxId = storage.getMaxTransactionId();
+    sprintf(buf, "| transactions last %d min %d max %d:",
+        storage.getLastTransactionId(), minId, maxId);
+    ret += buf;
+    for (int id=minId; minId!=-1 && id<=maxId; id++) {
+        RS_Transaction transaction = storage.getTransaction(id);
+        std::set<RS_Object::Id> affectedObjects = transaction.getAffectedObjects();
+        sprintf(buf, " %d %s [", id, transaction.getText().c_str());
+        ret += buf;
+        for (it=affectedObjects.begin(); it!=affectedObjects.end(); ++it) {
+            sprintf(buf, " %d", *it);
+            ret += buf;
+        }
+        sprintf(buf, " ] %d changes;", (int)transaction.getPropertyChanges().size());
+        ret += buf;
+    }
+
+    return ret;
+}
+
+
+
+const char* RS_DbsConformanceCheck::getOperationName(Operation operation) {
+    switch (operation) {
+    case AddLines:
+        return "addLines";
+    case AddUcs:
+        return "addUcs";
+    case Edit:
+        return "edit";
+    case Update:
+        return "update";
+    case SaveObjects:
+        return "saveObjects";
+    case Delete:
+        return "delete";
+    case Undo:
+        return "undo";
+    case Redo:
+        return "redo";
+    case Select:
+        return "select";
+    case SelectBox:
+        return "selectBox";
+    case ClearSelection:
+        return "clearSelection";
+    case Compact:
+        return "compact";
+    default:
+        return "?";
+    }
+}
+
+
+
+/**
+ * \return Next pseudo random number (LCG of Numerical Recipes).
+ */
+unsigned int RS_DbsConformanceCheck::random() {
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+}
+
+
+
+void RS_DbsConformanceCheck::writeReport(FILE* fp) const {
+    if (!failure.empty()) {
+        fprintf(fp, "FAIL %s", failure.c_str());
+    }
+    fprintf(fp, "%d steps, %s\n", stepCount, failure.empty() ? "ok" : "failed");
+}
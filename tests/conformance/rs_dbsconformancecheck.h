@@ -0,0 +1,115 @@
+#ifndef RS_DBSCONFORMANCECHECK_H
+#define RS_DBSCONFORMANCECHECK_H
+
+#include <cstdio>
+#include <string>
+
+#include "RS_Object"
+
+
+
+/**
+ * Checks that RS_MemoryStorage behaves like RS_DbStorage.
+ *
+ * The check runs the same script of operations against a new
+ * RS_DbStorage and a new RS_MemoryStorage and compares the observable
+ * state of both storages before the first and after every operation.
+ * The script is a sequence of pseudo random steps, so every run with
+ * the same seed performs the same operations on every platform:
+ *
+ * - \b addLines: Adds lines and stores the transaction.
+ * - \b addUcs: Adds a UCS and stores the transaction.
+ * - \b edit: Replaces a line by a modified copy and stores the
+ *          transaction, the way an application edits an entity.
+ * - \b update: Modifies a line in place, without a transaction.
+ * - \b saveObjects: Adds lines with RS_AbstractStorage::saveObjects.
+ * - \b delete: Deletes an object.
+ * - \b undo / \b redo: Toggles the objects of the last / next
+ *          transaction and moves the last transaction ID. Undo does
+ *          not stop at transactions that have been dropped from the
+ *          undo log.
+ * - \b select, \b selectBox, \b clearSelection: Change the selection.
+ * - \b compact: Compacts the undo log.
+ *
+ * Storing a transaction drops the redo branch first. Every third
+ * script limits the undo log to a few steps, so that transactions
+ * are dropped from the log and orphaned objects are purged.
+ *
+ * The observable state consists of all objects with their data and
+ * selection status, the results of box queries, the bounding box, the
+ * undo status of all objects, the last, minimum and maximum
+ * transaction ID and the text and affected objects of all transactions
+ * in the log. The undo log size is an estimate in RS_MemoryStorage and
+ * is not compared.
+ *
+ * \author Andrew Mustun
+ * \ingroup qcaddbstorage
+ */
+class RS_DbsConformanceCheck {
+public:
+    RS_DbsConformanceCheck(int scripts, int steps, unsigned int seed);
+
+    bool run();
+
+    void writeReport(FILE* fp) const;
+
+private:
+    enum Operation {
+        AddLines,
+        AddUcs,
+        Edit,
+        Update,
+        SaveObjects,
+        Delete,
+        Undo,
+        Redo,
+        Select,
+        SelectBox,
+        ClearSelection,
+        Compact,
+        OperationCount
+    };
+
+    /**
+     * One step of the script.
+     */
+    struct Step {
+        Operation operation;
+        //! count or index, depending on the operation:
+        int n;
+        double x;
+        double y;
+    };
+
+    bool runScript(int script);
+    Step createStep();
+
+    template <class Storage>
+    void apply(Storage& storage, const Step& step);
+    template <class Storage>
+    void saveTransaction(
+        Storage& storage,
+        const std::string& text,
+        std::set<RS_Object::Id>& affectedObjects
+    );
+    template <class Storage>
+    RS_Object::Id getObject(Storage& storage, int index, bool entity);
+    template <class Storage>
+    std::string getState(Storage& storage);
+
+    static const char* getOperationName(Operation operation);
+
+    unsigned int random();
+
+private:
+    int scripts;
+    int steps;
+    unsigned int state;
+    //! number of steps run, also used for unique UCS names:
+    int stepCount;
+
+    //! description of the first difference:
+    std::string failure;
+};
+
+#endif
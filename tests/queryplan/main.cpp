@@ -0,0 +1,56 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "rs_dbsqueryplancheck.h"
+#include "RS_DbsObjectTypeRegistry"
+
+
+
+static void usage() {
+    fprintf(stderr,
+        "Usage: qcaddbstorage_queryplan [options]\n"
+        "\n"
+        "  --size=N     Number of entities in the document (default: 100000)\n"
+        "  --verbose    Write the plans of all statements\n"
+    );
+}
+
+
+
+/**
+ * Checks the query plans of all statements of RS_DbStorage (see
+ * RS_DbsQueryPlanCheck). Exits with 1 if any statement fails the check.
+ */
+int main(int argc, char** argv) {
+    int size = 100000;
+    bool verbose = false;
+
+    for (int i=1; i<argc; i++) {
+        if (strncmp(argv[i], "--size=", 7)==0) {
+            size = atoi(argv[i] + 7);
+        }
+        else if (strcmp(argv[i], "--verbose")==0) {
+            verbose = true;
+        }
+        else {
+            usage();
+            return 1;
+        }
+    }
+
+    if (size<1000) {
+        fprintf(stderr, "size must be at least 1000\n");
+        return 1;
+    }
+
+    RS_DbsObjectTypeRegistry::registerStandardObjectTypes();
+
+    RS_DbsQueryPlanCheck check(size);
+    bool ok = check.run();
+    check.writeReport(stdout, verbose);
+
+    RS_DbsObjectTypeRegistry::cleanUp();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,35 @@
+exists( ../../../mkspecs/defs.pro ):include( ../../../mkspecs/defs.pro )
+
+TEMPLATE = app
+DESTDIR = .
+CONFIG -= qt
+CONFIG += console warn_on
+
+INCLUDEPATH += ../../include
+
+HEADERS = \
+    ./rs_dbsqueryplancheck.h
+SOURCES = \
+    ./main.cpp \
+    ./rs_dbsqueryplancheck.cpp
+
+TARGET = qcaddbstorage_queryplan
+OBJECTS_DIR = .obj
+
+# qcaddbstorage is linked before the modules it depends on:
+CONFIG(debug, debug|release) {
+    TARGET = $$join(TARGET,,,_d)
+    OBJECTS_DIR = $$join(OBJECTS_DIR,,,_d)
+    LIBS += -L../../lib -lqcaddbstorage_d -lqcaddbclient_d -lqcadcore_d
+}
+else {
+    LIBS += -L../../lib -lqcaddbstorage -lqcaddbclient -lqcadcore
+}
+LIBS += -lsqlite3
+# RS_DbsThread and RS_DbsWaitCondition:
+unix:LIBS += -lpthread
+
+# 'make check' fails if a statement of the storage does a full scan:
+check.commands = ./$$TARGET
+check.depends = $$TARGET
+QMAKE_EXTRA_TARGETS += check
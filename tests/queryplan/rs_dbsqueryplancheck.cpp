@@ -0,0 +1,553 @@
+#include <cstdio>
+#include <map>
+
+#include "rs_dbsqueryplancheck.h"
+#include "RS_DbsIdSet"
+#include "RS_DbsIdVisitor"
+#include "RS_DbsReaderPool"
+#include "RS_DbsReadView"
+#include "RS_DbStorage"
+#include "RS_LineEntity"
+#include "RS_Transaction"
+#include "RS_Ucs"
+
+// document file, the second connection needs a file to find it:
+static const char* fileName = "qcaddbstorage_queryplan.db";
+
+
+
+/**
+ * Visitor that stops after the first ID.
+ */
+class RS_DbsFirstIdVisitor : public RS_DbsIdVisitor {
+public:
+    virtual bool visit(RS_Object::Id) {
+        return false;
+    }
+};
+
+
+
+/**
+ * \param size Number of line entities in the document. The document
+ *      must be large enough for SQLite to prefer indices over scans.
+ */
+RS_DbsQueryPlanCheck::RS_DbsQueryPlanCheck(int size)
+    : size(size),
+      failures(0),
+      ucsId(-1) {
+}
+
+
+
+/**
+ * Runs all operations, explains all statements and checks their plans.
+ *
+ * \return true if all statements passed the check.
+ */
+bool RS_DbsQueryPlanCheck::run() {
+    RS_DbStorage::removeFiles(fileName);
+
+    {
+        RS_DbStorage storage(fileName, RS_DbStorageOptions::getInteractive());
+        populate(storage);
+
+        storage.getStatistics().setEnabled(true);
+
+        runBulk(storage);
+        collectStatements(storage.getStatistics(), false);
+
+        runHot(storage);
+        collectStatements(storage.getStatistics(), true);
+
+        storage.getStatistics().setEnabled(false);
+    }
+
+    // statistics from the start record the statements that open the
+    // document and those of the reader connection:
+    {
+        RS_DbStorageOptions options = RS_DbStorageOptions::getInteractive();
+        options.readerConnections = 1;
+        options.statistics = true;
+        RS_DbStorage storage(fileName, options);
+        collectStatements(storage.getStatistics(), true);
+        storage.getStatistics().setEnabled(false);
+
+        RS_DbsReaderPool* pool = storage.getReaderPool();
+        if (pool==NULL) {
+            fprintf(stderr, "no reader connection, reader queries not checked\n");
+        }
+        else {
+            runBulk(*pool);
+            collectStatements(pool->getStatistics(0), false);
+
+            runHot(*pool);
+            collectStatements(pool->getStatistics(0), true);
+        }
+    }
+
+    RS_DbConnection db;
+    db.open(fileName);
+
+    // the temporary ID tables only exist on the connection that
+    // created them:
+    for (unsigned int i=0; i<statements.size(); i++) {
+        if (statements[i].sql.compare(0, 17, "CREATE TEMP TABLE")==0) {
+            db.executeNonQuery(statements[i].sql);
+        }
+    }
+    // the command has to be finalized before the connection is closed:
+    {
+        RS_DbCommand cmd(db, "SELECT name FROM sqlite_temp_master WHERE type='table'");
+        RS_DbReader reader = cmd.executeReader();
+        while (reader.read()) {
+            tempTables.insert(reader.getString(0));
+        }
+    }
+    {
+        RS_DbCommand cmd(db, "SELECT name FROM sqlite_master WHERE type='index' AND sql LIKE '% WHERE %'");
+        RS_DbReader reader = cmd.executeReader();
+        while (reader.read()) {
+            partialIndices.insert(reader.getString(0));
+        }
+    }
+
+    failures = 0;
+    for (unsigned int i=0; i<statements.size(); i++) {
+        explain(db, statements[i]);
+        if (!check(statements[i]).empty()) {
+            failures++;
+        }
+    }
+
+    db.close();
+    RS_DbStorage::removeFiles(fileName);
+
+    return failures==0;
+}
+
+
+
+/**
+ * Fills the document with a grid of lines, 1000 per row, a few UCS
+ * and an undo history of edits.
+ */
+void RS_DbsQueryPlanCheck::populate(RS_DbStorage& storage) {
+    storage.beginTransaction();
+    for (int i=0; i<size; i++) {
+        RS_LineData data;
+        data.startPoint = RS_Vector(i%1000, i/1000);
+        data.endPoint = RS_Vector(i%1000 + 0.8, i/1000 + 0.8);
+        RS_LineEntity line(data);
+        storage.saveObject(line);
+        entityIds.push_back(line.getId());
+    }
+
+    for (int i=0; i<10; i++) {
+        RS_Ucs ucs;
+        char name[32];
+        sprintf(name, "Ucs%d", i);
+        ucs.name = name;
+        storage.saveObject(ucs);
+        ucsId = ucs.getId();
+    }
+    storage.commitTransaction();
+
+    // edits that replace every 10th line by a moved copy:
+    for (int i=0; i<size; i+=10) {
+        storage.beginTransaction();
+        RS_Entity* entity = storage.queryEntity(entityIds[i]);
+        entity->setId(-1);
+        storage.saveObject(*entity);
+        storage.toggleUndoStatus(entityIds[i]);
+
+        std::set<RS_Object::Id> affectedObjects;
+        affectedObjects.insert(entityIds[i]);
+        affectedObjects.insert(entity->getId());
+        RS_Transaction transaction(
+            storage, -1, "move",
+            affectedObjects,
+            std::multimap<RS_Object::Id, RS_PropertyChange>()
+        );
+        storage.saveTransaction(transaction);
+        storage.commitTransaction();
+
+        entityIds[i] = entity->getId();
+        delete entity;
+    }
+}
+
+
+
+/**
+ * Operations that read the whole document.
+ */
+void RS_DbsQueryPlanCheck::runBulk(RS_DbStorage& storage) {
+    // builds the object directory:
+    storage.getUndoStatus(entityIds[0]);
+
+    std::set<RS_Object::Id> ids;
+    storage.queryAllObjects(ids);
+    storage.queryAllEntities(ids);
+    storage.queryAllUcs(ids);
+
+    RS_DbsIdSet idSet;
+    storage.queryAllObjects(idSet);
+    storage.queryAllEntities(idSet);
+    storage.queryAllUcs(idSet);
+
+    RS_DbsFirstIdVisitor visitor;
+    storage.queryAllObjects(visitor);
+    storage.queryAllEntities(visitor);
+    storage.queryAllUcs(visitor);
+
+    // the line at the origin is on the boundary, so the bounding box
+    // has to be recomputed:
+    storage.beginTransaction();
+    storage.toggleUndoStatus(entityIds[0]);
+    storage.getBoundingBox();
+    storage.toggleUndoStatus(entityIds[0]);
+    storage.commitTransaction();
+
+    storage.getUndoLogSize();
+    storage.getUndoSteps();
+
+    storage.setUndoBudget(storage.getUndoSteps() / 2, 0);
+    storage.beginTransaction();
+    storage.compactUndoLog();
+    storage.commitTransaction();
+}
+
+
+
+/**
+ * Operations on single objects and transactions.
+ */
+void RS_DbsQueryPlanCheck::runHot(RS_DbStorage& storage) {
+    RS_Object::Id id = entityIds[size/2];
+
+    delete storage.queryObject(id);
+    delete storage.queryEntity(id);
+    storage.getUndoStatus(id);
+
+    delete storage.queryUcs(ucsId);
+    delete storage.queryUcs("Ucs5");
+
+    std::set<RS_Object::Id> ids;
+    RS_DbsIdSet idSet;
+    for (int i=size/2; i<size/2+100; i++) {
+        ids.insert(entityIds[i]);
+        idSet.insert(entityIds[i]);
+    }
+
+    std::vector<RS_Object*> objects;
+    storage.queryObjects(ids, objects);
+    for (unsigned int i=0; i<objects.size(); i++) {
+        delete objects[i];
+    }
+    std::vector<RS_Entity*> entities;
+    storage.queryEntities(ids, entities);
+    for (unsigned int i=0; i<entities.size(); i++) {
+        delete entities[i];
+    }
+
+    RS_Box box(RS_Vector(10, 10), RS_Vector(20, 12));
+    std::set<RS_Entity::Id> inBox;
+    storage.queryEntitiesInBox(box, inBox);
+    storage.queryEntitiesInBox(box, inBox, true);
+    RS_DbsIdSet inBoxSet;
+    storage.queryEntitiesInBox(box, inBoxSet);
+
+    std::set<RS_Entity::Id> affected;
+    storage.selectEntity(id, false, &affected);
+    storage.selectEntities(ids, true, &affected);
+    storage.selectEntities(idSet, true);
+    std::set<RS_Entity::Id> selected;
+    storage.querySelectedEntities(selected);
+    storage.saveSelection();
+    storage.clearEntitySelection(&affected);
+    storage.saveSelection();
+
+    // edit: update a line in place and replace another by a copy:
+    storage.beginTransaction();
+    RS_Entity* entity = storage.queryEntity(id);
+    storage.saveObject(*entity);
+    RS_Object::Id oldId = entityIds[size/2+1];
+    RS_Entity* copy = storage.queryEntity(oldId);
+    copy->setId(-1);
+    storage.saveObject(*copy);
+    storage.toggleUndoStatus(oldId);
+    std::set<RS_Object::Id> affectedObjects;
+    affectedObjects.insert(oldId);
+    affectedObjects.insert(copy->getId());
+    RS_Transaction transaction(
+        storage, -1, "move",
+        affectedObjects,
+        std::multimap<RS_Object::Id, RS_PropertyChange>()
+    );
+    storage.saveTransaction(transaction);
+    storage.commitTransaction();
+    delete entity;
+    delete copy;
+
+    // undo and redo the edit:
+    int last = storage.getLastTransactionId();
+    storage.beginTransaction();
+    RS_Transaction undone = storage.getTransaction(last);
+    std::set<RS_Object::Id> undoneObjects = undone.getAffectedObjects();
+    storage.toggleUndoStatus(undoneObjects);
+    storage.setLastTransactionId(last - 1);
+    storage.commitTransaction();
+
+    storage.beginTransaction();
+    storage.toggleUndoStatus(RS_DbsIdSet(undoneObjects));
+    storage.setLastTransactionId(last);
+    storage.commitTransaction();
+
+    storage.getMinTransactionId();
+    storage.getMaxTransactionId();
+
+    // drop a redo branch:
+    storage.beginTransaction();
+    undone = storage.getTransaction(last);
+    undoneObjects = undone.getAffectedObjects();
+    storage.toggleUndoStatus(undoneObjects);
+    storage.setLastTransactionId(last - 1);
+    storage.deleteTransactionsFrom(last);
+    storage.commitTransaction();
+
+    // bulk save and delete:
+    std::vector<RS_Object*> lines;
+    for (int i=0; i<100; i++) {
+        RS_LineData data;
+        data.startPoint = RS_Vector(i, -10);
+        data.endPoint = RS_Vector(i + 0.8, -9.2);
+        lines.push_back(new RS_LineEntity(data));
+    }
+    storage.beginTransaction();
+    storage.saveObjects(lines);
+    std::set<RS_Object::Id> newIds;
+    for (unsigned int i=1; i<lines.size(); i++) {
+        newIds.insert(lines[i]->getId());
+    }
+    storage.deleteObject(lines[0]->getId());
+    storage.deleteObjects(newIds);
+    storage.commitTransaction();
+    for (unsigned int i=0; i<lines.size(); i++) {
+        delete lines[i];
+    }
+
+    // transactions beyond the undo budget drop the oldest transactions:
+    storage.setUndoBudget(storage.getUndoSteps(), 1);
+    for (int i=0; i<10; i++) {
+        storage.beginTransaction();
+        RS_Object::Id editId = entityIds[i*10];
+        RS_Entity* edited = storage.queryEntity(editId);
+        edited->setId(-1);
+        storage.saveObject(*edited);
+        storage.toggleUndoStatus(editId);
+        std::set<RS_Object::Id> editAffected;
+        editAffected.insert(editId);
+        editAffected.insert(edited->getId());
+        RS_Transaction edit(
+            storage, -1, "move",
+            editAffected,
+            std::multimap<RS_Object::Id, RS_PropertyChange>()
+        );
+        storage.saveTransaction(edit);
+        storage.commitTransaction();
+        entityIds[i*10] = edited->getId();
+        delete edited;
+    }
+}
+
+
+
+/**
+ * Reader queries that read the whole document. Readers compute the
+ * bounding box from all entities.
+ */
+void RS_DbsQueryPlanCheck::runBulk(RS_DbsReaderPool& pool) {
+    RS_DbsReadView view(pool);
+    RS_DbsFirstIdVisitor visitor;
+    view.queryAllEntities(visitor);
+    view.getBoundingBox();
+}
+
+
+
+/**
+ * Reader queries of single entities and of a region.
+ */
+void RS_DbsQueryPlanCheck::runHot(RS_DbsReaderPool& pool) {
+    RS_Object::Id id = entityIds[size/2];
+
+    RS_DbsReadView view(pool);
+    delete view.queryObject(id);
+    delete view.queryEntity(id);
+
+    RS_Box box(RS_Vector(10, 10), RS_Vector(20, 12));
+    std::set<RS_Entity::Id> inBox;
+    view.queryEntitiesInBox(box, inBox);
+    view.queryEntitiesInBox(box, inBox, true);
+}
+
+
+
+/**
+ * Adds the statements recorded since the last call and resets the
+ * given statistics.
+ */
+void RS_DbsQueryPlanCheck::collectStatements(RS_DbsStatistics& statistics, bool hot) {
+    std::map<std::string, int> index;
+    for (unsigned int i=0; i<statements.size(); i++) {
+        index[statements[i].sql] = i;
+    }
+
+    const std::map<std::string, RS_DbsStatistics::Record>& recorded =
+        statistics.getStatements();
+    std::map<std::string, RS_DbsStatistics::Record>::const_iterator it;
+    for (it=recorded.begin(); it!=recorded.end(); ++it) {
+        std::map<std::string, int>::iterator found = index.find(it->first);
+        if (found!=index.end()) {
+            statements[found->second].hot |= hot;
+            continue;
+        }
+
+        Statement statement;
+        statement.sql = it->first;
+        statement.hot = hot;
+        statements.push_back(statement);
+    }
+
+    statistics.reset();
+}
+
+
+
+void RS_DbsQueryPlanCheck::explain(RS_DbConnection& db, Statement& statement) {
+    try {
+        RS_DbCommand cmd(db, "EXPLAIN QUERY PLAN " + statement.sql);
+        RS_DbReader reader = cmd.executeReader();
+        while (reader.read()) {
+            // columns: id, parent, notused, detail
+            statement.plan.push_back(reader.getString(3));
+        }
+    }
+    catch (RS_DbException e) {
+        statement.error = e.error();
+    }
+}
+
+
+
+/**
+ * \return Reason why the plan of the given statement fails the check
+ *      or an empty string.
+ */
+std::string RS_DbsQueryPlanCheck::check(const Statement& statement) const {
+    if (!statement.error.empty()) {
+        return "cannot explain: " + statement.error;
+    }
+
+    int scans = 0;
+    for (unsigned int i=0; i<statement.plan.size(); i++) {
+        const std::string& detail = statement.plan[i];
+
+        if (detail.find("AUTOMATIC")!=std::string::npos) {
+            return "automatic index (missing index)";
+        }
+
+        if (detail.compare(0, 5, "SCAN ")!=0) {
+            continue;
+        }
+
+        // rows of VALUES lists, e.g. "SCAN 64 CONSTANT ROWS":
+        if (detail.find("CONSTANT ROW")!=std::string::npos) {
+            continue;
+        }
+
+        std::string table = detail.substr(5, detail.find(' ', 5) - 5);
+        if (isTempTable(table)) {
+            continue;
+        }
+
+        // the schema is read when a document is opened:
+        if (table=="sqlite_master") {
+            continue;
+        }
+
+        // a partial index only holds the rows it is made for, e.g. the
+        // selected entities (EntitySelected):
+        std::string::size_type index = detail.find(" INDEX ");
+        if (index!=std::string::npos) {
+            index += 7;
+            std::string name = detail.substr(index, detail.find(' ', index) - index);
+            if (partialIndices.count(name)==1) {
+                continue;
+            }
+        }
+
+        // R*Tree lookups are scans of the virtual table with index 
+        // number 1 (by ID) or 2 with constraints (e.g. "INDEX 2:D0B1"),
+        // "INDEX 2:" without constraints reads the whole tree:
+        if (detail.find(" VIRTUAL TABLE INDEX ")!=std::string::npos &&
+            detail.compare(detail.size()-8, 8, "INDEX 2:")!=0) {
+            continue;
+        }
+
+        scans++;
+    }
+
+    if (statement.hot && scans>0) {
+        return "full scan in hot statement";
+    }
+    if (scans>1) {
+        return "more than one full scan";
+    }
+    return "";
+}
+
+
+
+bool RS_DbsQueryPlanCheck::isTempTable(const std::string& scan) const {
+    if (scan.compare(0, 5, "temp.")==0) {
+        return true;
+    }
+    return tempTables.count(scan)==1;
+}
+
+
+
+/**
+ * Writes the checked statements, hot statements first, with the
+ * result of the check. Plans are written for failed statements or for
+ * all statements if \c verbose is true.
+ */
+void RS_DbsQueryPlanCheck::writeReport(FILE* fp, bool verbose) const {
+    for (int hot=1; hot>=0; hot--) {
+        for (unsigned int i=0; i<statements.size(); i++) {
+            const Statement& statement = statements[i];
+            if (statement.hot!=(hot==1)) {
+                continue;
+            }
+
+            std::string reason = check(statement);
+            fprintf(fp, "%s %s: %s\n",
+                reason.empty() ? "ok  " : "FAIL",
+                statement.hot ? "hot " : "bulk",
+                statement.sql.c_str());
+
+            if (!reason.empty()) {
+                fprintf(fp, "    %s\n", reason.c_str());
+            }
+            if (!reason.empty() || verbose) {
+                for (unsigned int k=0; k<statement.plan.size(); k++) {
+                    fprintf(fp, "    | %s\n", statement.plan[k].c_str());
+                }
+            }
+        }
+    }
+
+    fprintf(fp, "%d statements, %d failed\n", (int)statements.size(), failures);
+}
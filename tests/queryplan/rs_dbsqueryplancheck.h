@@ -0,0 +1,102 @@
+#ifndef RS_DBSQUERYPLANCHECK_H
+#define RS_DBSQUERYPLANCHECK_H
+
+#include <cstdio>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "RS_DbClient"
+#include "RS_Object"
+
+class RS_DbStorage;
+class RS_DbsReaderPool;
+class RS_DbsStatistics;
+
+
+
+/**
+ * Checks the query plans of all SQL statements issued by RS_DbStorage
+ * and its reader connections against a populated document.
+ *
+ * The check runs every storage operation on a document with a given
+ * number of line entities, an undo history and a few UCS and records
+ * the text of every statement with RS_DbsStatistics. The document is
+ * then opened again with statistics enabled from the start (see 
+ * RS_DbStorageOptions::statistics) to record the statements that open
+ * it and the queries of an RS_DbsReadView. Every statement is then 
+ * explained with EXPLAIN QUERY PLAN on a second connection to the same
+ * document file.
+ *
+ * Operations are run in two phases:
+ *
+ * - \b bulk: Operations that read the whole document by design
+ *          (queryAllObjects, queryAllEntities, queryAllUcs,
+ *          recomputing the bounding box, the undo log size and
+ *          compaction, building the object directory, the bounding
+ *          box of a reader). Their statements may scan one table.
+ * - \b hot: All other operations. They access single objects or
+ *          transactions and are run for every edit, undo or redo.
+ *          Opening a document (schema checks, loading the selection)
+ *          is hot as well. Their statements must not scan any table.
+ *
+ * A statement that is issued in both phases is hot. For all statements,
+ * SQLite must not build an automatic index, which it only does if an
+ * index is missing. Scans of the temporary ID tables (RS_DbsIdTable),
+ * of partial indices, of the schema table and constrained R*Tree 
+ * lookups are not scans of the document.
+ *
+ * Migrations are not checked, since the document is created with the
+ * current schema.
+ *
+ * \author Andrew Mustun
+ * \ingroup qcaddbstorage
+ */
+class RS_DbsQueryPlanCheck {
+public:
+    RS_DbsQueryPlanCheck(int size);
+
+    bool run();
+
+    /**
+     * \return Number of statements that failed the check.
+     */
+    int getFailures() const {
+        return failures;
+    }
+
+    void writeReport(FILE* fp, bool verbose) const;
+
+private:
+    /**
+     * Query plan of one statement and the result of the check.
+     */
+    struct Statement {
+        std::string sql;
+        bool hot;
+        std::vector<std::string> plan;
+        std::string error;
+    };
+
+    void populate(RS_DbStorage& storage);
+    void runBulk(RS_DbStorage& storage);
+    void runHot(RS_DbStorage& storage);
+    void runBulk(RS_DbsReaderPool& pool);
+    void runHot(RS_DbsReaderPool& pool);
+
+    void collectStatements(RS_DbsStatistics& statistics, bool hot);
+    void explain(RS_DbConnection& db, Statement& statement);
+    std::string check(const Statement& statement) const;
+    bool isTempTable(const std::string& scan) const;
+
+private:
+    int size;
+    int failures;
+    std::vector<RS_Object::Id> entityIds;
+    RS_Object::Id ucsId;
+    std::vector<Statement> statements;
+    std::set<std::string> tempTables;
+    std::set<std::string> partialIndices;
+};
+
+#endif